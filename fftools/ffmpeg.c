@@ -166,6 +166,8 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_output_threads(void);
+static void free_encoder_threads(void);
 #endif
 
 /* sub2video hack:
@@ -231,6 +233,11 @@ static void sub2video_push_ref(InputStream *ist, int64_t pts)
         ret = av_buffersrc_add_frame_flags(ist->filters[i]->filter, frame,
                                            AV_BUFFERSRC_FLAG_KEEP_REF |
                                            AV_BUFFERSRC_FLAG_PUSH);
+        /* the small subtitle frames do not wait for the outputs to drain */
+        if (ret == AVERROR(EAGAIN))
+            ret = av_buffersrc_add_frame_flags(ist->filters[i]->filter, frame,
+                                               AV_BUFFERSRC_FLAG_KEEP_REF |
+                                               AV_BUFFERSRC_FLAG_PUSH);
         if (ret != AVERROR_EOF && ret < 0)
             av_log(NULL, AV_LOG_WARNING, "Error while add the frame to buffer source(%s).\n",
                    av_err2str(ret));
@@ -531,6 +538,10 @@ static void ffmpeg_cleanup(int ret)
     av_freep(&subtitle_out);
 
     /* close files */
+#if HAVE_THREADS
+    free_encoder_threads();
+    free_output_threads();
+#endif
     for (i = 0; i < nb_output_files; i++) {
         OutputFile *of = output_files[i];
         AVFormatContext *s;
@@ -613,6 +624,11 @@ static void ffmpeg_cleanup(int ret)
                    av_err2str(AVERROR(errno)));
     }
     av_freep(&vstats_filename);
+    av_freep(&benchmark_json);
+    av_freep(&filter_thread_type);
+    av_freep(&filter_max_memory);
+    av_freep(&server_url);
+    av_freep(&server_warmup);
 
     av_freep(&input_streams);
     av_freep(&input_files);
@@ -677,6 +693,18 @@ static void update_benchmark(const char *fmt, ...)
     }
 }
 
+/* start timing a stage for -benchmark_json, 0 if it is not in use */
+static int64_t bench_start(void)
+{
+    return benchmark_json ? av_gettime_relative() : 0;
+}
+
+static void bench_end(BenchHistogram *h, int64_t t0)
+{
+    if (benchmark_json)
+        bench_hist_add(h, av_gettime_relative() - t0);
+}
+
 static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream, OSTFinished others)
 {
     int i;
@@ -686,6 +714,93 @@ static void close_all_output_streams(OutputStream *ost, OSTFinished this_stream,
     }
 }
 
+#if HAVE_THREADS
+static void *mux_thread(void *arg)
+{
+    OutputFile *of = arg;
+    AVIOContext *pb = of->ctx->pb;
+    AVPacket pkt;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(of->mux_queue, &pkt, 0)) >= 0) {
+        OutputStream *ost = output_streams[of->ost_index + pkt.stream_index];
+        int64_t t0 = bench_start();
+
+        ret = av_interleaved_write_frame(of->ctx, &pkt);
+        bench_end(&ost->bench[BENCH_MUX], t0);
+        av_packet_unref(&pkt);
+        if (ret < 0)
+            break;
+        if (pb)
+            atomic_store(&of->mux_size, avio_tell(pb));
+    }
+    /* let the main thread know about write errors on its next packet */
+    av_thread_message_queue_set_err_send(of->mux_queue, ret);
+
+    return NULL;
+}
+
+static void free_mux_message(void *msg)
+{
+    av_packet_unref(msg);
+}
+
+static void free_output_thread(int i)
+{
+    OutputFile *of = output_files[i];
+
+    if (!of || !of->mux_queue)
+        return;
+    /* the thread writes whatever is still queued before seeing EOF */
+    av_thread_message_queue_set_err_recv(of->mux_queue, AVERROR_EOF);
+    pthread_join(of->mux_thread, NULL);
+    av_thread_message_queue_free(&of->mux_queue);
+}
+
+static void free_output_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_files; i++)
+        free_output_thread(i);
+}
+
+static int init_output_thread(OutputFile *of)
+{
+    int ret;
+
+    if (mux_threads == 0 || (mux_threads < 0 && nb_output_files == 1))
+        return 0;
+
+    ret = av_thread_message_queue_alloc(&of->mux_queue,
+                                        of->thread_queue_size, sizeof(AVPacket));
+    if (ret < 0)
+        return ret;
+    av_thread_message_queue_set_free_func(of->mux_queue, free_mux_message);
+    atomic_init(&of->mux_size, of->ctx->pb ? avio_tell(of->ctx->pb) : 0);
+
+    if ((ret = pthread_create(&of->mux_thread, NULL, mux_thread, of))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&of->mux_queue);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+#endif
+
+/* Number of bytes written to the output file so far. */
+static int64_t output_file_size(OutputFile *of)
+{
+    AVIOContext *pb = of->ctx->pb;
+
+#if HAVE_THREADS
+    if (of->mux_queue)
+        return atomic_load(&of->mux_size);
+#endif
+    return pb ? avio_tell(pb) : 0;
+}
+
 static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
@@ -812,7 +927,26 @@ static void write_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int u
               );
     }
 
-    ret = av_interleaved_write_frame(s, pkt);
+#if HAVE_THREADS
+    if (of->mux_queue) {
+        AVPacket tmp_pkt;
+
+        if (benchmark_json)
+            bench_hist_add(&of->queue_depth, av_thread_message_queue_nb_elems(of->mux_queue));
+        ret = av_packet_make_refcounted(pkt);
+        if (ret >= 0) {
+            av_packet_move_ref(&tmp_pkt, pkt);
+            ret = av_thread_message_queue_send(of->mux_queue, &tmp_pkt, 0);
+            if (ret < 0)
+                av_packet_unref(&tmp_pkt);
+        }
+    } else
+#endif
+    {
+        int64_t t0 = bench_start();
+        ret = av_interleaved_write_frame(s, pkt);
+        bench_end(&ost->bench[BENCH_MUX], t0);
+    }
     if (ret < 0) {
         print_error("av_interleaved_write_frame()", ret);
         main_return_code = 1;
@@ -912,6 +1046,7 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
 {
     AVCodecContext *enc = ost->enc_ctx;
     AVPacket pkt;
+    int64_t t0, enc_time;
     int ret;
 
     av_init_packet(&pkt);
@@ -936,12 +1071,16 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+    t0 = bench_start();
     ret = avcodec_send_frame(enc, frame);
+    enc_time = bench_start() - t0;
     if (ret < 0)
         goto error;
 
     while (1) {
+        t0 = bench_start();
         ret = avcodec_receive_packet(enc, &pkt);
+        enc_time += bench_start() - t0;
         if (ret == AVERROR(EAGAIN))
             break;
         if (ret < 0)
@@ -961,6 +1100,8 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
         output_packet(of, &pkt, ost, 0);
     }
 
+    if (benchmark_json)
+        bench_hist_add(&ost->bench[BENCH_ENCODE], enc_time);
     return;
 error:
     av_log(NULL, AV_LOG_FATAL, "Audio encoding failed\n");
@@ -1050,13 +1191,296 @@ static void do_subtitle_out(OutputFile *of,
     }
 }
 
+#if HAVE_THREADS
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    AVFrame *frame;
+    AVPacket pkt;
+    int64_t pts, t0, enc_time;
+    int ret, flush = 0;
+
+    while (!flush &&
+           (ret = av_thread_message_queue_recv(ost->enc_frame_queue, &frame, 0)) >= 0) {
+        /* a NULL frame flushes the encoder and ends the thread */
+        flush    = !frame;
+        pts      = frame ? frame->pts : AV_NOPTS_VALUE;
+        t0       = bench_start();
+        ret      = avcodec_send_frame(enc, frame);
+        enc_time = bench_start() - t0;
+        av_frame_free(&frame);
+
+        while (ret >= 0) {
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+
+            t0   = bench_start();
+            ret  = avcodec_receive_packet(enc, &pkt);
+            enc_time += bench_start() - t0;
+            if (ret < 0)
+                break;
+            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                pkt.pts = pts;
+
+            /* if two pass, output log */
+            if (ost->logfile && enc->stats_out)
+                fprintf(ost->logfile, "%s", enc->stats_out);
+
+            ret = av_thread_message_queue_send(ost->enc_pkt_queue, &pkt, 0);
+            if (ret < 0)
+                av_packet_unref(&pkt);
+        }
+        if (ret == AVERROR(EAGAIN))
+            ret = 0;
+        if (ret < 0)
+            break;
+        if (benchmark_json && !flush)
+            bench_hist_add(&ost->bench[BENCH_ENCODE], enc_time);
+    }
+
+    /* EOF once flushed, otherwise the error that stopped the encoder */
+    av_thread_message_queue_set_err_send(ost->enc_frame_queue, ret);
+    av_thread_message_queue_set_err_recv(ost->enc_pkt_queue, ret);
+
+    return NULL;
+}
+
+static void free_encoder_frame(void *msg)
+{
+    av_frame_free(msg);
+}
+
+static void free_encoder_packet(void *msg)
+{
+    av_packet_unref(msg);
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    if (!ost || !ost->enc_frame_queue)
+        return;
+    /* drop the frames still queued and unblock the thread wherever it is */
+    av_thread_message_queue_set_err_recv(ost->enc_frame_queue, AVERROR_EOF);
+    av_thread_message_flush(ost->enc_frame_queue);
+    av_thread_message_queue_set_err_send(ost->enc_pkt_queue, AVERROR_EOF);
+    pthread_join(ost->enc_thread, NULL);
+    av_thread_message_queue_free(&ost->enc_frame_queue);
+    av_thread_message_queue_free(&ost->enc_pkt_queue);
+}
+
+static void free_encoder_threads(void)
+{
+    int i;
+
+    for (i = 0; i < nb_output_streams; i++)
+        free_encoder_thread(output_streams[i]);
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    int ret;
+
+    if (!encode_threads || !ost->encoding_needed || vstats_filename ||
+        ost->enc_ctx->codec_type != AVMEDIA_TYPE_VIDEO)
+        return 0;
+
+    /*
+     * The packet queue is drained before every frame is queued, so it only
+     * has to hold what the encoder makes of one full frame queue. Video
+     * encoders output at most one packet per frame outside of flushing.
+     */
+    if ((ret = av_thread_message_queue_alloc(&ost->enc_frame_queue,
+                                             FFMAX(encode_queue_size, 1),
+                                             sizeof(AVFrame *))) < 0 ||
+        (ret = av_thread_message_queue_alloc(&ost->enc_pkt_queue,
+                                             2 * FFMAX(encode_queue_size, 1) + 16,
+                                             sizeof(AVPacket))) < 0) {
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        return ret;
+    }
+    av_thread_message_queue_set_free_func(ost->enc_frame_queue, free_encoder_frame);
+    av_thread_message_queue_set_free_func(ost->enc_pkt_queue, free_encoder_packet);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        av_thread_message_queue_free(&ost->enc_frame_queue);
+        av_thread_message_queue_free(&ost->enc_pkt_queue);
+        return AVERROR(ret);
+    }
+
+    return 0;
+}
+
+/*
+ * Write out the packets the encoding thread of ost has produced so far.
+ * With wait set, keep going until the thread is done, which only happens
+ * once the encoder has been flushed.
+ */
+static int encoder_thread_output(OutputFile *of, OutputStream *ost, int wait)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket pkt;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(ost->enc_pkt_queue, &pkt,
+                                               wait ? 0 : AV_THREAD_MESSAGE_NONBLOCK)) >= 0) {
+        if (ost->finished & MUXER_FINISHED) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                   av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                   av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+        }
+
+        av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
+        output_packet(of, &pkt, ost, 0);
+    }
+
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+/*
+ * Queue a frame for the encoding thread of ost, waiting while the queue is
+ * full. The frame is referenced, not consumed.
+ */
+static int encoder_thread_send(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+    AVFrame *clone;
+    int ret;
+
+    if ((ret = encoder_thread_output(of, ost, 0)) < 0)
+        return ret;
+
+    clone = av_frame_clone(frame);
+    if (!clone)
+        return AVERROR(ENOMEM);
+    if (benchmark_json)
+        bench_hist_add(&ost->enc_queue_depth, av_thread_message_queue_nb_elems(ost->enc_frame_queue));
+    ret = av_thread_message_queue_send(ost->enc_frame_queue, &clone, 0);
+    if (ret < 0)
+        av_frame_free(&clone);
+
+    return ret;
+}
+
+/*
+ * Flush the encoder run by the thread of ost and write out everything it
+ * still had, the same way flush_encoders() does for the other encoders.
+ */
+static int encoder_thread_flush(OutputFile *of, OutputStream *ost)
+{
+    AVFrame *flush = NULL;
+    AVPacket pkt;
+    int ret;
+
+    ret = av_thread_message_queue_send(ost->enc_frame_queue, &flush, 0);
+    if (ret < 0)
+        return ret;
+
+    ret = encoder_thread_output(of, ost, 1);
+    if (ret != AVERROR_EOF)
+        return ret;
+
+    av_init_packet(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+    output_packet(of, &pkt, ost, 1);
+    return 0;
+}
+#endif
+
+static int has_encoder_thread(const OutputStream *ost)
+{
+#if HAVE_THREADS
+    return !!ost->enc_frame_queue;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Send a frame to the video encoder of ost and output the resulting packets,
+ * or queue it for the encoding thread of ost if it has one.
+ */
+static int encode_video_frame(OutputFile *of, OutputStream *ost,
+                              AVFrame *in_picture, int *frame_size)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    AVPacket pkt;
+    int64_t t0, enc_time;
+    int ret;
+
+#if HAVE_THREADS
+    if (ost->enc_frame_queue)
+        return encoder_thread_send(of, ost, in_picture);
+#endif
+
+    t0 = bench_start();
+    ret = avcodec_send_frame(enc, in_picture);
+    enc_time = bench_start() - t0;
+    if (ret < 0)
+        return ret;
+
+    while (1) {
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+
+        t0 = bench_start();
+        ret = avcodec_receive_packet(enc, &pkt);
+        enc_time += bench_start() - t0;
+        update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
+        if (ret == AVERROR(EAGAIN)) {
+            if (benchmark_json)
+                bench_hist_add(&ost->bench[BENCH_ENCODE], enc_time);
+            break;
+        }
+        if (ret < 0)
+            return ret;
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                   av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                   av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+        }
+
+        if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+            pkt.pts = ost->sync_opts;
+
+        av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
+                av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
+        }
+
+        *frame_size = pkt.size;
+        output_packet(of, &pkt, ost, 0);
+
+        /* if two pass, output log */
+        if (ost->logfile && enc->stats_out) {
+            fprintf(ost->logfile, "%s", enc->stats_out);
+        }
+    }
+
+    return 0;
+}
+
 static void do_video_out(OutputFile *of,
                          OutputStream *ost,
                          AVFrame *next_picture,
                          double sync_ipts)
 {
     int ret, format_video_sync;
-    AVPacket pkt;
     AVCodecContext *enc = ost->enc_ctx;
     AVCodecParameters *mux_par = ost->st->codecpar;
     AVRational frame_rate;
@@ -1198,9 +1622,6 @@ static void do_video_out(OutputFile *of,
         AVFrame *in_picture;
         int forced_keyframe = 0;
         double pts_time;
-        av_init_packet(&pkt);
-        pkt.data = NULL;
-        pkt.size = 0;
 
         if (i < nb0_frames && ost->last_frame) {
             in_picture = ost->last_frame;
@@ -1283,47 +1704,12 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
+        ret = encode_video_frame(of, ost, in_picture, &frame_size);
         if (ret < 0)
             goto error;
         // Make sure Closed Captions will not be duplicated
         av_frame_remove_side_data(in_picture, AV_FRAME_DATA_A53_CC);
 
-        while (1) {
-            ret = avcodec_receive_packet(enc, &pkt);
-            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-            if (ret == AVERROR(EAGAIN))
-                break;
-            if (ret < 0)
-                goto error;
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
-
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
-
-            av_packet_rescale_ts(&pkt, enc->time_base, ost->mux_timebase);
-
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
-            }
-
-            frame_size = pkt.size;
-            output_packet(of, &pkt, ost, 0);
-
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
-            }
-        }
         ost->sync_opts++;
         /*
          * For video, number of frames in == number of packets out.
@@ -1453,8 +1839,11 @@ static int reap_filters(int flush)
 
         while (1) {
             double float_pts = AV_NOPTS_VALUE; // this is identical to filtered_frame.pts but with higher precision
+            int64_t t0 = bench_start();
             ret = av_buffersink_get_frame_flags(filter, filtered_frame,
                                                AV_BUFFERSINK_FLAG_NO_REQUEST);
+            if (ret >= 0)
+                bench_end(&ost->bench[BENCH_FILTER], t0);
             if (ret < 0) {
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
                     av_log(NULL, AV_LOG_WARNING,
@@ -1490,7 +1879,8 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
+                /* the context belongs to the encoding thread once it runs */
+                if (!ost->frame_aspect_ratio.num && !has_encoder_thread(ost))
                     enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
 
                 if (debug_ts) {
@@ -1644,7 +2034,6 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
 {
     AVBPrint buf, buf_script;
     OutputStream *ost;
-    AVFormatContext *oc;
     int64_t total_size;
     AVCodecContext *enc;
     int frame_number, vid, i;
@@ -1674,11 +2063,15 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     t = (cur_time-timer_start) / 1000000.0;
 
 
-    oc = output_files[0]->ctx;
-
-    total_size = avio_size(oc->pb);
-    if (total_size <= 0) // FIXME improve avio_size() so it works with non seekable output too
-        total_size = avio_tell(oc->pb);
+    total_size = output_file_size(output_files[0]);
+#if HAVE_THREADS
+    if (!output_files[0]->mux_queue)
+#endif
+    if (output_files[0]->ctx->pb) {
+        int64_t size = avio_size(output_files[0]->ctx->pb);
+        if (size > 0) // FIXME improve avio_size() so it works with non seekable output too
+            total_size = size;
+    }
 
     vid = 0;
     av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
@@ -1908,6 +2301,18 @@ static void flush_encoders(void)
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+#if HAVE_THREADS
+        if (ost->enc_frame_queue) {
+            ret = encoder_thread_flush(of, ost);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_FATAL, "video encoding failed: %s\n",
+                       av_err2str(ret));
+                exit_program(1);
+            }
+            continue;
+        }
+#endif
+
         for (;;) {
             const char *desc = NULL;
             AVPacket pkt;
@@ -2128,6 +2533,7 @@ static int ifilter_has_all_input_formats(FilterGraph *fg)
 static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
 {
     FilterGraph *fg = ifilter->graph;
+    int64_t t0;
     int need_reinit, ret, i;
 
     /* determine if the parameters for this input changed */
@@ -2192,7 +2598,18 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         }
     }
 
+    t0  = bench_start();
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
+    bench_end(&ifilter->ist->bench[BENCH_FILTER], t0);
+    if (ret == AVERROR(EAGAIN)) {
+        /* the graph is over -filter_max_memory, encode its pending output
+         * first; the frame is accepted on the second try */
+        if ((ret = reap_filters(0)) < 0 && ret != AVERROR_EOF)
+            return ret;
+        t0  = bench_start();
+        ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
+        bench_end(&ifilter->ist->bench[BENCH_FILTER], t0);
+    }
     if (ret < 0) {
         if (ret != AVERROR_EOF)
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
@@ -2283,6 +2700,7 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
 {
     AVFrame *decoded_frame;
     AVCodecContext *avctx = ist->dec_ctx;
+    int64_t t0;
     int ret, err = 0;
     AVRational decoded_frame_tb;
 
@@ -2293,7 +2711,10 @@ static int decode_audio(InputStream *ist, AVPacket *pkt, int *got_output,
     decoded_frame = ist->decoded_frame;
 
     update_benchmark(NULL);
+    t0  = bench_start();
     ret = decode(avctx, decoded_frame, got_output, pkt);
+    if (pkt || *got_output)
+        bench_end(&ist->bench[BENCH_DECODE], t0);
     update_benchmark("decode_audio %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2347,6 +2768,7 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     int i, ret = 0, err = 0;
     int64_t best_effort_timestamp;
     int64_t dts = AV_NOPTS_VALUE;
+    int64_t t0;
     AVPacket avpkt;
 
     // With fate-indeo3-2, we're getting 0-sized packets before EOF for some
@@ -2378,7 +2800,11 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
+    t0  = bench_start();
     ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt ? &avpkt : NULL);
+    /* the empty calls draining further frames from a packet are not counted */
+    if (pkt || *got_output)
+        bench_end(&ist->bench[BENCH_DECODE], t0);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2995,6 +3421,11 @@ static int check_init_output_file(OutputFile *of, int file_index)
     if (sdp_filename || want_sdp)
         print_sdp();
 
+#if HAVE_THREADS
+    if ((ret = init_output_thread(of)) < 0)
+        return ret;
+#endif
+
     /* flush the muxing queues */
     for (i = 0; i < of->ctx->nb_streams; i++) {
         OutputStream *ost = output_streams[of->ost_index + i];
@@ -3635,6 +4066,12 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
     if (ret < 0)
         return ret;
 
+#if HAVE_THREADS
+    ret = init_encoder_thread(ost);
+    if (ret < 0)
+        return ret;
+#endif
+
     ost->initialized = 1;
 
     ret = check_init_output_file(output_files[ost->file_index], ost->file_index);
@@ -3842,7 +4279,7 @@ static int need_output(void)
         AVFormatContext *os  = output_files[ost->file_index]->ctx;
 
         if (ost->finished ||
-            (os->pb && avio_tell(os->pb) >= of->limit_filesize))
+            (os->pb && output_file_size(of) >= of->limit_filesize))
             continue;
         if (ost->frame_number >= ost->max_frames) {
             int j;
@@ -4016,7 +4453,161 @@ static int check_keyboard_interaction(int64_t cur_time)
     return 0;
 }
 
+/* account the time taken by av_read_frame() to the stream that got the packet */
+static void bench_demux(InputFile *f, const AVPacket *pkt, int64_t t0)
+{
+    if (benchmark_json && pkt->stream_index < f->nb_streams)
+        bench_end(&input_streams[f->ist_index + pkt->stream_index]->bench[BENCH_DEMUX], t0);
+}
+
 #if HAVE_THREADS
+/* a packet queued by input_thread(), with its timestamp in AV_TIME_BASE */
+typedef struct InputQueueEntry {
+    AVPacket pkt;
+    int64_t ts;
+} InputQueueEntry;
+
+static int64_t input_queue_ts(InputFile *f, const AVPacket *pkt)
+{
+    int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+
+    if (ts == AV_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+    return av_rescale_q(ts, f->ctx->streams[pkt->stream_index]->time_base,
+                        AV_TIME_BASE_Q);
+}
+
+/*
+ * Return the name of the option limiting the queue if a packet of the given
+ * size and timestamp does not fit in it, NULL otherwise. A packet always
+ * fits in an empty queue.
+ */
+static const char *input_queue_full(InputFile *f, int size, int64_t ts)
+{
+    if (!f->queued_packets)
+        return NULL;
+    if (f->queued_packets >= f->queue_limit)
+        return f->queue_limit < f->thread_queue_max_size ? "thread_queue_size" :
+                                                           "thread_queue_max_size";
+    if (f->thread_queue_bytes && f->queued_bytes + size > f->thread_queue_bytes)
+        return "thread_queue_bytes";
+    if (f->thread_queue_duration && ts != AV_NOPTS_VALUE &&
+        f->queue_out_ts != AV_NOPTS_VALUE &&
+        ts - f->queue_out_ts > f->thread_queue_duration)
+        return "thread_queue_duration";
+    return NULL;
+}
+
+/*
+ * Queue a packet for the main thread, waiting while the queue is over one of
+ * its limits. If *flags is non-blocking, warn the first time this happens
+ * and block from then on.
+ */
+static int input_queue_send(InputFile *f, AVPacket *pkt, unsigned *flags)
+{
+    InputQueueEntry entry = { .ts = input_queue_ts(f, pkt) };
+    const char *limit;
+    int ret;
+
+    pthread_mutex_lock(&f->queue_lock);
+    if ((limit = input_queue_full(f, pkt->size, entry.ts))) {
+        int64_t t0 = av_gettime_relative();
+
+        if (*flags) {
+            *flags = 0;
+            av_log(f->ctx, AV_LOG_WARNING,
+                   "Thread message queue blocking; consider raising the "
+                   "%s option\n", limit);
+        }
+        f->nb_demux_stalls++;
+        f->queue_full = 1;
+        while (input_queue_full(f, pkt->size, entry.ts))
+            pthread_cond_wait(&f->queue_cond, &f->queue_lock);
+        f->demux_stall_time += av_gettime_relative() - t0;
+    }
+    if (!f->queued_packets || f->queue_out_ts == AV_NOPTS_VALUE)
+        f->queue_out_ts = entry.ts;
+    f->queued_packets++;
+    f->queued_bytes += pkt->size;
+    pthread_mutex_unlock(&f->queue_lock);
+
+    /* the queue is allocated for the largest limit, so this does not block */
+    av_packet_move_ref(&entry.pkt, pkt);
+    ret = av_thread_message_queue_send(f->in_thread_queue, &entry, 0);
+    if (ret < 0) {
+        av_packet_move_ref(pkt, &entry.pkt);
+        pthread_mutex_lock(&f->queue_lock);
+        f->queued_packets--;
+        f->queued_bytes -= pkt->size;
+        pthread_mutex_unlock(&f->queue_lock);
+    }
+    return ret;
+}
+
+/*
+ * Adapt the packet limit of the queue to how the main thread consumes it:
+ * double it when the main thread had to wait for the demuxer, and reduce it
+ * by a quarter when the demuxer had to wait while the queue never ran dry
+ * over four times its length. Called with queue_lock held.
+ */
+static void input_queue_adapt(InputFile *f, int starved)
+{
+    int limit = f->queue_limit;
+
+    if (starved)
+        limit = FFMIN(limit * 2, f->thread_queue_max_size);
+    else if (++f->queue_reads >= 4 * limit && f->queue_full)
+        limit = FFMAX(limit - limit / 4, f->thread_queue_size);
+    else
+        return;
+
+    if (limit != f->queue_limit)
+        av_log(f->ctx, AV_LOG_DEBUG, "Input thread queue limit %d -> %d packets\n",
+               f->queue_limit, limit);
+    f->queue_limit = limit;
+    f->queue_reads = 0;
+    f->queue_full  = 0;
+}
+
+static int input_queue_recv(InputFile *f, AVPacket *pkt, unsigned flags)
+{
+    InputQueueEntry entry;
+    int64_t wait_start = AV_NOPTS_VALUE;
+    int ret;
+
+    /* only a blocking receive makes the main thread wait for the demuxer;
+     * finding the queue empty when polling it is not a stall */
+    if (!(flags & AV_THREAD_MESSAGE_NONBLOCK)) {
+        pthread_mutex_lock(&f->queue_lock);
+        if (!f->queued_packets)
+            wait_start = av_gettime_relative();
+        pthread_mutex_unlock(&f->queue_lock);
+    }
+
+    ret = av_thread_message_queue_recv(f->in_thread_queue, &entry, flags);
+    if (ret < 0)
+        return ret;
+    av_packet_move_ref(pkt, &entry.pkt);
+
+    pthread_mutex_lock(&f->queue_lock);
+    f->queued_packets--;
+    f->queued_bytes -= pkt->size;
+    if (entry.ts != AV_NOPTS_VALUE)
+        f->queue_out_ts = entry.ts;
+    if (wait_start != AV_NOPTS_VALUE) {
+        f->nb_read_stalls++;
+        f->read_stall_time += av_gettime_relative() - wait_start;
+        /* the first packet was not late, it was just not read yet */
+        input_queue_adapt(f, f->nb_read_stalls > 1);
+    } else {
+        input_queue_adapt(f, 0);
+    }
+    pthread_cond_signal(&f->queue_cond);
+    pthread_mutex_unlock(&f->queue_lock);
+
+    return ret;
+}
+
 static void *input_thread(void *arg)
 {
     InputFile *f = arg;
@@ -4025,7 +4616,10 @@ static void *input_thread(void *arg)
 
     while (1) {
         AVPacket pkt;
+        int64_t t0 = bench_start();
         ret = av_read_frame(f->ctx, &pkt);
+        if (ret >= 0)
+            bench_demux(f, &pkt, t0);
 
         if (ret == AVERROR(EAGAIN)) {
             av_usleep(10000);
@@ -4035,15 +4629,7 @@ static void *input_thread(void *arg)
             av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
             break;
         }
-        ret = av_thread_message_queue_send(f->in_thread_queue, &pkt, flags);
-        if (flags && ret == AVERROR(EAGAIN)) {
-            flags = 0;
-            ret = av_thread_message_queue_send(f->in_thread_queue, &pkt, flags);
-            av_log(f->ctx, AV_LOG_WARNING,
-                   "Thread message queue blocking; consider raising the "
-                   "thread_queue_size option (current value: %d)\n",
-                   f->thread_queue_size);
-        }
+        ret = input_queue_send(f, &pkt, &flags);
         if (ret < 0) {
             if (ret != AVERROR_EOF)
                 av_log(f->ctx, AV_LOG_ERROR,
@@ -4066,12 +4652,20 @@ static void free_input_thread(int i)
     if (!f || !f->in_thread_queue)
         return;
     av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
-    while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
+    while (input_queue_recv(f, &pkt, 0) >= 0)
         av_packet_unref(&pkt);
 
     pthread_join(f->thread, NULL);
     f->joined = 1;
     av_thread_message_queue_free(&f->in_thread_queue);
+    pthread_cond_destroy(&f->queue_cond);
+    pthread_mutex_destroy(&f->queue_lock);
+
+    av_log(f->ctx, AV_LOG_VERBOSE,
+           "Input thread: demuxer waited %"PRIu64" times (%.3fs) for room in the queue, "
+           "main thread waited %"PRIu64" times (%.3fs) for packets, final limit %d packets\n",
+           f->nb_demux_stalls, f->demux_stall_time / 1000000.0,
+           f->nb_read_stalls, f->read_stall_time / 1000000.0, f->queue_limit);
 }
 
 static void free_input_threads(void)
@@ -4094,12 +4688,27 @@ static int init_input_thread(int i)
         strcmp(f->ctx->iformat->name, "lavfi"))
         f->non_blocking = 1;
     ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                        f->thread_queue_size, sizeof(AVPacket));
+                                        f->thread_queue_max_size,
+                                        sizeof(InputQueueEntry));
     if (ret < 0)
         return ret;
 
+    f->queue_limit  = f->thread_queue_size;
+    f->queue_out_ts = AV_NOPTS_VALUE;
+    if ((ret = pthread_mutex_init(&f->queue_lock, NULL))) {
+        av_thread_message_queue_free(&f->in_thread_queue);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&f->queue_cond, NULL))) {
+        pthread_mutex_destroy(&f->queue_lock);
+        av_thread_message_queue_free(&f->in_thread_queue);
+        return AVERROR(ret);
+    }
+
     if ((ret = pthread_create(&f->thread, NULL, input_thread, f))) {
         av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        pthread_cond_destroy(&f->queue_cond);
+        pthread_mutex_destroy(&f->queue_lock);
         av_thread_message_queue_free(&f->in_thread_queue);
         return AVERROR(ret);
     }
@@ -4121,14 +4730,19 @@ static int init_input_threads(void)
 
 static int get_input_packet_mt(InputFile *f, AVPacket *pkt)
 {
-    return av_thread_message_queue_recv(f->in_thread_queue, pkt,
-                                        f->non_blocking ?
-                                        AV_THREAD_MESSAGE_NONBLOCK : 0);
+    int ret = input_queue_recv(f, pkt, f->non_blocking ?
+                                       AV_THREAD_MESSAGE_NONBLOCK : 0);
+    if (ret >= 0 && benchmark_json)
+        bench_hist_add(&f->queue_depth, av_thread_message_queue_nb_elems(f->in_thread_queue));
+    return ret;
 }
 #endif
 
 static int get_input_packet(InputFile *f, AVPacket *pkt)
 {
+    int64_t t0;
+    int ret;
+
     if (f->rate_emu) {
         int i;
         for (i = 0; i < f->nb_streams; i++) {
@@ -4144,7 +4758,11 @@ static int get_input_packet(InputFile *f, AVPacket *pkt)
     if (nb_input_files > 1)
         return get_input_packet_mt(f, pkt);
 #endif
-    return av_read_frame(f->ctx, pkt);
+    t0  = bench_start();
+    ret = av_read_frame(f->ctx, pkt);
+    if (ret >= 0)
+        bench_demux(f, pkt, t0);
+    return ret;
 }
 
 static int got_eagain(void)
@@ -4529,13 +5147,16 @@ discard_packet:
  */
 static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
 {
+    int64_t t0;
     int i, ret;
     int nb_requests, nb_requests_max = 0;
     InputFilter *ifilter;
     InputStream *ist;
 
     *best_ist = NULL;
+    t0  = bench_start();
     ret = avfilter_graph_request_oldest(graph->graph);
+    bench_end(&graph->bench, t0);
     if (ret >= 0)
         return reap_filters(0);
 
@@ -4571,6 +5192,11 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
 /**
  * Run a single step of transcoding.
  *
+ * Decoding and filtering always run here, on the main thread. Reading the
+ * inputs, encoding video with -encode_threads and writing the outputs with
+ * -mux_threads can run in threads of their own, connected to this one by
+ * bounded queues.
+ *
  * @return  0 for success, <0 for error
  */
 static int transcode_step(void)
@@ -4710,6 +5336,11 @@ static int transcode(void)
 
     term_exit();
 
+#if HAVE_THREADS
+    free_encoder_threads();
+    free_output_threads();
+#endif
+
     /* write the trailer if needed and close file */
     for (i = 0; i < nb_output_files; i++) {
         os = output_files[i]->ctx;
@@ -4730,6 +5361,13 @@ static int transcode(void)
     /* dump report by using the first video and audio streams */
     print_report(1, timer_start, av_gettime_relative());
 
+    if (filter_profile)
+        print_filter_profile();
+
+    if (benchmark_json && (ret = write_benchmark_json(benchmark_json)) < 0)
+        av_log(NULL, AV_LOG_ERROR, "Error writing benchmark file %s: %s\n",
+               benchmark_json, av_err2str(ret));
+
     /* close each encoder */
     for (i = 0; i < nb_output_streams; i++) {
         ost = output_streams[i];
@@ -4763,6 +5401,8 @@ static int transcode(void)
  fail:
 #if HAVE_THREADS
     free_input_threads();
+    free_encoder_threads();
+    free_output_threads();
 #endif
 
     if (output_streams) {
@@ -4839,8 +5479,7 @@ static void log_callback_null(void *ptr, int level, const char *fmt, va_list vl)
 
 int main(int argc, char **argv)
 {
-    int i, ret;
-    BenchmarkTimeStamps ti;
+    int ret;
 
     init_dynload();
 
@@ -4870,6 +5509,18 @@ int main(int argc, char **argv)
     if (ret < 0)
         exit_program(1);
 
+    if (server_url)
+        exit_program(run_server() < 0);
+
+    run_transcode();
+    return main_return_code;
+}
+
+void run_transcode(void)
+{
+    int i;
+    BenchmarkTimeStamps ti;
+
     if (nb_output_files <= 0 && nb_input_files == 0) {
         show_usage();
         av_log(NULL, AV_LOG_WARNING, "Use -h to get full help or, even better, run 'man %s'\n", program_name);
@@ -4906,5 +5557,4 @@ int main(int argc, char **argv)
         exit_program(69);
 
     exit_program(received_nb_signals ? 255 : main_return_code);
-    return main_return_code;
 }
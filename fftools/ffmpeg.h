@@ -21,6 +21,7 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <signal.h>
@@ -120,6 +121,9 @@ typedef struct OptionsContext {
     int rate_emu;
     int accurate_seek;
     int thread_queue_size;
+    int thread_queue_max_size;
+    int64_t thread_queue_bytes;
+    int64_t thread_queue_duration;
 
     SpecifierOpt *ts_scale;
     int        nb_ts_scale;
@@ -279,6 +283,29 @@ typedef struct OutputFilter {
     int *sample_rates;
 } OutputFilter;
 
+/* the stages timed for -benchmark_json */
+enum BenchStage {
+    BENCH_DEMUX,
+    BENCH_DECODE,
+    BENCH_FILTER,
+    BENCH_ENCODE,
+    BENCH_MUX,
+    BENCH_NB_STAGES,
+};
+
+#define BENCH_HIST_BUCKETS 40
+
+/*
+ * Distribution of a sampled value, a latency in microseconds or a queue
+ * depth. Bucket 0 counts zeros and bucket i values in [2^(i-1), 2^i).
+ */
+typedef struct BenchHistogram {
+    uint64_t count;
+    int64_t sum;
+    int64_t max;
+    uint64_t buckets[BENCH_HIST_BUCKETS];
+} BenchHistogram;
+
 typedef struct FilterGraph {
     int            index;
     const char    *graph_desc;
@@ -290,6 +317,8 @@ typedef struct FilterGraph {
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+    BenchHistogram bench;   /* time spent running the graph on request */
 } FilterGraph;
 
 typedef struct InputStream {
@@ -388,6 +417,9 @@ typedef struct InputStream {
     int nb_dts_buffer;
 
     int got_output;
+
+    /* time taken to read, decode and push each packet or frame into the filters */
+    BenchHistogram bench[BENCH_NB_STAGES];
 } InputStream;
 
 typedef struct InputFile {
@@ -417,8 +449,30 @@ typedef struct InputFile {
     pthread_t thread;           /* thread reading from this file */
     int non_blocking;           /* reading packets from the thread should not block */
     int joined;                 /* the thread has been joined */
-    int thread_queue_size;      /* maximum number of queued packets */
+    int thread_queue_size;      /* initial and smallest limit on the number of queued packets */
+    int thread_queue_max_size;  /* largest limit on the number of queued packets */
+    int64_t thread_queue_bytes;     /* maximum size of the queued packets, 0 for no limit */
+    int64_t thread_queue_duration;  /* maximum span of the queued packets in AV_TIME_BASE, 0 for no limit */
+
+    /* state of the queue shared with the thread, protected by queue_lock */
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_cond;  /* signaled when packets are taken from the queue */
+    int queue_limit;            /* current limit on the number of queued packets */
+    int queued_packets;
+    int64_t queued_bytes;
+    int64_t queue_out_ts;       /* timestamp of the oldest queued packet or of the last one
+                                   taken in AV_TIME_BASE, the queue duration is measured from it */
+    int queue_reads;            /* packets taken since the limit last changed */
+    int queue_full;             /* the thread had to wait since the limit last changed */
+
+    /* stall counters */
+    uint64_t nb_demux_stalls;   /* times the thread waited for room in the queue */
+    int64_t demux_stall_time;   /* total time it waited, in microseconds */
+    uint64_t nb_read_stalls;    /* times the main thread waited on an empty queue */
+    int64_t read_stall_time;    /* total time until a packet was available */
 #endif
+
+    BenchHistogram queue_depth; /* packets left queued by the thread on every read */
 } InputFile;
 
 enum forced_keyframes_const {
@@ -549,6 +603,16 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *enc_frame_queue;  /* frames waiting for the encoding thread */
+    AVThreadMessageQueue *enc_pkt_queue;    /* packets coming back from it */
+    pthread_t enc_thread;                   /* thread running the video encoder */
+#endif
+
+    /* time taken to pull each frame from the filters, encode it and mux each packet */
+    BenchHistogram bench[BENCH_NB_STAGES];
+    BenchHistogram enc_queue_depth;         /* frames waiting for the encoding thread */
 } OutputStream;
 
 typedef struct OutputFile {
@@ -562,6 +626,15 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *mux_queue;
+    pthread_t mux_thread;           /* thread writing packets to this file */
+    int thread_queue_size;          /* maximum number of queued packets */
+    atomic_int_least64_t mux_size;  /* bytes written so far, updated by the thread */
+#endif
+
+    BenchHistogram queue_depth;     /* packets waiting for the muxing thread */
 } OutputFile;
 
 extern InputStream **input_streams;
@@ -609,7 +682,17 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern char *filter_thread_type;
+extern char *filter_max_memory;
+extern int filter_profile;
 extern int vstats_version;
+extern int mux_threads;
+extern char *benchmark_json;
+extern char *server_url;
+extern char *server_warmup;
+extern int server_jobs;
+extern int encode_threads;
+extern int encode_queue_size;
 
 extern const AVIOInterruptCB int_cb;
 
@@ -641,6 +724,7 @@ void choose_sample_fmt(AVStream *st, AVCodec *codec);
 int configure_filtergraph(FilterGraph *fg);
 int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOut *out);
 void check_filter_outputs(void);
+void print_filter_profile(void);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
 int filtergraph_is_simple(FilterGraph *fg);
 int init_simple_filtergraph(InputStream *ist, OutputStream *ost);
@@ -665,4 +749,18 @@ int hw_device_setup_for_encode(OutputStream *ost);
 
 int hwaccel_decode_init(AVCodecContext *avctx);
 
+void bench_hist_add(BenchHistogram *h, int64_t value);
+int write_benchmark_json(const char *filename);
+
+/**
+ * Transcode as set up by ffmpeg_parse_options() and exit.
+ */
+void run_transcode(void) av_noreturn;
+
+/**
+ * Run jobs read from server_url until there are no more or the server is
+ * stopped, see -server.
+ */
+int run_server(void);
+
 #endif /* FFTOOLS_FFMPEG_H */
@@ -0,0 +1,195 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Per-stage latency and queue depth histograms written by -benchmark_json.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avutil.h"
+#include "libavutil/bprint.h"
+#include "libavutil/common.h"
+
+#include "ffmpeg.h"
+
+void bench_hist_add(BenchHistogram *h, int64_t value)
+{
+    int bucket = 0;
+
+    if (value > 0)
+        bucket = FFMIN(av_log2(FFMIN(value, UINT_MAX)) + 1, BENCH_HIST_BUCKETS - 1);
+    h->count++;
+    h->sum += value;
+    h->max  = FFMAX(h->max, value);
+    h->buckets[bucket]++;
+}
+
+static void print_json_string(AVBPrint *bp, const char *str)
+{
+    av_bprint_chars(bp, '"', 1);
+    for (; str && *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\')
+            av_bprintf(bp, "\\%c", c);
+        else if (c < 0x20)
+            av_bprintf(bp, "\\u%04x", c);
+        else
+            av_bprint_chars(bp, c, 1);
+    }
+    av_bprint_chars(bp, '"', 1);
+}
+
+/* buckets are only listed when non-empty, each with its exclusive upper bound */
+static void print_hist(AVBPrint *bp, const char *name, const BenchHistogram *h)
+{
+    int i, first = 1;
+
+    av_bprintf(bp, "\"%s\": { \"count\": %"PRIu64", \"sum\": %"PRId64", \"max\": %"PRId64", \"buckets\": [",
+               name, h->count, h->sum, h->max);
+    for (i = 0; i < BENCH_HIST_BUCKETS; i++) {
+        if (!h->buckets[i])
+            continue;
+        av_bprintf(bp, "%s{ \"lt\": %"PRIu64", \"count\": %"PRIu64" }",
+                   first ? " " : ", ", (uint64_t)1 << i, h->buckets[i]);
+        first = 0;
+    }
+    av_bprintf(bp, "%s] }", first ? "" : " ");
+}
+
+static const char *stream_type(enum AVMediaType type)
+{
+    const char *str = av_get_media_type_string(type);
+    return str ? str : "unknown";
+}
+
+static void print_inputs(AVBPrint *bp)
+{
+    int i, j;
+
+    av_bprintf(bp, "  \"inputs\": [");
+    for (i = 0; i < nb_input_files; i++) {
+        InputFile *f = input_files[i];
+
+        av_bprintf(bp, "%s\n    { \"index\": %d, \"url\": ", i ? "," : "", i);
+        print_json_string(bp, f->ctx->url);
+        av_bprintf(bp, ",\n      ");
+        print_hist(bp, "queue_depth", &f->queue_depth);
+#if HAVE_THREADS
+        av_bprintf(bp, ",\n      \"stalls\": { \"demux\": %"PRIu64", \"demux_time\": %"PRId64", "
+                   "\"read\": %"PRIu64", \"read_time\": %"PRId64", \"queue_limit\": %d }",
+                   f->nb_demux_stalls, f->demux_stall_time,
+                   f->nb_read_stalls, f->read_stall_time, f->queue_limit);
+#endif
+        av_bprintf(bp, ",\n      \"streams\": [");
+        for (j = 0; j < f->nb_streams; j++) {
+            InputStream *ist = input_streams[f->ist_index + j];
+
+            av_bprintf(bp, "%s\n        { \"index\": %d, \"type\": \"%s\",\n          ",
+                       j ? "," : "", j, stream_type(ist->st->codecpar->codec_type));
+            print_hist(bp, "demux", &ist->bench[BENCH_DEMUX]);
+            av_bprintf(bp, ",\n          ");
+            print_hist(bp, "decode", &ist->bench[BENCH_DECODE]);
+            av_bprintf(bp, ",\n          ");
+            print_hist(bp, "filter", &ist->bench[BENCH_FILTER]);
+            av_bprintf(bp, " }");
+        }
+        av_bprintf(bp, "%s] }", j ? "\n      " : "");
+    }
+    av_bprintf(bp, "%s]", i ? "\n  " : "");
+}
+
+static void print_outputs(AVBPrint *bp)
+{
+    int i, j;
+
+    av_bprintf(bp, "  \"outputs\": [");
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+
+        av_bprintf(bp, "%s\n    { \"index\": %d, \"url\": ", i ? "," : "", i);
+        print_json_string(bp, of->ctx->url);
+        av_bprintf(bp, ",\n      ");
+        print_hist(bp, "queue_depth", &of->queue_depth);
+        av_bprintf(bp, ",\n      \"streams\": [");
+        for (j = 0; j < of->ctx->nb_streams; j++) {
+            OutputStream *ost = output_streams[of->ost_index + j];
+
+            av_bprintf(bp, "%s\n        { \"index\": %d, \"type\": \"%s\",\n          ",
+                       j ? "," : "", j, stream_type(ost->st->codecpar->codec_type));
+            print_hist(bp, "filter", &ost->bench[BENCH_FILTER]);
+            av_bprintf(bp, ",\n          ");
+            print_hist(bp, "encode", &ost->bench[BENCH_ENCODE]);
+            av_bprintf(bp, ",\n          ");
+            print_hist(bp, "queue_depth", &ost->enc_queue_depth);
+            av_bprintf(bp, ",\n          ");
+            print_hist(bp, "mux", &ost->bench[BENCH_MUX]);
+            av_bprintf(bp, " }");
+        }
+        av_bprintf(bp, "%s] }", j ? "\n      " : "");
+    }
+    av_bprintf(bp, "%s]", i ? "\n  " : "");
+}
+
+static void print_filtergraphs(AVBPrint *bp)
+{
+    int i;
+
+    av_bprintf(bp, "  \"filtergraphs\": [");
+    for (i = 0; i < nb_filtergraphs; i++) {
+        av_bprintf(bp, "%s\n    { \"index\": %d, ", i ? "," : "", i);
+        print_hist(bp, "filter", &filtergraphs[i]->bench);
+        av_bprintf(bp, " }");
+    }
+    av_bprintf(bp, "%s]", i ? "\n  " : "");
+}
+
+int write_benchmark_json(const char *filename)
+{
+    AVBPrint bp;
+    FILE *f;
+    int ret = 0;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "{\n  \"unit\": \"us\",\n");
+    print_inputs(&bp);
+    av_bprintf(&bp, ",\n");
+    print_outputs(&bp);
+    av_bprintf(&bp, ",\n");
+    print_filtergraphs(&bp);
+    av_bprintf(&bp, "\n}\n");
+    if (!av_bprint_is_complete(&bp)) {
+        av_bprint_finalize(&bp, NULL);
+        return AVERROR(ENOMEM);
+    }
+
+    f = strcmp(filename, "-") ? fopen(filename, "w") : stdout;
+    if (!f) {
+        ret = AVERROR(errno);
+    } else {
+        if (fwrite(bp.str, 1, bp.len, f) != bp.len)
+            ret = AVERROR(EIO);
+        if (f != stdout && fclose(f))
+            ret = AVERROR(errno);
+    }
+    av_bprint_finalize(&bp, NULL);
+    return ret;
+}
@@ -1052,6 +1052,14 @@ int configure_filtergraph(FilterGraph *fg)
         fg->graph->nb_threads = filter_complex_nbthreads;
     }
 
+    if (filter_thread_type &&
+        (ret = av_opt_set(fg->graph, "thread_type", filter_thread_type, 0)) < 0)
+        goto fail;
+    if (filter_max_memory &&
+        (ret = av_opt_set(fg->graph, "max_frame_memory", filter_max_memory, 0)) < 0)
+        goto fail;
+    fg->graph->profile = filter_profile;
+
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
 
@@ -1217,3 +1225,40 @@ int filtergraph_is_simple(FilterGraph *fg)
 {
     return !fg->graph_desc;
 }
+
+void print_filter_profile(void)
+{
+    int i, j, k;
+
+    for (i = 0; i < nb_filtergraphs; i++) {
+        AVFilterGraph *graph = filtergraphs[i]->graph;
+
+        if (!graph)
+            continue;
+        av_log(NULL, AV_LOG_INFO, "Filtergraph #%d profile (times in ms):\n", i);
+        av_log(NULL, AV_LOG_INFO, "  %-24s %8s %10s %10s %10s %15s %19s %6s\n",
+               "filter", "runs", "wall", "cpu", "filter_frame",
+               "frames in/out", "samples in/out", "queue");
+        for (j = 0; j < graph->nb_filters; j++) {
+            AVFilterContext *filter = graph->filters[j];
+            AVFilterProfile p;
+            char frames[32], samples[48];
+
+            if (avfilter_get_profile(filter, &p) < 0)
+                continue;
+            snprintf(frames,  sizeof(frames),  "%"PRId64"/%"PRId64, p.frames_in, p.frames_out);
+            snprintf(samples, sizeof(samples), "%"PRId64"/%"PRId64, p.samples_in, p.samples_out);
+            av_log(NULL, AV_LOG_INFO, "  %-24s %8"PRId64" %10.3f %10.3f %10.3f %15s %19s %6"PRId64"\n",
+                   filter->name, p.nb_runs, p.wall_time / 1000.0, p.cpu_time / 1000.0,
+                   p.frame_time / 1000.0, frames, samples, p.max_queued);
+            if (filter->nb_inputs < 2)
+                continue;
+            for (k = 0; k < filter->nb_inputs; k++) {
+                AVFilterLink *link = filter->inputs[k];
+                av_log(NULL, AV_LOG_INFO, "    %-22s %8s %10s %10s %10s %15"PRId64" %19s %6"PRId64"\n",
+                       avfilter_pad_get_name(filter->input_pads, k), "", "", "", "", link->frame_count_in,
+                       "", link->max_queued);
+            }
+        }
+    }
+}
@@ -94,6 +94,7 @@ float frame_drop_threshold = 0;
 int do_deinterlace    = 0;
 int do_benchmark      = 0;
 int do_benchmark_all  = 0;
+char *benchmark_json = NULL;
 int do_hex_dump       = 0;
 int do_pkt_dump       = 0;
 int copy_ts           = 0;
@@ -109,7 +110,13 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+char *filter_thread_type;
+char *filter_max_memory;
+int filter_profile = 0;
 int vstats_version = 2;
+int mux_threads = -1;
+int encode_threads = 0;
+int encode_queue_size = 8;
 
 
 static int intra_only         = 0;
@@ -1212,6 +1219,10 @@ static int open_input_file(OptionsContext *o, const char *filename)
     f->time_base = (AVRational){ 1, 1 };
 #if HAVE_THREADS
     f->thread_queue_size = o->thread_queue_size > 0 ? o->thread_queue_size : 8;
+    f->thread_queue_max_size = FFMAX(o->thread_queue_max_size > 0 ? o->thread_queue_max_size : 256,
+                                     f->thread_queue_size);
+    f->thread_queue_bytes    = o->thread_queue_bytes > 0 ? o->thread_queue_bytes : 64 << 20;
+    f->thread_queue_duration = FFMAX(o->thread_queue_duration, 0);
 #endif
 
     /* check if all codec options have been used */
@@ -2142,6 +2153,9 @@ static int open_output_file(OptionsContext *o, const char *filename)
     of->start_time     = o->start_time;
     of->limit_filesize = o->limit_filesize;
     of->shortest       = o->shortest;
+#if HAVE_THREADS
+    of->thread_queue_size = o->thread_queue_size > 0 ? o->thread_queue_size : 8;
+#endif
     av_dict_copy(&of->opts, o->g->format_opts, 0);
 
     if (!strcmp(filename, "-"))
@@ -3341,6 +3355,15 @@ fail:
     return ret;
 }
 
+static int opt_server(void *optctx, const char *opt, const char *arg)
+{
+    av_free(server_url);
+    server_url = av_strdup(arg);
+    /* the standard input is for jobs, or for nothing at all */
+    stdin_interaction = 0;
+    return server_url ? 0 : AVERROR(ENOMEM);
+}
+
 static int opt_progress(void *optctx, const char *opt, const char *arg)
 {
     AVIOContext *avio = NULL;
@@ -3434,6 +3457,14 @@ const OptionDef options[] = {
         "add timings for benchmarking" },
     { "benchmark_all",  OPT_BOOL | OPT_EXPERT,                       { &do_benchmark_all },
       "add timings for each task" },
+    { "benchmark_json", HAS_ARG | OPT_STRING | OPT_EXPERT,           { &benchmark_json },
+      "write per-stage latency histograms to a JSON file", "file" },
+    { "server",         HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_server },
+      "run jobs read from stdin (-) or a UNIX socket", "url" },
+    { "server_jobs",    HAS_ARG | OPT_INT | OPT_EXPERT,              { &server_jobs },
+      "set the number of jobs the server runs at a time", "number" },
+    { "server_warmup",  HAS_ARG | OPT_STRING | OPT_EXPERT,           { &server_warmup },
+      "set the codecs the server initializes for all its jobs", "codecs" },
     { "progress",       HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
     { "stdin",          OPT_BOOL | OPT_EXPERT,                       { &stdin_interaction },
@@ -3511,6 +3542,13 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_thread_type", HAS_ARG | OPT_STRING | OPT_EXPERT,       { &filter_thread_type },
+        "set the allowed kinds of filter threading (slice, frame)", "flags" },
+    { "filter_max_memory", HAS_ARG | OPT_STRING | OPT_EXPERT,        { &filter_max_memory },
+        "set the size of the video frame buffers of each filtergraph "
+        "beyond which its outputs are drained before new frames are sent", "size" },
+    { "filter_profile", OPT_BOOL | OPT_EXPERT,                       { &filter_profile },
+        "print processing statistics of each filter at the end" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -3535,9 +3573,24 @@ const OptionDef options[] = {
     { "disposition",    OPT_STRING | HAS_ARG | OPT_SPEC |
                         OPT_OUTPUT,                                  { .off = OFFSET(disposition) },
         "disposition", "" },
-    { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+    { "mux_threads",    HAS_ARG | OPT_INT | OPT_EXPERT,              { &mux_threads },
+        "write each output file from its own thread (-1 for when there are several)" },
+    { "encode_threads", OPT_BOOL | OPT_EXPERT,                       { &encode_threads },
+        "run each video encoder in its own thread" },
+    { "encode_queue_size", HAS_ARG | OPT_INT | OPT_EXPERT,           { &encode_queue_size },
+        "set the maximum number of frames queued for each encoding thread" },
+    { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT | OPT_OUTPUT,
                                                                      { .off = OFFSET(thread_queue_size) },
-        "set the maximum number of queued packets from the demuxer" },
+        "set the maximum number of queued packets from the demuxer or to the muxer" },
+    { "thread_queue_max_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+                                                                     { .off = OFFSET(thread_queue_max_size) },
+        "set the number of queued packets from the demuxer the queue may grow to" },
+    { "thread_queue_bytes", HAS_ARG | OPT_INT64 | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+                                                                     { .off = OFFSET(thread_queue_bytes) },
+        "set the maximum size in bytes of the packets queued from the demuxer" },
+    { "thread_queue_duration", HAS_ARG | OPT_TIME | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+                                                                     { .off = OFFSET(thread_queue_duration) },
+        "set the maximum duration of the packets queued from the demuxer" },
     { "find_stream_info", OPT_BOOL | OPT_PERFILE | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
         "read and decode the streams to fill missing information with heuristics" },
 
@@ -0,0 +1,654 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Job server mode of ffmpeg, see -server.
+ *
+ * The server reads one job per line from its standard input or from the
+ * clients of a UNIX socket. A line holds a job name followed by the usual
+ * ffmpeg arguments. Every job runs in a process forked from the server,
+ * which starts with everything the server already initialized: loaded
+ * libraries, network, the global options of the server and the static
+ * tables of the codecs warmed up with -server_warmup. Nothing else carries
+ * over: each job parses its options, probes its inputs and opens its codecs
+ * and filter graphs as a plain ffmpeg run would. Progress and the exit
+ * status of each job are reported to whoever sent it, one line at a time:
+ *
+ *   <name> started <pid>
+ *   <name> progress <key=value ...>
+ *   <name> done <exit code>
+ *   <name> killed <signal>
+ *   <name> error <message>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if HAVE_FORK && HAVE_POLL_H && HAVE_SYS_UN_H
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "libavcodec/avcodec.h"
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+
+#include "ffmpeg.h"
+
+char *server_url;
+char *server_warmup;
+int server_jobs;
+
+#if HAVE_FORK && HAVE_POLL_H && HAVE_SYS_UN_H
+
+#define SERVER_LINE_SIZE 16384
+
+typedef struct ServerClient {
+    int in_fd;                  /* where jobs are read from */
+    int out_fd;                 /* where their status is written to */
+    char buf[SERVER_LINE_SIZE];
+    int len;
+    int eof;                    /* no more jobs will come from this client */
+} ServerClient;
+
+typedef struct ServerJob {
+    char *name;
+    char *args;
+    ServerClient *client;       /* NULL once the client went away */
+    pid_t pid;                  /* 0 while the job is waiting to be started */
+    int progress_fd;            /* reading end of the -progress pipe of the job */
+    char buf[4096];
+    int len;
+    AVBPrint progress;          /* key=value pairs of the current progress block */
+} ServerJob;
+
+static ServerClient **clients;
+static int         nb_clients;
+static ServerJob  **jobs;
+static int         nb_jobs;
+static int         listen_fd = -1;
+
+static volatile sig_atomic_t server_quit;
+
+static void server_sigterm_handler(int sig)
+{
+    server_quit = 1;
+}
+
+static void server_reply(ServerClient *c, const char *name, const char *fmt, ...)
+{
+    AVBPrint bp;
+    va_list va;
+    const char *p;
+    int n;
+
+    if (!c || c->out_fd < 0)
+        return;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "%s ", name);
+    va_start(va, fmt);
+    av_vbprintf(&bp, fmt, va);
+    va_end(va);
+    av_bprint_chars(&bp, '\n', 1);
+
+    /* a client that cannot be written to does not get any more replies */
+    for (p = bp.str; av_bprint_is_complete(&bp) && p < bp.str + bp.len; p += n) {
+        n = write(c->out_fd, p, bp.str + bp.len - p);
+        if (n < 0 && errno == EINTR) {
+            n = 0;
+        } else if (n <= 0) {
+            c->out_fd = -1;
+            break;
+        }
+    }
+    av_bprint_finalize(&bp, NULL);
+}
+
+static void free_job(ServerJob **pjob)
+{
+    ServerJob *job = *pjob;
+
+    if (!job)
+        return;
+    if (job->progress_fd >= 0)
+        close(job->progress_fd);
+    av_bprint_finalize(&job->progress, NULL);
+    av_freep(&job->name);
+    av_freep(&job->args);
+    av_freep(pjob);
+}
+
+static void remove_job(int i)
+{
+    free_job(&jobs[i]);
+    memmove(jobs + i, jobs + i + 1, (nb_jobs - i - 1) * sizeof(*jobs));
+    nb_jobs--;
+}
+
+static void remove_client(int i)
+{
+    ServerClient *c = clients[i];
+    int j;
+
+    for (j = 0; j < nb_jobs; j++)
+        if (jobs[j]->client == c)
+            jobs[j]->client = NULL;
+    if (c->in_fd > 2)
+        close(c->in_fd);
+    if (c->out_fd > 2 && c->out_fd != c->in_fd)
+        close(c->out_fd);
+    av_freep(&clients[i]);
+    clients[i] = clients[--nb_clients];
+}
+
+static int client_has_jobs(const ServerClient *c)
+{
+    int i;
+
+    for (i = 0; i < nb_jobs; i++)
+        if (jobs[i]->client == c)
+            return 1;
+    return 0;
+}
+
+static int add_client(int in_fd, int out_fd)
+{
+    ServerClient *c = av_mallocz(sizeof(*c));
+
+    if (!c)
+        return AVERROR(ENOMEM);
+    c->in_fd  = in_fd;
+    c->out_fd = out_fd;
+    av_dynarray_add(&clients, &nb_clients, c);
+    return clients ? 0 : AVERROR(ENOMEM);
+}
+
+static void queue_job(ServerClient *c, const char *line)
+{
+    ServerJob *job;
+    char *name;
+
+    while (*line == ' ' || *line == '\t')
+        line++;
+    if (!*line)
+        return;
+
+    name = av_get_token(&line, " \t");
+    job  = av_mallocz(sizeof(*job));
+    if (!name || !job || !(job->args = av_strdup(line))) {
+        av_free(name);
+        av_free(job);
+        server_reply(c, "-", "error out of memory");
+        return;
+    }
+    job->name        = name;
+    job->client      = c;
+    job->progress_fd = -1;
+    av_bprint_init(&job->progress, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_dynarray_add(&jobs, &nb_jobs, job);
+    if (!jobs) {
+        server_reply(c, name, "error out of memory");
+        free_job(&job);
+        nb_jobs = 0;
+    }
+}
+
+/* Split the arguments of a job, which may be quoted with '' or escaped with \. */
+static char **split_args(const char *args, const char *progress_url, int *argc)
+{
+    char **argv = NULL, *arg;
+    int n = 0;
+
+    if (!(arg = av_strdup(program_name)))
+        goto fail;
+    av_dynarray_add(&argv, &n, arg);
+    if (!(arg = av_strdup("-progress")))
+        goto fail;
+    av_dynarray_add(&argv, &n, arg);
+    if (!(arg = av_strdup(progress_url)))
+        goto fail;
+    av_dynarray_add(&argv, &n, arg);
+
+    while (argv) {
+        args += strspn(args, " \t");
+        if (!*args)
+            break;
+        if (!(arg = av_get_token(&args, " \t")))
+            goto fail;
+        av_dynarray_add(&argv, &n, arg);
+    }
+    if (argv)
+        av_dynarray_add(&argv, &n, NULL);
+    if (!argv)
+        return NULL;
+    *argc = n - 1;
+    return argv;
+fail:
+    while (n--)
+        av_free(argv[n]);
+    av_free(argv);
+    return NULL;
+}
+
+/* Runs in the forked process and never returns. */
+static void run_job(ServerJob *job, int progress_fd)
+{
+    char progress_url[32];
+    char **argv;
+    int i, argc, fd;
+
+    signal(SIGINT,  SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    /* jobs only keep what belongs to them */
+    if (listen_fd >= 0)
+        close(listen_fd);
+    for (i = 0; i < nb_clients; i++) {
+        if (clients[i]->in_fd > 2)
+            close(clients[i]->in_fd);
+        if (clients[i]->out_fd > 2 && clients[i]->out_fd != clients[i]->in_fd)
+            close(clients[i]->out_fd);
+    }
+    for (i = 0; i < nb_jobs; i++)
+        if (jobs[i]->progress_fd >= 0)
+            close(jobs[i]->progress_fd);
+    if ((fd = open("/dev/null", O_RDWR)) >= 0) {
+        dup2(fd, 0);
+        if (!strcmp(server_url, "-"))
+            dup2(fd, 1);
+        if (fd > 2)
+            close(fd);
+    }
+
+    snprintf(progress_url, sizeof(progress_url), "pipe:%d", progress_fd);
+    argv = split_args(job->args, progress_url, &argc);
+    if (!argv) {
+        av_log(NULL, AV_LOG_FATAL, "Could not split the arguments of job %s\n", job->name);
+        _exit(1);
+    }
+
+    if (ffmpeg_parse_options(argc, argv) < 0)
+        exit_program(1);
+    run_transcode();
+}
+
+static int start_job(ServerJob *job)
+{
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+        return AVERROR(errno);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid < 0) {
+        int ret = AVERROR(errno);
+        close(fds[0]);
+        close(fds[1]);
+        return ret;
+    }
+    if (!pid) {
+        close(fds[0]);
+        run_job(job, fds[1]);
+    }
+
+    close(fds[1]);
+    job->pid         = pid;
+    job->progress_fd = fds[0];
+    server_reply(job->client, job->name, "started %d", (int)pid);
+    return 0;
+}
+
+/* Forward each block of -progress output of a job as one line. */
+static void read_progress(ServerJob *job)
+{
+    char *line, *end;
+    int n;
+
+    n = read(job->progress_fd, job->buf + job->len, sizeof(job->buf) - 1 - job->len);
+    if (n <= 0) {
+        if (n < 0 && errno == EINTR)
+            return;
+        close(job->progress_fd);
+        job->progress_fd = -1;
+        return;
+    }
+    job->len += n;
+    job->buf[job->len] = 0;
+
+    line = job->buf;
+    while ((end = strchr(line, '\n'))) {
+        *end = 0;
+        av_bprintf(&job->progress, "%s%s", job->progress.len ? " " : "", line);
+        if (av_strstart(line, "progress=", NULL)) {
+            server_reply(job->client, job->name, "progress %s", job->progress.str);
+            av_bprint_clear(&job->progress);
+        }
+        line = end + 1;
+    }
+    job->len -= line - job->buf;
+    memmove(job->buf, line, job->len);
+    /* drop lines too long to ever fit */
+    if (job->len == sizeof(job->buf) - 1)
+        job->len = 0;
+}
+
+/* Report the jobs that ended, or wait for all of them to end with flags 0. */
+static void reap_jobs(int flags)
+{
+    pid_t pid;
+    int i, status;
+
+    while ((pid = waitpid(-1, &status, flags)) > 0) {
+        for (i = 0; i < nb_jobs; i++)
+            if (jobs[i]->pid == pid)
+                break;
+        if (i == nb_jobs)
+            continue;
+
+        /* the job is gone, so this reaches the end of its progress */
+        while (jobs[i]->progress_fd >= 0)
+            read_progress(jobs[i]);
+        if (WIFSIGNALED(status))
+            server_reply(jobs[i]->client, jobs[i]->name, "killed %d", WTERMSIG(status));
+        else
+            server_reply(jobs[i]->client, jobs[i]->name, "done %d", WEXITSTATUS(status));
+        remove_job(i);
+    }
+}
+
+static void start_jobs(void)
+{
+    int i, ret, running = 0;
+
+    for (i = 0; i < nb_jobs; i++)
+        running += !!jobs[i]->pid;
+
+    for (i = 0; i < nb_jobs && running < server_jobs; i++) {
+        if (jobs[i]->pid)
+            continue;
+        if ((ret = start_job(jobs[i])) < 0) {
+            server_reply(jobs[i]->client, jobs[i]->name, "error %s", av_err2str(ret));
+            remove_job(i--);
+            continue;
+        }
+        running++;
+    }
+}
+
+static void read_client(int idx)
+{
+    ServerClient *c = clients[idx];
+    char *line, *end;
+    int n;
+
+    n = read(c->in_fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+    if (n < 0 && errno == EINTR)
+        return;
+    if (n <= 0) {
+        /* a last line without a newline still counts */
+        if (c->len) {
+            c->buf[c->len] = 0;
+            queue_job(c, c->buf);
+            c->len = 0;
+        }
+        c->eof = 1;
+        return;
+    }
+    c->len += n;
+    c->buf[c->len] = 0;
+
+    line = c->buf;
+    while ((end = strchr(line, '\n'))) {
+        *end = 0;
+        if (end > line && end[-1] == '\r')
+            end[-1] = 0;
+        queue_job(c, line);
+        line = end + 1;
+    }
+    c->len -= line - c->buf;
+    memmove(c->buf, line, c->len);
+    if (c->len == sizeof(c->buf) - 1) {
+        server_reply(c, "-", "error line too long");
+        c->len = 0;
+    }
+}
+
+/*
+ * Listen on a UNIX socket at path that only the user running the server can
+ * connect to, since whoever connects can run any ffmpeg command as that user.
+ * A socket left there by an earlier server is replaced, anything else is not.
+ */
+static int open_listen_socket(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct stat st;
+    mode_t mask;
+    int fd, ret;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return AVERROR(EINVAL);
+    av_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+
+    if (!lstat(path, &st)) {
+        if (!S_ISSOCK(st.st_mode)) {
+            av_log(NULL, AV_LOG_ERROR, "%s exists and is not a socket\n", path);
+            return AVERROR(EEXIST);
+        }
+        unlink(path);
+    }
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return AVERROR(errno);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    mask = umask(0077);
+    ret  = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (ret < 0 || listen(fd, 16) < 0) {
+        ret = AVERROR(errno);
+        close(fd);
+        return ret;
+    }
+    return fd;
+}
+
+static void accept_client(void)
+{
+    int fd = accept(listen_fd, NULL, NULL);
+
+    if (fd < 0)
+        return;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (add_client(fd, fd) < 0)
+        close(fd);
+}
+
+/*
+ * Open and close the decoder and encoder of each codec in a comma-separated
+ * list, so that the static tables they initialize once are already set up
+ * in every job.
+ */
+static void warm_up_codecs(const char *list)
+{
+    char *names = av_strdup(list), *name, *saveptr = NULL;
+
+    for (name = av_strtok(names, ",", &saveptr); name;
+         name = av_strtok(NULL, ",", &saveptr)) {
+        const AVCodec *codecs[2] = { avcodec_find_decoder_by_name(name),
+                                     avcodec_find_encoder_by_name(name) };
+        int i;
+
+        if (!codecs[0] && !codecs[1]) {
+            av_log(NULL, AV_LOG_WARNING, "Unknown codec '%s' to warm up\n", name);
+            continue;
+        }
+        for (i = 0; i < 2; i++) {
+            const AVCodec *codec = codecs[i];
+            AVCodecContext *avctx;
+
+            if (!codec || !(avctx = avcodec_alloc_context3(codec)))
+                continue;
+            avctx->time_base = (AVRational){ 1, 25 };
+            if (av_codec_is_encoder(codec)) {
+                avctx->width       = avctx->height = 64;
+                avctx->pix_fmt     = codec->pix_fmts ? codec->pix_fmts[0] : AV_PIX_FMT_YUV420P;
+                avctx->sample_fmt  = codec->sample_fmts ? codec->sample_fmts[0] : AV_SAMPLE_FMT_S16;
+                avctx->sample_rate = codec->supported_samplerates ?
+                                     codec->supported_samplerates[0] : 48000;
+                avctx->channels       = 2;
+                avctx->channel_layout = AV_CH_LAYOUT_STEREO;
+            }
+            /* failing to open is fine, whatever got initialized stays so */
+            if (avcodec_open2(avctx, codec, NULL) < 0)
+                av_log(NULL, AV_LOG_VERBOSE, "Could not warm up %s %s\n", name,
+                       av_codec_is_encoder(codec) ? "encoder" : "decoder");
+            avcodec_free_context(&avctx);
+        }
+    }
+    av_free(names);
+}
+
+int run_server(void)
+{
+    struct pollfd *fds = NULL;
+    unsigned int fds_size = 0;
+    int i, n, polled_clients, polled_jobs, ret = 0;
+
+    if (nb_input_files || nb_output_files) {
+        av_log(NULL, AV_LOG_FATAL, "Files cannot be given along with -server, "
+               "they belong to the jobs\n");
+        return AVERROR(EINVAL);
+    }
+    if (server_jobs <= 0)
+        server_jobs = av_cpu_count();
+    if (server_warmup)
+        warm_up_codecs(server_warmup);
+
+    if (!strcmp(server_url, "-")) {
+        ret = add_client(0, 1);
+    } else {
+        const char *path = server_url;
+        av_strstart(path, "unix:", &path);
+        if ((listen_fd = ret = open_listen_socket(path)) < 0)
+            av_log(NULL, AV_LOG_FATAL, "Could not listen on %s: %s\n",
+                   path, av_err2str(ret));
+    }
+    if (ret < 0)
+        goto end;
+
+    signal(SIGINT,  server_sigterm_handler);
+    signal(SIGTERM, server_sigterm_handler);
+    av_log(NULL, AV_LOG_INFO, "Waiting for jobs on %s, running up to %d at a time\n",
+           server_url, server_jobs);
+
+    while (!server_quit) {
+        reap_jobs(WNOHANG);
+        start_jobs();
+        /* clients stay until all their jobs are reported */
+        for (i = 0; i < nb_clients; i++)
+            if (clients[i]->eof && !client_has_jobs(clients[i]))
+                remove_client(i--);
+
+        /* reading jobs from stdin, the server is done once they all are */
+        if (listen_fd < 0 && !nb_clients)
+            break;
+
+        av_fast_malloc(&fds, &fds_size, (1 + nb_clients + nb_jobs) * sizeof(*fds));
+        if (!fds) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        n = 0;
+        if (listen_fd >= 0)
+            fds[n++] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+        for (i = 0; i < nb_clients; i++)
+            fds[n++] = (struct pollfd){ .fd = clients[i]->eof ? -1 : clients[i]->in_fd,
+                                        .events = POLLIN };
+        for (i = 0; i < nb_jobs; i++)
+            fds[n++] = (struct pollfd){ .fd = jobs[i]->progress_fd, .events = POLLIN };
+
+        /* wake up regularly to notice jobs that ended */
+        if (poll(fds, n, 100) <= 0)
+            continue;
+
+        /* new clients and jobs are added after the ones polled */
+        polled_clients = nb_clients;
+        polled_jobs    = nb_jobs;
+        n = 0;
+        if (listen_fd >= 0 && fds[n++].revents)
+            accept_client();
+        for (i = 0; i < polled_clients; i++)
+            if (fds[n++].revents)
+                read_client(i);
+        for (i = 0; i < polled_jobs; i++)
+            if (fds[n++].revents && jobs[i]->progress_fd >= 0)
+                read_progress(jobs[i]);
+    }
+
+    if (server_quit) {
+        av_log(NULL, AV_LOG_INFO, "Stopping %d jobs\n", nb_jobs);
+        for (i = 0; i < nb_jobs; i++)
+            if (jobs[i]->pid)
+                kill(jobs[i]->pid, SIGTERM);
+        reap_jobs(0);
+    }
+
+end:
+    while (nb_jobs)
+        remove_job(nb_jobs - 1);
+    while (nb_clients)
+        remove_client(nb_clients - 1);
+    av_freep(&jobs);
+    av_freep(&clients);
+    av_freep(&fds);
+    if (listen_fd >= 0) {
+        const char *path = server_url;
+        av_strstart(path, "unix:", &path);
+        close(listen_fd);
+        unlink(path);
+        listen_fd = -1;
+    }
+    return ret;
+}
+
+#else
+
+int run_server(void)
+{
+    av_log(NULL, AV_LOG_FATAL, "The job server is not supported on this platform\n");
+    return AVERROR(ENOSYS);
+}
+
+#endif /* HAVE_FORK && HAVE_POLL_H && HAVE_SYS_UN_H */
@@ -0,0 +1,115 @@
+/*
+Shared definitions for the .cool encoder and decoder.
+*/
+
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_COOL_H
+#define AVCODEC_COOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "avcodec.h"
+
+/* the size of the header info: "co", le32 width, le32 height */
+#define COOL_HEADER_SIZE 10
+
+/*
+  Version 2 files start with "cv", a version byte and a reserved flags byte,
+  followed by le32 width, le32 height, le16 tile width and le16 tile height.
+  The header is followed by one le32 offset per tile plus a final one holding
+  the total size, all relative to the end of that table, and then the tiles
+  themselves in raster order. Every tile begins with a byte giving the way it
+  is stored, followed by its rows from top to bottom.
+*/
+#define COOL_V2_HEADER_SIZE 16
+#define COOL_V2_VERSION     2
+
+/* the ways a version 2 tile can be stored */
+#define COOL_TILE_STORED    0           /* raw rows of tile width bytes */
+#define COOL_TILE_RLE       1           /* rows run-length coded, see below */
+
+/*
+  Each RLE row is a series of runs that never cross the end of the row. A
+  code byte with the top bit set is followed by one byte repeated
+  (code & 0x7f) + 1 times, otherwise it is followed by code + 1 literal bytes.
+*/
+
+/* the smallest number of rows worth handing to a slice thread */
+#define COOL_MIN_SLICE_ROWS 16
+
+/*
+  Describes a block of rows to be copied from one raster to another.
+  Either linesize may be negative, which is how the bottom-up row
+  order of the file is flipped while copying.
+*/
+typedef struct CoolRowCopy {
+    const uint8_t *src;         /* the first source row */
+    ptrdiff_t src_linesize;     /* distance between source rows */
+    uint8_t *dst;               /* the first destination row */
+    ptrdiff_t dst_linesize;     /* distance between destination rows */
+    int row_bytes;              /* the number of bytes copied per row */
+    int pad_bytes;              /* the number of zero bytes written after each destination row */
+    int height;                 /* the total number of rows */
+    int nb_slices;              /* the number of jobs the rows are split into */
+} CoolRowCopy;
+
+/*
+  Compute how many tiles of the given size are needed to cover a length.
+*/
+static inline int ff_cool_tile_count(int size, int tile_size)
+{
+    return (size + tile_size - 1) / tile_size;
+}
+
+/*
+  Compute how many slice jobs to split an image of the given height into.
+*/
+static inline int ff_cool_slice_count(const AVCodecContext *avctx, int height)
+{
+    int nb_slices = FFMIN(avctx->thread_count, height / COOL_MIN_SLICE_ROWS);
+    return FFMAX(nb_slices, 1);
+}
+
+/*
+  Copy one slice of rows, meant to be run through avctx->execute2().
+*/
+static inline int ff_cool_copy_rows(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    const CoolRowCopy *c = arg;
+    int start = (int64_t)c->height *  jobnr      / c->nb_slices;
+    int end   = (int64_t)c->height * (jobnr + 1) / c->nb_slices;
+    const uint8_t *src = c->src + start * c->src_linesize;
+    uint8_t *dst       = c->dst + start * c->dst_linesize;
+    int i;
+
+    for (i = start; i < end; i++) {
+        memcpy(dst, src, c->row_bytes);
+        if (c->pad_bytes)
+            memset(dst + c->row_bytes, 0, c->pad_bytes);
+        src += c->src_linesize;
+        dst += c->dst_linesize;
+    }
+    return 0;
+}
+
+#endif /* AVCODEC_COOL_H */
@@ -33,99 +33,455 @@ Last modified 2/26/2019: Jacob Larkin and Campbell McGavin
 Include statements
 */
 #include <inttypes.h>
+#include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
 #include "avcodec.h"
 #include "bytestream.h"
+#include "cool.h"
+#include "decode.h"
 #include "internal.h"
 #include "msrledec.h"
 
+/* The private state and options of the decoder */
+typedef struct CoolDecContext {
+    const AVClass *class;
+    AVBufferRef *palette;                       /* the systematic RGB8 palette attached to frames that reference the packet */
+    int crop_x, crop_y;                         /* the top left corner of the region to decode */
+    int crop_w, crop_h;                         /* the size of the region to decode, 0 for the rest of the image */
+    int *tile_ret;                              /* the return value of every tile job of the current frame */
+    unsigned int tile_ret_alloc;                /* the allocated size of tile_ret in bytes */
+} CoolDecContext;
+
+/* The region of the image that is output */
+typedef struct CoolCrop {
+    int x, y, w, h;
+} CoolCrop;
+
+/* The description of a version 2 frame, shared by the tile threads */
+typedef struct CoolTiles {
+    const uint8_t *index;                       /* the tile offset table */
+    const uint8_t *data;                        /* the tile data following the table */
+    unsigned int data_size;                     /* the number of bytes of tile data */
+    int width, height;                          /* the size of the whole image */
+    int tile_w, tile_h;                         /* the size of a tile */
+    int tiles_x;                                /* the number of tiles per row */
+    int first_col, first_row;                   /* the first tile covering the crop */
+    int cols;                                   /* the number of tiles per row covering the crop */
+    CoolCrop crop;                              /* the region being decoded */
+    uint8_t *dst;                               /* the output frame */
+    ptrdiff_t linesize;                         /* the linesize of the output frame */
+} CoolTiles;
+
 /*
-Take in image of .cool file type and decode it to be a packet of data native to ffmpeg
+  Initialize the decoder and the palette shared by the frames it outputs
 */
-static int cool_decode_frame(AVCodecContext *avctx,
-                            void *data, int *got_frame,
-                            AVPacket *avpkt)
+static av_cold int cool_decode_init(AVCodecContext *avctx)
 {
-    const uint8_t *buf = avpkt->data;           /* the header and image data*/
-    int buf_size       = avpkt->size;           /* the total size of the file */
-    AVFrame *p         = data;                  /* a pointer to where we are at in reading data */
-    unsigned int hsize = 10;                    /* the size of the header info, unique to our .cool format */
-    unsigned int color_depth = 8;               /* the depth or quality of color <in bits> the .cool format */
-    int width, height, i, j, n, linesize, ret;  /* helper fields to keep track of where we are at in reading the file */
-    uint8_t *p_data;                            /* a pointer to where we are at in reading the data */
-    const uint8_t *buf_pos_0 = buf;             /* the position of the beginning of the buffer */
-    avctx->pix_fmt = AV_PIX_FMT_RGB8;           /* set the picture format to RGB8 color profile */
+    CoolDecContext *s = avctx->priv_data;
 
+    avctx->pix_fmt = AV_PIX_FMT_RGB8;
 
-    /*
-      Assure that the first two bytes of a .cool file are correct.
-    */
-    if (bytestream_get_byte(&buf) != 'c' ||
-        bytestream_get_byte(&buf) != 'o') {
-        av_log(avctx, AV_LOG_ERROR, "bad magic number\n");
+#if FF_API_PSEUDOPAL
+    s->palette = av_buffer_alloc(AVPALETTE_SIZE);
+    if (!s->palette)
+        return AVERROR(ENOMEM);
+    avpriv_set_systematic_pal2((uint32_t *)s->palette->data, avctx->pix_fmt);
+#endif
+    return 0;
+}
+
+/*
+  Free the palette and the tile state
+*/
+static av_cold int cool_decode_close(AVCodecContext *avctx)
+{
+    CoolDecContext *s = avctx->priv_data;
+
+    av_buffer_unref(&s->palette);
+    av_freep(&s->tile_ret);
+    s->tile_ret_alloc = 0;
+    return 0;
+}
+
+/*
+  Work out which part of a width x height image to output from the crop
+  options, and set the dimensions of the output accordingly.
+*/
+static int cool_set_crop(AVCodecContext *avctx, int width, int height, CoolCrop *crop)
+{
+    CoolDecContext *s = avctx->priv_data;
+    int ret;
+
+    if ((ret = av_image_check_size(width, height, 0, avctx)) < 0)
+        return ret;
+
+    crop->x = s->crop_x;
+    crop->y = s->crop_y;
+    crop->w = s->crop_w ? s->crop_w : width  - crop->x;
+    crop->h = s->crop_h ? s->crop_h : height - crop->y;
+    if (crop->w <= 0 || crop->h <= 0 ||
+        crop->w > width  - crop->x ||
+        crop->h > height - crop->y) {
+        av_log(avctx, AV_LOG_ERROR, "Crop %dx%d+%d+%d does not fit in the %dx%d image\n",
+               crop->w, crop->h, crop->x, crop->y, width, height);
+        return AVERROR(EINVAL);
+    }
+
+    ret = ff_set_dimensions(avctx, crop->w, crop->h);
+    if (ret < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Failed to set dimensions %d %d\n", crop->w, crop->h);
         return AVERROR_INVALIDDATA;
     }
+    return 0;
+}
 
+/*
+  Output a frame that points straight into the packet instead of copying it.
+  The rows of the raster are already padded to 4 bytes, so they can be used
+  as they are; bottom-up images simply get a negative linesize.
+*/
+static int cool_wrap_packet(AVCodecContext *avctx, AVFrame *p, AVBufferRef *buf,
+                            const uint8_t *first_row, ptrdiff_t linesize)
+{
+    CoolDecContext *s = avctx->priv_data;
+    int ret;
+
+    /* what ff_get_buffer() would have set up, the frame being ours instead */
+    if ((ret = ff_decode_frame_props(avctx, p)) < 0 ||
+        (ret = ff_attach_decode_data(p)) < 0)
+        return ret;
+    p->width  = avctx->width;
+    p->height = avctx->height;
+    p->format = avctx->pix_fmt;
+
+    p->buf[0] = av_buffer_ref(buf);
+    if (!p->buf[0])
+        return AVERROR(ENOMEM);
+    p->data[0]     = (uint8_t *)first_row;
+    p->linesize[0] = linesize;
+
+    if (s->palette) {
+        p->buf[1] = av_buffer_ref(s->palette);
+        if (!p->buf[1])
+            return AVERROR(ENOMEM);
+        p->data[1] = p->buf[1]->data;
+    }
+    return 0;
+}
+
+/*
+  Decode a version 1 file: an uncompressed raster of rows padded to 4 bytes,
+  bottom-up unless the height is negative.
+*/
+static int cool_decode_v1(AVCodecContext *avctx, AVFrame *p, const AVPacket *avpkt)
+{
+    const uint8_t *buf = avpkt->data + 2;       /* the header after the magic number */
+    unsigned int color_depth = 8;               /* the depth or quality of color <in bits> the .cool format */
+    int width, height, n, ret;                  /* helper fields to keep track of where we are at in reading the file */
+    int bottom_up;                              /* whether the rows are stored from the bottom of the image up */
+    const uint8_t *first_row;                   /* the first row of the output within the packet */
+    ptrdiff_t linesize;                         /* the distance between output rows within the packet */
+    CoolRowCopy copy;                           /* the description of the rows handed to the slice threads */
+    CoolCrop crop;                              /* the region of the image that is output */
+
+    if (avpkt->size < COOL_HEADER_SIZE) {
+        av_log(avctx, AV_LOG_ERROR, "buf size too small (%d)\n", avpkt->size);
+        return AVERROR_INVALIDDATA;
+    }
 
     /*
       define the width and height of the image by looking into header info from .cool
     */
-    width  = bytestream_get_le32(&buf);
-    height = bytestream_get_le32(&buf);
-
+    width     = bytestream_get_le32(&buf);
+    height    = bytestream_get_le32(&buf);
+    bottom_up = height > 0;
+    if (!bottom_up)
+        height = -(unsigned)height;
 
     /*
       assure that the dimensions are correctly set
     */
-    ret = ff_set_dimensions(avctx, width, height > 0 ? height : -(unsigned)height);
-    if (ret < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Failed to set dimensions %d %d\n", width, height);
+    if ((ret = cool_set_crop(avctx, width, height, &crop)) < 0)
+        return ret;
+
+    /* compute n, the padded size of a row in the file */
+    n = ((width * color_depth + 31) / 8) & ~3;
+
+    /* assure that the packet holds every row */
+    if (avpkt->size - COOL_HEADER_SIZE < (int64_t)n * height) {
+        av_log(avctx, AV_LOG_ERROR, "not enough data (%d < %"PRId64")\n",
+               avpkt->size - COOL_HEADER_SIZE, (int64_t)n * height);
         return AVERROR_INVALIDDATA;
     }
 
+    /* positive heights are stored bottom-up, so walk the rows backwards */
+    first_row = buf + crop.x;
+    if (bottom_up) {
+        first_row += (height - 1 - crop.y) * (ptrdiff_t)n;
+        linesize   = -n;
+    } else {
+        first_row += crop.y * (ptrdiff_t)n;
+        linesize   = n;
+    }
+
+    /*
+      a refcounted packet already holds the whole raster, so just reference it,
+      unless the caller wants the frame in buffers of its own
+    */
+    if (avpkt->buf && avctx->get_buffer2 == avcodec_default_get_buffer2)
+        return cool_wrap_packet(avctx, p, avpkt->buf, first_row, linesize);
 
     /* assure that we can successfully get the buffer */
     if ((ret = ff_get_buffer(avctx, p, 0)) < 0)
         return ret;
 
-    /*  "I am not sure what this does." - Peter Jensen 02/26/2019 @ 15:12:37 */
-    p->pict_type = AV_PICTURE_TYPE_I;
-    p->key_frame = 1;
+    /* read through the pixel data, splitting the rows between the slice threads */
+    copy.src          = first_row;
+    copy.src_linesize = linesize;
+    copy.dst          = p->data[0];
+    copy.dst_linesize = p->linesize[0];
+    copy.row_bytes    = crop.w;
+    copy.pad_bytes    = 0;
+    copy.height       = crop.h;
+    copy.nb_slices    = ff_cool_slice_count(avctx, crop.h);
+    avctx->execute2(avctx, ff_cool_copy_rows, &copy, NULL, copy.nb_slices);
+    return 0;
+}
 
-    /* set buffer to the start of image data */
-    buf   = buf_pos_0 + hsize;
+/*
+  Expand one run-length coded row of a tile. Only the columns from left to
+  right are written to dst, and nothing is written if dst is NULL.
+*/
+static int cool_unpack_row(GetByteContext *gb, uint8_t *dst, int width,
+                           int left, int right)
+{
+    int x = 0, code, count, start, end;
 
-    /* compute n to be used later on */
-    n = ((avctx->width * color_depth + 31) / 8) & ~3;
+    while (x < width) {
+        if (bytestream2_get_bytes_left(gb) < 2)
+            return AVERROR_INVALIDDATA;
+        code  = bytestream2_get_byteu(gb);
+        count = (code & 0x7f) + 1;
+        if (x + count > width)
+            return AVERROR_INVALIDDATA;
 
-    /* verify that the image height is greater than 0 */
-    if (height > 0) {
-        p_data      = p->data[0] + (avctx->height - 1) * p->linesize[0];
-        linesize = -p->linesize[0];
-    } else {
-        p_data      = p->data[0];
-        linesize = p->linesize[0];
+        start = FFMAX(x, left);
+        end   = FFMIN(x + count, right);
+        if (code & 0x80) {
+            int val = bytestream2_get_byteu(gb);
+            if (dst && start < end)
+                memset(dst + start - left, val, end - start);
+        } else {
+            if (bytestream2_get_bytes_left(gb) < count)
+                return AVERROR_INVALIDDATA;
+            if (dst && start < end)
+                memcpy(dst + start - left, gb->buffer + start - x, end - start);
+            bytestream2_skipu(gb, count);
+        }
+        x += count;
     }
+    return 0;
+}
+
+/*
+  Decode the part of one version 2 tile that lies inside the crop, run through
+  avctx->execute2(). A damaged tile is left black.
+*/
+static int cool_decode_tile(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    const CoolTiles *t = arg;
+    int col   = t->first_col + jobnr % t->cols;
+    int row   = t->first_row + jobnr / t->cols;
+    int idx   = row * t->tiles_x + col;
+    int x0    = col * t->tile_w;
+    int y0    = row * t->tile_h;
+    int tw    = FFMIN(t->tile_w, t->width  - x0);
+    int th    = FFMIN(t->tile_h, t->height - y0);
+    /* the part of the tile inside the crop, in tile coordinates */
+    int left   = FFMAX(t->crop.x - x0, 0);
+    int right  = FFMIN(t->crop.x + t->crop.w - x0, tw);
+    int top    = FFMAX(t->crop.y - y0, 0);
+    int bottom = FFMIN(t->crop.y + t->crop.h - y0, th);
+    uint8_t *dst = t->dst + (y0 + top  - t->crop.y) * t->linesize
+                          + (x0 + left - t->crop.x);
+    unsigned int start = AV_RL32(t->index + 4 * idx);
+    unsigned int end   = AV_RL32(t->index + 4 * idx + 4);
+    const uint8_t *src;
+    GetByteContext gb;
+    int y, ret = AVERROR_INVALIDDATA;
+
+    if (start >= end || end > t->data_size)
+        goto fail;
+    bytestream2_init(&gb, t->data + start, end - start);
+
+    switch (bytestream2_get_byteu(&gb)) {
+    case COOL_TILE_STORED:
+        if (bytestream2_get_bytes_left(&gb) < tw * th)
+            goto fail;
+        src = gb.buffer + top * tw + left;
+        for (y = top; y < bottom; y++) {
+            memcpy(dst, src, right - left);
+            dst += t->linesize;
+            src += tw;
+        }
+        break;
+    case COOL_TILE_RLE:
+        for (y = 0; y < bottom; y++) {
+            if ((ret = cool_unpack_row(&gb, y >= top ? dst : NULL, tw, left, right)) < 0)
+                goto fail;
+            if (y >= top)
+                dst += t->linesize;
+        }
+        break;
+    default:
+        goto fail;
+    }
+    return 0;
+
+fail:
+    av_log(avctx, AV_LOG_ERROR, "Tile %d is damaged\n", idx);
+    dst = t->dst + (y0 + top  - t->crop.y) * t->linesize + (x0 + left - t->crop.x);
+    for (y = top; y < bottom; y++, dst += t->linesize)
+        memset(dst, 0, right - left);
+    return ret;
+}
 
+/*
+  Decode a version 2 file: only the tiles covering the crop are decoded,
+  in parallel.
+*/
+static int cool_decode_v2(AVCodecContext *avctx, AVFrame *p, const AVPacket *avpkt)
+{
+    CoolDecContext *s = avctx->priv_data;
+    GetByteContext gb;
+    CoolTiles t;
+    int version, tiles_y, rows, nb_jobs, i, ret;
+    int64_t table_size;
 
-    /* read through the entire file pixel data and copy into the buffer*/
-    for (i = 0; i < avctx->height; i++)
-    {
-        memcpy(p_data, buf, n);
-        buf += n;
-        p_data += linesize;
+    bytestream2_init(&gb, avpkt->data, avpkt->size);
+    if (bytestream2_get_bytes_left(&gb) < COOL_V2_HEADER_SIZE) {
+        av_log(avctx, AV_LOG_ERROR, "buf size too small (%d)\n", avpkt->size);
+        return AVERROR_INVALIDDATA;
     }
+    bytestream2_skipu(&gb, 2);
+    version = bytestream2_get_byteu(&gb);
+    if (version != COOL_V2_VERSION) {
+        avpriv_request_sample(avctx, "Version %d", version);
+        return AVERROR_PATCHWELCOME;
+    }
+    bytestream2_skipu(&gb, 1);
+    t.width  = bytestream2_get_le32u(&gb);
+    t.height = bytestream2_get_le32u(&gb);
+    t.tile_w = bytestream2_get_le16u(&gb);
+    t.tile_h = bytestream2_get_le16u(&gb);
+    if (t.width <= 0 || t.height <= 0 || !t.tile_w || !t.tile_h) {
+        av_log(avctx, AV_LOG_ERROR, "Invalid image %dx%d or tile %dx%d size\n",
+               t.width, t.height, t.tile_w, t.tile_h);
+        return AVERROR_INVALIDDATA;
+    }
+    if ((ret = cool_set_crop(avctx, t.width, t.height, &t.crop)) < 0)
+        return ret;
+
+    t.tiles_x  = ff_cool_tile_count(t.width,  t.tile_w);
+    tiles_y    = ff_cool_tile_count(t.height, t.tile_h);
+    table_size = 4 * ((int64_t)t.tiles_x * tiles_y + 1);
+    if (bytestream2_get_bytes_left(&gb) < table_size) {
+        av_log(avctx, AV_LOG_ERROR, "Truncated tile index\n");
+        return AVERROR_INVALIDDATA;
+    }
+    t.index     = gb.buffer;
+    t.data      = gb.buffer + table_size;
+    t.data_size = bytestream2_get_bytes_left(&gb) - table_size;
+
+    /* find the tiles covering the crop */
+    t.first_col = t.crop.x / t.tile_w;
+    t.first_row = t.crop.y / t.tile_h;
+    t.cols      = (t.crop.x + t.crop.w - 1) / t.tile_w - t.first_col + 1;
+    rows        = (t.crop.y + t.crop.h - 1) / t.tile_h - t.first_row + 1;
+    nb_jobs     = t.cols * rows;
+
+    av_fast_malloc(&s->tile_ret, &s->tile_ret_alloc, nb_jobs * sizeof(*s->tile_ret));
+    if (!s->tile_ret)
+        return AVERROR(ENOMEM);
+
+    if ((ret = ff_get_buffer(avctx, p, 0)) < 0)
+        return ret;
+    t.dst      = p->data[0];
+    t.linesize = p->linesize[0];
+
+    avctx->execute2(avctx, cool_decode_tile, &t, s->tile_ret, nb_jobs);
+
+    for (i = 0; i < nb_jobs; i++)
+        if (s->tile_ret[i] < 0 && (avctx->err_recognition & AV_EF_EXPLODE))
+            return s->tile_ret[i];
+    return 0;
+}
+
+/*
+Take in image of .cool file type and decode it to be a packet of data native to ffmpeg
+*/
+static int cool_decode_frame(AVCodecContext *avctx,
+                            void *data, int *got_frame,
+                            AVPacket *avpkt)
+{
+    AVFrame *p = data;                          /* the frame being decoded */
+    int ret;
+
+    /*
+      Assure that the first two bytes of a .cool file are correct: "co" for
+      version 1 files, "cv" for the later versions.
+    */
+    if (avpkt->size < 2 || avpkt->data[0] != 'c' ||
+        (avpkt->data[1] != 'o' && avpkt->data[1] != 'v')) {
+        av_log(avctx, AV_LOG_ERROR, "bad magic number\n");
+        return AVERROR_INVALIDDATA;
+    }
+
+    if (avpkt->data[1] == 'o')
+        ret = cool_decode_v1(avctx, p, avpkt);
+    else
+        ret = cool_decode_v2(avctx, p, avpkt);
+    if (ret < 0)
+        return ret;
+
+    /*  "I am not sure what this does." - Peter Jensen 02/26/2019 @ 15:12:37 */
+    p->pict_type = AV_PICTURE_TYPE_I;
+    p->key_frame = 1;
     *got_frame = 1;
 
     /* return the size of the buffer */
-    return buf_size;
+    return avpkt->size;
 }
 
+#define OFFSET(x) offsetof(CoolDecContext, x)
+#define VD AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_DECODING_PARAM
+static const AVOption options[] = {
+    { "crop_x", "left edge of the region to decode",            OFFSET(crop_x), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "crop_y", "top edge of the region to decode",             OFFSET(crop_y), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "crop_w", "width of the region to decode, 0 for the rest",  OFFSET(crop_w), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+    { "crop_h", "height of the region to decode, 0 for the rest", OFFSET(crop_h), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, VD },
+
+    { NULL },
+};
+
+static const AVClass cool_class = {
+    .class_name = "cool decoder",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 /* The struct in charge of setting up all properties for the decoding of a .cool file */
 AVCodec ff_cool_decoder = {
     .name           = "cool",
     .long_name      = NULL_IF_CONFIG_SMALL("long cool"),
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_COOL,
+    .priv_data_size = sizeof(CoolDecContext),
+    .init           = cool_decode_init,
+    .close          = cool_decode_close,
     .decode         = cool_decode_frame,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
+    .priv_class     = &cool_class,
 };
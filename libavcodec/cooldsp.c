@@ -0,0 +1,109 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "cooldsp.h"
+
+static const uint8_t bayer8x8[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+static av_always_inline uint8_t quantize(int r, int g, int b, int drg, int db)
+{
+    return (((r * COOL_SCALE_RG >> 16) + drg)       & 0xE0) |
+           ((((g * COOL_SCALE_RG >> 16) + drg) >> 3) & 0x1C) |
+            (((b * COOL_SCALE_B  >> 16) + db)  >> 6);
+}
+
+void ff_cool_planar_to_rgb8_c(uint8_t *dst, const uint8_t *r, const uint8_t *g,
+                              const uint8_t *b, const CoolDither *dither,
+                              ptrdiff_t width)
+{
+    ptrdiff_t x;
+
+    for (x = 0; x < width; x++)
+        dst[x] = quantize(r[x], g[x], b[x], dither->rg[x & 7], dither->b[x & 7]);
+}
+
+static av_always_inline void packed_to_rgb8(uint8_t *dst, const uint8_t *src,
+                                            const CoolDither *dither,
+                                            ptrdiff_t width, int step,
+                                            int r, int g, int b)
+{
+    ptrdiff_t x;
+
+    for (x = 0; x < width; x++, src += step)
+        dst[x] = quantize(src[r], src[g], src[b], dither->rg[x & 7], dither->b[x & 7]);
+}
+
+void ff_cool_rgba_to_rgb8_c(uint8_t *dst, const uint8_t *src,
+                            const CoolDither *dither, ptrdiff_t width)
+{
+    packed_to_rgb8(dst, src, dither, width, 4, 0, 1, 2);
+}
+
+void ff_cool_rgb24_to_rgb8_c(uint8_t *dst, const uint8_t *src,
+                             const CoolDither *dither, ptrdiff_t width)
+{
+    packed_to_rgb8(dst, src, dither, width, 3, 0, 1, 2);
+}
+
+void ff_cool_bgr24_to_rgb8_c(uint8_t *dst, const uint8_t *src,
+                             const CoolDither *dither, ptrdiff_t width)
+{
+    packed_to_rgb8(dst, src, dither, width, 3, 2, 1, 0);
+}
+
+av_cold void ff_cool_init_dither(CoolDither *d, int y, int dither)
+{
+    int x;
+
+    for (x = 0; x < 32; x++) {
+        int v = bayer8x8[y & 7][x & 7];
+
+        d->rg[x] = dither ? v >> 1 : 16;
+        d->b[x]  = dither ? v      : 32;
+    }
+    for (x = 0; x < 8; x++) {
+        d->rgba[4 * x + 0] = d->rg[x];
+        d->rgba[4 * x + 1] = d->rg[x];
+        d->rgba[4 * x + 2] = d->b[x];
+        d->rgba[4 * x + 3] = 0;
+    }
+}
+
+av_cold void ff_cooldsp_init(CoolDSPContext *c)
+{
+    c->planar_to_rgb8 = ff_cool_planar_to_rgb8_c;
+    c->rgba_to_rgb8   = ff_cool_rgba_to_rgb8_c;
+    c->rgb24_to_rgb8  = ff_cool_rgb24_to_rgb8_c;
+    c->bgr24_to_rgb8  = ff_cool_bgr24_to_rgb8_c;
+
+    if (ARCH_X86)
+        ff_cooldsp_init_x86(c);
+}
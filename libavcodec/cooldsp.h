@@ -0,0 +1,93 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_COOLDSP_H
+#define AVCODEC_COOLDSP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "libavutil/mem.h"
+
+/* the widths passed to the CoolDSPContext functions must be a multiple of this */
+#define COOL_DSP_ALIGN 32
+
+/* 16-bit scale factors mapping 0..255 onto 0..223 and 0..191 */
+#define COOL_SCALE_RG 57569
+#define COOL_SCALE_B  49345
+
+/**
+ * Offsets added to the scaled channels of one row before truncating them
+ * to 3-3-2 bits. The pattern repeats every 8 pixels; a constant half step
+ * rounds to the nearest level, an ordered pattern dithers.
+ */
+typedef struct CoolDither {
+    DECLARE_ALIGNED(32, uint8_t, rg)[32];   ///< red and green offsets, 0..31
+    DECLARE_ALIGNED(32, uint8_t, b)[32];    ///< blue offsets, 0..63
+    DECLARE_ALIGNED(32, uint8_t, rgba)[32]; ///< rg, rg, b, 0 for each of 8 RGBA pixels
+} CoolDither;
+
+typedef struct CoolDSPContext {
+    /**
+     * Quantize a row of planar 8-bit RGB to RGB8.
+     * @param width number of pixels, a multiple of COOL_DSP_ALIGN
+     */
+    void (*planar_to_rgb8)(uint8_t *dst, const uint8_t *r, const uint8_t *g,
+                           const uint8_t *b, const CoolDither *dither,
+                           ptrdiff_t width);
+    /**
+     * Quantize a row of packed RGBA to RGB8, ignoring alpha.
+     * @param width number of pixels, a multiple of COOL_DSP_ALIGN
+     */
+    void (*rgba_to_rgb8)(uint8_t *dst, const uint8_t *src,
+                         const CoolDither *dither, ptrdiff_t width);
+    /**
+     * Quantize a row of packed RGB24 to RGB8.
+     * @param width number of pixels, a multiple of COOL_DSP_ALIGN
+     */
+    void (*rgb24_to_rgb8)(uint8_t *dst, const uint8_t *src,
+                          const CoolDither *dither, ptrdiff_t width);
+    /**
+     * Quantize a row of packed BGR24 to RGB8.
+     * @param width number of pixels, a multiple of COOL_DSP_ALIGN
+     */
+    void (*bgr24_to_rgb8)(uint8_t *dst, const uint8_t *src,
+                          const CoolDither *dither, ptrdiff_t width);
+} CoolDSPContext;
+
+/* C versions taking any width, used for the tail of rows */
+void ff_cool_planar_to_rgb8_c(uint8_t *dst, const uint8_t *r, const uint8_t *g,
+                              const uint8_t *b, const CoolDither *dither,
+                              ptrdiff_t width);
+void ff_cool_rgba_to_rgb8_c(uint8_t *dst, const uint8_t *src,
+                            const CoolDither *dither, ptrdiff_t width);
+void ff_cool_rgb24_to_rgb8_c(uint8_t *dst, const uint8_t *src,
+                             const CoolDither *dither, ptrdiff_t width);
+void ff_cool_bgr24_to_rgb8_c(uint8_t *dst, const uint8_t *src,
+                             const CoolDither *dither, ptrdiff_t width);
+
+/**
+ * Fill in the offsets for row y, ordered dithering if dither is set and
+ * rounding otherwise.
+ */
+void ff_cool_init_dither(CoolDither *d, int y, int dither);
+
+void ff_cooldsp_init(CoolDSPContext *c);
+void ff_cooldsp_init_x86(CoolDSPContext *c);
+
+#endif /* AVCODEC_COOLDSP_H */
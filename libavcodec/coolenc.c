@@ -30,23 +30,358 @@ Last modified 2/26/2019: Jacob Larkin and Campbell McGavin
 
 #include "libavutil/imgutils.h"
 #include "libavutil/avassert.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
 #include "avcodec.h"
 #include "bytestream.h"
+#include "cool.h"
+#include "cooldsp.h"
 #include "internal.h"
+#include "rle.h"
 
+/* The private state and options of the encoder */
+typedef struct CoolEncContext {
+    const AVClass *class;
+    int version;                                /* the version of the bitstream to write */
+    int tile_size;                              /* the width and height of a version 2 tile */
+    int compression;                            /* the preferred way of storing version 2 tiles */
+    int *tile_sizes;                            /* the coded size of every tile of the current frame */
+    unsigned int tile_sizes_alloc;              /* the allocated size of tile_sizes in bytes */
+    int dither;                                 /* whether to dither when quantizing to RGB8 */
+    CoolDSPContext dsp;                         /* the functions quantizing rows to RGB8 */
+    CoolDither dithers[8];                      /* the offsets used for every row, modulo 8 */
+    int yoff, cy, crv, cgu, cgv, cbu;           /* the 16-bit fixed point YUV to RGB matrix */
+    int shift_x, shift_y;                       /* the chroma subsampling of YUV input */
+    int plane_size;                             /* the size of each row of planes */
+    uint8_t *planes;                            /* red, green and blue rows converted from YUV, for each slice */
+    unsigned int planes_alloc;                  /* the allocated size of planes in bytes */
+    AVFrame *rgb8;                              /* the quantized input of version 2 files */
+} CoolEncContext;
+
+/* The description of a frame being quantized to RGB8, shared by the slice threads */
+typedef struct CoolConvertJob {
+    const AVFrame *pict;                        /* the frame being encoded */
+    uint8_t *dst;                               /* where the top row of the image goes */
+    ptrdiff_t dst_linesize;                     /* the distance between destination rows */
+    int pad_bytes;                              /* the number of zero bytes written after each destination row */
+    int nb_slices;                              /* the number of jobs the rows are split into */
+} CoolConvertJob;
+
+/* The description of a frame being cut into version 2 tiles, shared by the tile threads */
+typedef struct CoolTileJob {
+    const AVFrame *pict;                        /* the frame being encoded */
+    int tile_size;                              /* the width and height of a tile */
+    int tiles_x;                                /* the number of tiles per row */
+    int compression;                            /* the preferred way of storing a tile */
+    uint8_t *slots;                             /* one slot of slot_size bytes per tile to code it into */
+    int slot_size;                              /* the size of the largest possible coded tile */
+    int *sizes;                                 /* the coded size of every tile */
+} CoolTileJob;
+
+/*
+  Set up the fixed point matrix used to convert YUV input to RGB
+*/
+static av_cold void cool_init_yuv(AVCodecContext *avctx)
+{
+    CoolEncContext *s = avctx->priv_data;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(avctx->pix_fmt);
+    int full = avctx->color_range == AVCOL_RANGE_JPEG;
+    double kr, kb, kg, ys, cs;
+
+    switch (avctx->colorspace) {
+    case AVCOL_SPC_BT709:
+        kr = 0.2126; kb = 0.0722;
+        break;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        kr = 0.2627; kb = 0.0593;
+        break;
+    default:
+        kr = 0.299;  kb = 0.114;
+        break;
+    }
+    kg = 1 - kr - kb;
+    ys = full ? 1.0 : 255.0 / 219.0;
+    cs = full ? 1.0 : 255.0 / 224.0;
+
+    s->yoff    = full ? 0 : 16;
+    s->cy      = lrint(ys * 65536);
+    s->crv     = lrint(2 * (1 - kr) * cs * 65536);
+    s->cbu     = lrint(2 * (1 - kb) * cs * 65536);
+    s->cgu     = lrint(2 * kb * (1 - kb) / kg * cs * 65536);
+    s->cgv     = lrint(2 * kr * (1 - kr) / kg * cs * 65536);
+    s->shift_x = desc->log2_chroma_w;
+    s->shift_y = desc->log2_chroma_h;
+}
 
 /*
   Initialize information to successfully encode an image to the .cool format
 */
 static av_cold int cool_encode_init(AVCodecContext *avctx)
 {
-   if (avctx->pix_fmt == AV_PIX_FMT_RGB8)
-        avctx->bits_per_coded_sample = 8;
-    else
-    {
+    CoolEncContext *s = avctx->priv_data;
+    int i, ret;
+
+    switch (avctx->pix_fmt) {
+    case AV_PIX_FMT_RGB8:
+    case AV_PIX_FMT_RGB24:
+    case AV_PIX_FMT_BGR24:
+    case AV_PIX_FMT_RGBA:
+        break;
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUV444P:
+        cool_init_yuv(avctx);
+        break;
+    default:
         av_log(avctx, AV_LOG_INFO, "unsupported pixel format\n");
         return AVERROR(EINVAL);
     }
+    avctx->bits_per_coded_sample = 8;
+
+    /* everything but RGB8 is quantized on the fly */
+    ff_cooldsp_init(&s->dsp);
+    for (i = 0; i < 8; i++)
+        ff_cool_init_dither(&s->dithers[i], i, s->dither);
+    s->plane_size = FFALIGN(avctx->width, COOL_DSP_ALIGN);
+
+    /* version 2 tiles are cut from a quantized copy of the input */
+    if (s->version == COOL_V2_VERSION && avctx->pix_fmt != AV_PIX_FMT_RGB8) {
+        s->rgb8 = av_frame_alloc();
+        if (!s->rgb8)
+            return AVERROR(ENOMEM);
+        s->rgb8->format = AV_PIX_FMT_RGB8;
+        s->rgb8->width  = avctx->width;
+        s->rgb8->height = avctx->height;
+        if ((ret = av_frame_get_buffer(s->rgb8, 32)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+/*
+  Convert row y of YUV input to one row each of red, green and blue
+*/
+static void cool_yuv_to_planar(const CoolEncContext *s, uint8_t *r, uint8_t *g,
+                               uint8_t *b, const AVFrame *pict, int y, int width)
+{
+    const uint8_t *ysrc = pict->data[0] +  y               * pict->linesize[0];
+    const uint8_t *usrc = pict->data[1] + (y >> s->shift_y) * pict->linesize[1];
+    const uint8_t *vsrc = pict->data[2] + (y >> s->shift_y) * pict->linesize[2];
+    int x;
+
+    for (x = 0; x < width; x++) {
+        int l  = (ysrc[x] - s->yoff) * s->cy + (1 << 15);
+        int cb = usrc[x >> s->shift_x] - 128;
+        int cr = vsrc[x >> s->shift_x] - 128;
+
+        r[x] = av_clip_uint8((l + s->crv * cr) >> 16);
+        g[x] = av_clip_uint8((l - s->cgu * cb - s->cgv * cr) >> 16);
+        b[x] = av_clip_uint8((l + s->cbu * cb) >> 16);
+    }
+}
+
+/*
+  Quantize row y of the input to RGB8. The SIMD functions handle the bulk
+  of the row and the C ones whatever is left.
+*/
+static void cool_quantize_row(const CoolEncContext *s, uint8_t *dst,
+                              const AVFrame *pict, int y, int width,
+                              uint8_t *planes)
+{
+    const CoolDither *d = &s->dithers[y & 7];
+    const uint8_t *src  = pict->data[0] + y * pict->linesize[0];
+    int simd = width & ~(COOL_DSP_ALIGN - 1);
+    uint8_t *r, *g, *b;
+
+    switch (pict->format) {
+    case AV_PIX_FMT_RGB24:
+        s->dsp.rgb24_to_rgb8(dst, src, d, simd);
+        ff_cool_rgb24_to_rgb8_c(dst + simd, src + 3 * simd, d, width - simd);
+        break;
+    case AV_PIX_FMT_BGR24:
+        s->dsp.bgr24_to_rgb8(dst, src, d, simd);
+        ff_cool_bgr24_to_rgb8_c(dst + simd, src + 3 * simd, d, width - simd);
+        break;
+    case AV_PIX_FMT_RGBA:
+        s->dsp.rgba_to_rgb8(dst, src, d, simd);
+        ff_cool_rgba_to_rgb8_c(dst + simd, src + 4 * simd, d, width - simd);
+        break;
+    default:
+        r = planes;
+        g = planes + s->plane_size;
+        b = planes + s->plane_size * 2;
+        cool_yuv_to_planar(s, r, g, b, pict, y, width);
+        s->dsp.planar_to_rgb8(dst, r, g, b, d, simd);
+        ff_cool_planar_to_rgb8_c(dst + simd, r + simd, g + simd, b + simd, d, width - simd);
+        break;
+    }
+}
+
+/*
+  Quantize one slice of rows, run through avctx->execute2()
+*/
+static int cool_convert_rows(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    const CoolEncContext *s   = avctx->priv_data;
+    const CoolConvertJob *job = arg;
+    int start = (int64_t)avctx->height *  jobnr      / job->nb_slices;
+    int end   = (int64_t)avctx->height * (jobnr + 1) / job->nb_slices;
+    uint8_t *planes = s->planes ? s->planes + (size_t)jobnr * 3 * s->plane_size : NULL;
+    int y;
+
+    for (y = start; y < end; y++) {
+        uint8_t *dst = job->dst + y * job->dst_linesize;
+
+        cool_quantize_row(s, dst, job->pict, y, avctx->width, planes);
+        if (job->pad_bytes)
+            memset(dst + avctx->width, 0, job->pad_bytes);
+    }
+    return 0;
+}
+
+/*
+  Quantize the whole input to RGB8 in parallel, the rows of the result
+  being dst_linesize apart and followed by pad_bytes zero bytes.
+*/
+static int cool_convert(AVCodecContext *avctx, const AVFrame *pict, uint8_t *dst,
+                        ptrdiff_t dst_linesize, int pad_bytes)
+{
+    CoolEncContext *s = avctx->priv_data;
+    CoolConvertJob job;
+
+    job.pict         = pict;
+    job.dst          = dst;
+    job.dst_linesize = dst_linesize;
+    job.pad_bytes    = pad_bytes;
+    job.nb_slices    = ff_cool_slice_count(avctx, avctx->height);
+
+    if (avctx->pix_fmt == AV_PIX_FMT_YUV420P || avctx->pix_fmt == AV_PIX_FMT_YUV444P) {
+        av_fast_malloc(&s->planes, &s->planes_alloc,
+                       (size_t)job.nb_slices * 3 * s->plane_size);
+        if (!s->planes)
+            return AVERROR(ENOMEM);
+    }
+
+    avctx->execute2(avctx, cool_convert_rows, &job, NULL, job.nb_slices);
+    return 0;
+}
+
+/*
+  Free the encoder state
+*/
+static av_cold int cool_encode_close(AVCodecContext *avctx)
+{
+    CoolEncContext *s = avctx->priv_data;
+
+    av_freep(&s->tile_sizes);
+    s->tile_sizes_alloc = 0;
+    av_freep(&s->planes);
+    s->planes_alloc = 0;
+    av_frame_free(&s->rgb8);
+    return 0;
+}
+
+/*
+  Code one version 2 tile into its slot, run through avctx->execute2().
+  Run-length coding is given up as soon as it grows larger than the raw tile.
+*/
+static int cool_encode_tile(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    CoolTileJob *job   = arg;
+    ptrdiff_t linesize = job->pict->linesize[0];
+    int x0             = jobnr % job->tiles_x * job->tile_size;
+    int y0             = jobnr / job->tiles_x * job->tile_size;
+    int tw             = FFMIN(job->tile_size, avctx->width  - x0);
+    int th             = FFMIN(job->tile_size, avctx->height - y0);
+    const uint8_t *src = job->pict->data[0] + y0 * linesize + x0;
+    uint8_t *start     = job->slots + (size_t)jobnr * job->slot_size;
+    uint8_t *dst       = start + 1;
+    int y, n;
+
+    if (job->compression == COOL_TILE_RLE) {
+        for (y = 0; y < th; y++) {
+            n = ff_rle_encode(dst, start + 1 + tw * th - dst, src + y * linesize,
+                              1, tw, 0x7f, 0, -1, 0);
+            if (n < 0)
+                break;
+            dst += n;
+        }
+        if (y == th) {
+            *start = COOL_TILE_RLE;
+            job->sizes[jobnr] = dst - start;
+            return 0;
+        }
+    }
+
+    /* store the rows as they are */
+    *start = COOL_TILE_STORED;
+    dst    = start + 1;
+    for (y = 0; y < th; y++) {
+        memcpy(dst, src, tw);
+        dst += tw;
+        src += linesize;
+    }
+    job->sizes[jobnr] = 1 + tw * th;
+    return 0;
+}
+
+/*
+  Write a version 2 file: the tiles are coded in parallel into fixed-size
+  slots of the packet, then packed together behind the offset table.
+*/
+static int cool_encode_frame_v2(AVCodecContext *avctx, AVPacket *pkt,
+                                const AVFrame *pict)
+{
+    CoolEncContext *s = avctx->priv_data;
+    CoolTileJob job;
+    int tiles_y, nb_tiles, table_size, i, ret;
+    int64_t n_bytes;
+    uint8_t *buf, *tiles;
+    unsigned int pos;
+
+    job.pict        = pict;
+    job.tile_size   = s->tile_size;
+    job.compression = s->compression;
+    job.tiles_x     = ff_cool_tile_count(avctx->width,  s->tile_size);
+    tiles_y         = ff_cool_tile_count(avctx->height, s->tile_size);
+    nb_tiles        = job.tiles_x * tiles_y;
+    job.slot_size   = 1 + FFMIN(s->tile_size, avctx->width) * FFMIN(s->tile_size, avctx->height);
+    table_size      = 4 * (nb_tiles + 1);
+
+    av_fast_malloc(&s->tile_sizes, &s->tile_sizes_alloc, nb_tiles * sizeof(*s->tile_sizes));
+    if (!s->tile_sizes)
+        return AVERROR(ENOMEM);
+    job.sizes = s->tile_sizes;
+
+    /* allocate enough room for every tile to be stored uncompressed */
+    n_bytes = COOL_V2_HEADER_SIZE + table_size + (int64_t)nb_tiles * job.slot_size;
+    if ((ret = ff_alloc_packet2(avctx, pkt, n_bytes, 0)) < 0)
+        return ret;
+
+    buf = pkt->data;
+    bytestream_put_byte(&buf, 'c');
+    bytestream_put_byte(&buf, 'v');
+    bytestream_put_byte(&buf, COOL_V2_VERSION);
+    bytestream_put_byte(&buf, 0);
+    bytestream_put_le32(&buf, avctx->width);
+    bytestream_put_le32(&buf, avctx->height);
+    bytestream_put_le16(&buf, s->tile_size);
+    bytestream_put_le16(&buf, s->tile_size);
+
+    tiles     = buf + table_size;
+    job.slots = tiles;
+    avctx->execute2(avctx, cool_encode_tile, &job, NULL, nb_tiles);
+
+    /* pack the tiles and fill in the offset table */
+    for (i = 0, pos = 0; i < nb_tiles; i++) {
+        memmove(tiles + pos, tiles + (size_t)i * job.slot_size, job.sizes[i]);
+        bytestream_put_le32(&buf, pos);
+        pos += job.sizes[i];
+    }
+    bytestream_put_le32(&buf, pos);
+
+    av_shrink_packet(pkt, tiles + pos - pkt->data);
     return 0;
 }
 
@@ -57,12 +392,14 @@ static int cool_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                             const AVFrame *pict, int *got_packet)
 {
 
+    CoolEncContext *s = avctx->priv_data;                               /* the options of the encoder */
     const AVFrame * const p_pict = pict;                                /* a pointer to the AVFrame pict*/
-    int n_bytes_image, n_bytes_per_row, n_bytes, i, hsize, ret;         /* helper fields to keep track of where we are at in reading the file */
+    int n_bytes_image, n_bytes_per_row, n_bytes, hsize, ret;            /* helper fields to keep track of where we are at in reading the file */
     uint32_t palette256[256];                                           /* a palette of maximum available colors*/
     int pad_bytes_per_row = 0;                                          /* the amount of padding per row */
     int bit_count = avctx->bits_per_coded_sample;                       /* in our case this will always be 8 bits per pixel */
-    uint8_t *p_data, *buf;                                              /* pointers to the position in the data and the buffer */
+    uint8_t *buf;                                                       /* pointer to the position in the buffer */
+    CoolRowCopy copy;                                                   /* the description of the rows handed to the slice threads */
 
 
     /*  "I am not sure what this does." - Peter Jensen 02/26/2019 @ 15:12:37 */
@@ -73,6 +410,21 @@ static int cool_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
       FF_ENABLE_DEPRECATION_WARNINGS
     #endif
 
+    /* version 2 files are written by their own function, from RGB8 */
+    if (s->version == COOL_V2_VERSION) {
+        if (s->rgb8) {
+            if ((ret = av_frame_make_writable(s->rgb8)) < 0 ||
+                (ret = cool_convert(avctx, pict, s->rgb8->data[0], s->rgb8->linesize[0], 0)) < 0)
+                return ret;
+            pict = s->rgb8;
+        }
+        if ((ret = cool_encode_frame_v2(avctx, pkt, pict)) < 0)
+            return ret;
+        pkt->flags |= AV_PKT_FLAG_KEY;
+        *got_packet = 1;
+        return 0;
+    }
+
     /* verify that the color quality is 8 bits per pixel */
     av_assert1(bit_count == 8);
     avpriv_set_systematic_pal2(palette256, avctx->pix_fmt);
@@ -85,8 +437,8 @@ static int cool_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     pad_bytes_per_row = (4 - n_bytes_per_row) & 3;
     n_bytes_image = avctx->height * (n_bytes_per_row + pad_bytes_per_row);
 
-    /* our header has a constant size of 10, so we don't need to adjust hsize */
-    hsize = 10;
+    /* our header has a constant size, so we don't need to adjust hsize */
+    hsize = COOL_HEADER_SIZE;
 
     /* compute the total number of bytes, being the bytes from image && header */
     n_bytes = n_bytes_image + hsize;
@@ -106,31 +458,71 @@ static int cool_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
     bytestream_put_le32(&buf, avctx->width);
     bytestream_put_le32(&buf, avctx->height);
 
-    /* write the image data from bottom to top and then copy it to memory */
-    p_data = p_pict->data[0] + (avctx->height - 1) * p_pict->linesize[0];
-    buf = pkt->data + hsize;
-    for(i = 0; i < avctx->height; i++)
-    {
-        memcpy(buf, p_data, n_bytes_per_row);
-        buf += n_bytes_per_row;
-        memset(buf, 0, pad_bytes_per_row);
-        buf += pad_bytes_per_row;
-        p_data -= p_pict->linesize[0]; // ... and go back
+    /*
+      write the image data from bottom to top, splitting the rows between
+      the slice threads
+    */
+    if (avctx->pix_fmt != AV_PIX_FMT_RGB8) {
+        ret = cool_convert(avctx, p_pict,
+                           pkt->data + hsize + (avctx->height - 1) * (ptrdiff_t)(n_bytes_per_row + pad_bytes_per_row),
+                           -(n_bytes_per_row + pad_bytes_per_row), pad_bytes_per_row);
+        if (ret < 0)
+            return ret;
+        pkt->flags |= AV_PKT_FLAG_KEY;
+        *got_packet = 1;
+        return 0;
     }
 
+    copy.src          = p_pict->data[0] + (avctx->height - 1) * p_pict->linesize[0];
+    copy.src_linesize = -p_pict->linesize[0];
+    copy.dst          = pkt->data + hsize;
+    copy.dst_linesize = n_bytes_per_row + pad_bytes_per_row;
+    copy.row_bytes    = n_bytes_per_row;
+    copy.pad_bytes    = pad_bytes_per_row;
+    copy.height       = avctx->height;
+    copy.nb_slices    = ff_cool_slice_count(avctx, avctx->height);
+    avctx->execute2(avctx, ff_cool_copy_rows, &copy, NULL, copy.nb_slices);
+
     /* set the packet flags if initially set or flag key is set */
     pkt->flags |= AV_PKT_FLAG_KEY;
     *got_packet = 1;
     return 0;
 }
 
+#define OFFSET(x) offsetof(CoolEncContext, x)
+#define VE AV_OPT_FLAG_VIDEO_PARAM | AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "cool_version", "version of the bitstream to write", OFFSET(version), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, COOL_V2_VERSION, VE },
+    { "tile_size", "width and height of the tiles of a version 2 file", OFFSET(tile_size), AV_OPT_TYPE_INT, { .i64 = 256 }, 16, 4096, VE },
+    { "dither", "use ordered dithering when quantizing to RGB8", OFFSET(dither), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, VE },
+    { "compression", "how version 2 tiles are compressed", OFFSET(compression), AV_OPT_TYPE_INT, { .i64 = COOL_TILE_RLE }, COOL_TILE_STORED, COOL_TILE_RLE, VE, "compression" },
+        { "none", "store tiles uncompressed",                        0, AV_OPT_TYPE_CONST, { .i64 = COOL_TILE_STORED }, 0, 0, VE, "compression" },
+        { "rle",  "run-length code tiles when it makes them smaller", 0, AV_OPT_TYPE_CONST, { .i64 = COOL_TILE_RLE },    0, 0, VE, "compression" },
+
+    { NULL },
+};
+
+static const AVClass cool_class = {
+    .class_name = "cool",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 /* The struct in charge of setting up all properties for the encoding of a .cool file */
 AVCodec ff_cool_encoder = {
     .name           = "cool",
     .long_name      = NULL_IF_CONFIG_SMALL("long cool"),
     .type           = AVMEDIA_TYPE_VIDEO,
     .id             = AV_CODEC_ID_COOL,
+    .priv_data_size = sizeof(CoolEncContext),
     .init           = cool_encode_init,
     .encode2        = cool_encode_frame,
-    .pix_fmts       = (const enum AVPixelFormat[]){AV_PIX_FMT_RGB8, AV_PIX_FMT_NONE},
+    .close          = cool_encode_close,
+    .capabilities   = AV_CODEC_CAP_SLICE_THREADS,
+    .pix_fmts       = (const enum AVPixelFormat[]){
+        AV_PIX_FMT_RGB8, AV_PIX_FMT_RGB24, AV_PIX_FMT_BGR24, AV_PIX_FMT_RGBA,
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV444P, AV_PIX_FMT_NONE
+    },
+    .priv_class     = &cool_class,
 };
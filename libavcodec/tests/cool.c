@@ -0,0 +1,189 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * COOL slice threading benchmark.
+ *
+ * Encodes and decodes an 8K RGB8 frame with 1 to N slice threads, checks
+ * that every round trip is lossless and prints the time per frame. Decoding
+ * is timed both with a custom get_buffer2() callback, which forces the
+ * slice-threaded row copy, and with the default one, which lets the decoder
+ * reference the packet instead. Version 2 (tiled) files are timed as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavcodec/avcodec.h"
+#include "libavutil/cpu.h"
+#include "libavutil/frame.h"
+#include "libavutil/lfg.h"
+#include "libavutil/opt.h"
+#include "libavutil/time.h"
+
+#undef printf
+
+#define WIDTH  7680
+#define HEIGHT 4320
+#define RUNS   8
+
+static int copy_get_buffer(AVCodecContext *avctx, AVFrame *frame, int flags)
+{
+    return avcodec_default_get_buffer2(avctx, frame, flags);
+}
+
+static AVCodecContext *open_codec(const AVCodec *codec, int threads, int copy,
+                                  int version)
+{
+    AVCodecContext *avctx = avcodec_alloc_context3(codec);
+
+    if (!avctx)
+        return NULL;
+    avctx->width        = WIDTH;
+    avctx->height       = HEIGHT;
+    avctx->pix_fmt      = AV_PIX_FMT_RGB8;
+    avctx->time_base    = (AVRational){ 1, 25 };
+    avctx->thread_count = threads;
+    avctx->thread_type  = FF_THREAD_SLICE;
+    if (copy)
+        avctx->get_buffer2 = copy_get_buffer;
+    if (version)
+        av_opt_set_int(avctx->priv_data, "cool_version", version, 0);
+    if (avcodec_open2(avctx, codec, NULL) < 0)
+        avcodec_free_context(&avctx);
+    return avctx;
+}
+
+static int compare_frames(const AVFrame *a, const AVFrame *b)
+{
+    int y;
+
+    for (y = 0; y < HEIGHT; y++)
+        if (memcmp(a->data[0] + y * a->linesize[0],
+                   b->data[0] + y * b->linesize[0], WIDTH))
+            return 1;
+    return 0;
+}
+
+static int decode(AVCodecContext *avctx, const AVFrame *src,
+                  const AVPacket *pkt, AVFrame *out, int64_t *time)
+{
+    int64_t t = av_gettime_relative();
+    int ret;
+
+    if ((ret = avcodec_send_packet(avctx, pkt)) < 0 ||
+        (ret = avcodec_receive_frame(avctx, out)) < 0)
+        return ret;
+    *time += av_gettime_relative() - t;
+
+    ret = compare_frames(src, out) ? AVERROR_BUG : 0;
+    av_frame_unref(out);
+    return ret;
+}
+
+static int run(const AVCodec *enc, const AVCodec *dec, const AVFrame *src,
+               AVPacket *pkt, AVFrame *out, int threads, int version)
+{
+    AVCodecContext *enc_ctx  = open_codec(enc, threads, 0, version);
+    AVCodecContext *copy_ctx = open_codec(dec, threads, 1, 0);
+    AVCodecContext *ref_ctx  = open_codec(dec, threads, 0, 0);
+    int64_t enc_time = 0, copy_time = 0, ref_time = 0, t;
+    int i, size = 0, ret = AVERROR(ENOMEM);
+
+    if (!enc_ctx || !copy_ctx || !ref_ctx)
+        goto end;
+
+    for (i = 0; i < RUNS; i++) {
+        t = av_gettime_relative();
+        if ((ret = avcodec_send_frame(enc_ctx, src)) < 0 ||
+            (ret = avcodec_receive_packet(enc_ctx, pkt)) < 0)
+            goto end;
+        enc_time += av_gettime_relative() - t;
+        size      = pkt->size;
+
+        if ((ret = decode(copy_ctx, src, pkt, out, &copy_time)) < 0 ||
+            (ret = decode(ref_ctx,  src, pkt, out, &ref_time)) < 0) {
+            fprintf(stderr, "round trip failed with %d threads\n", threads);
+            goto end;
+        }
+        av_packet_unref(pkt);
+    }
+
+    if (version == 1)
+        printf("v1 threads %2d: encode %8.3f ms  decode %8.3f ms  decode (zero-copy) %8.3f ms\n",
+               threads, enc_time / (1000.0 * RUNS), copy_time / (1000.0 * RUNS),
+               ref_time / (1000.0 * RUNS));
+    else
+        printf("v%d threads %2d: encode %8.3f ms  decode %8.3f ms  (%d bytes)\n",
+               version, threads, enc_time / (1000.0 * RUNS),
+               copy_time / (1000.0 * RUNS), size);
+    ret = 0;
+end:
+    av_packet_unref(pkt);
+    av_frame_unref(out);
+    avcodec_free_context(&enc_ctx);
+    avcodec_free_context(&copy_ctx);
+    avcodec_free_context(&ref_ctx);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const AVCodec *enc = avcodec_find_encoder(AV_CODEC_ID_COOL);
+    const AVCodec *dec = avcodec_find_decoder(AV_CODEC_ID_COOL);
+    int max_threads = argc > 1 ? atoi(argv[1]) : av_cpu_count();
+    AVFrame *src = av_frame_alloc();
+    AVFrame *out = av_frame_alloc();
+    AVPacket *pkt = av_packet_alloc();
+    AVLFG lfg;
+    int x, y, threads, version, ret = 1;
+
+    if (!enc || !dec) {
+        fprintf(stderr, "COOL encoder or decoder not available\n");
+        goto end;
+    }
+    if (!src || !out || !pkt)
+        goto end;
+
+    src->width  = WIDTH;
+    src->height = HEIGHT;
+    src->format = AV_PIX_FMT_RGB8;
+    if (av_frame_get_buffer(src, 32) < 0)
+        goto end;
+
+    /* noise in the top half, flat bands that compress well in the bottom half */
+    av_lfg_init(&lfg, 0xC001);
+    for (y = 0; y < HEIGHT; y++)
+        for (x = 0; x < WIDTH; x++)
+            src->data[0][y * src->linesize[0] + x] = y < HEIGHT / 2 ? av_lfg_get(&lfg)
+                                                                    : (x + y) / 64;
+
+    for (version = 1; version <= 2; version++)
+        for (threads = 1; threads <= FFMAX(max_threads, 1); threads++)
+            if (run(enc, dec, src, pkt, out, threads, version) < 0)
+                goto end;
+    ret = 0;
+
+end:
+    av_frame_free(&src);
+    av_frame_free(&out);
+    av_packet_free(&pkt);
+    return ret;
+}
@@ -0,0 +1,211 @@
+;******************************************************************************
+;* SIMD-optimized COOL RGB8 quantization
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pw_scale_rg:   times 16 dw 57569
+pw_scale_b:    times 16 dw 49345
+pw_scale_rgba: times 2 dw 57569, 57569, 49345, 0
+pb_E0:         times 32 db 0xE0
+pb_1C:         times 32 db 0x1C
+pd_E0:         times 4 dd 0xE0
+pd_1C:         times 4 dd 0x1C
+
+; gather byte n of each 3-byte pixel of 48 bytes loaded into 3 registers
+pb_shuf0_0:   times 2 db 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+pb_shuf0_1:   times 2 db -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1
+pb_shuf0_2:   times 2 db -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13
+pb_shuf1_0:   times 2 db 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+pb_shuf1_1:   times 2 db -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1
+pb_shuf1_2:   times 2 db -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14
+pb_shuf2_0:   times 2 db 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+pb_shuf2_1:   times 2 db -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1
+pb_shuf2_2:   times 2 db -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15
+
+cextern pb_3
+
+SECTION .text
+
+; scale the bytes of %1 by the words of %2, using %3 as temporary and m7 as zero
+%macro SCALE 3
+    punpckhbw      %3, %1, m7
+    punpcklbw      %1, m7
+    pmulhuw        %1, %2
+    pmulhuw        %3, %2
+    packuswb       %1, %3
+%endmacro
+
+; quantize the red, green and blue bytes of %1, %2 and %3 to RGB8 in %1,
+; adding the offsets %4 to red and green and %5 to blue, using m6 as
+; temporary and m7 as zero
+%macro QUANTIZE 5
+    SCALE          %1, [pw_scale_rg], m6
+    SCALE          %2, [pw_scale_rg], m6
+    SCALE          %3, [pw_scale_b],  m6
+    paddb          %1, %4
+    paddb          %2, %4
+    paddb          %3, %5
+    pand           %1, [pb_E0]
+    psrlw          %2, 3
+    pand           %2, [pb_1C]
+    psrlw          %3, 6
+    pand           %3, [pb_3]
+    por            %1, %2
+    por            %1, %3
+%endmacro
+
+;------------------------------------------------------------------------------
+; void planar_to_rgb8(uint8_t *dst, const uint8_t *r, const uint8_t *g,
+;                     const uint8_t *b, const CoolDither *dither,
+;                     ptrdiff_t width)
+;------------------------------------------------------------------------------
+%macro PLANAR_TO_RGB8 0
+cglobal cool_planar_to_rgb8, 6, 6, 8, dst, r, g, b, dither, w
+    add          dstq, wq
+    add            rq, wq
+    add            gq, wq
+    add            bq, wq
+    neg            wq
+    mova           m4, [ditherq]
+    mova           m5, [ditherq + 32]
+    pxor           m7, m7
+.loop:
+    movu           m0, [rq + wq]
+    movu           m1, [gq + wq]
+    movu           m2, [bq + wq]
+    QUANTIZE       m0, m1, m2, m4, m5
+    movu  [dstq + wq], m0
+    add            wq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse2
+PLANAR_TO_RGB8
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+PLANAR_TO_RGB8
+%endif
+
+; pack the r, g, b bytes of the dwords of %1 into 3-3-2 bits, using %2 and %3 as temporaries
+%macro PACK_RGBA 3
+    psrld          %2, %1, 11
+    pand           %2, [pd_1C]
+    psrld          %3, %1, 22
+    pand           %1, [pd_E0]
+    por            %1, %2
+    por            %1, %3
+%endmacro
+
+;------------------------------------------------------------------------------
+; void rgba_to_rgb8(uint8_t *dst, const uint8_t *src,
+;                   const CoolDither *dither, ptrdiff_t width)
+;------------------------------------------------------------------------------
+INIT_XMM sse2
+cglobal cool_rgba_to_rgb8, 4, 4, 8, dst, src, dither, w
+    lea          srcq, [srcq + 4 * wq]
+    add          dstq, wq
+    neg            wq
+    pxor           m7, m7
+.loop:
+    movu           m0, [srcq + 4 * wq]
+    movu           m1, [srcq + 4 * wq + 16]
+    movu           m2, [srcq + 4 * wq + 32]
+    movu           m3, [srcq + 4 * wq + 48]
+    SCALE          m0, [pw_scale_rgba], m6
+    SCALE          m1, [pw_scale_rgba], m6
+    SCALE          m2, [pw_scale_rgba], m6
+    SCALE          m3, [pw_scale_rgba], m6
+    paddb          m0, [ditherq + 64]
+    paddb          m1, [ditherq + 80]
+    paddb          m2, [ditherq + 64]
+    paddb          m3, [ditherq + 80]
+    PACK_RGBA      m0, m4, m5
+    PACK_RGBA      m1, m4, m5
+    PACK_RGBA      m2, m4, m5
+    PACK_RGBA      m3, m4, m5
+    packssdw       m0, m1
+    packssdw       m2, m3
+    packuswb       m0, m2
+    movu  [dstq + wq], m0
+    add            wq, mmsize
+    jl .loop
+    RET
+
+;------------------------------------------------------------------------------
+; void rgb24_to_rgb8(uint8_t *dst, const uint8_t *src,
+;                    const CoolDither *dither, ptrdiff_t width)
+; void bgr24_to_rgb8(uint8_t *dst, const uint8_t *src,
+;                    const CoolDither *dither, ptrdiff_t width)
+;------------------------------------------------------------------------------
+; %1 = name, %2 = byte of red in a pixel, %3 = byte of blue
+%macro PACKED24_TO_RGB8 3
+cglobal cool_%1_to_rgb8, 4, 4, 8, dst, src, dither, w
+    add          dstq, wq
+    neg            wq
+    pxor           m7, m7
+.loop:
+%if mmsize == 32
+    movu          xm0, [srcq]
+    movu          xm1, [srcq + 16]
+    movu          xm2, [srcq + 32]
+    vinserti128    m0, m0, [srcq + 48], 1
+    vinserti128    m1, m1, [srcq + 64], 1
+    vinserti128    m2, m2, [srcq + 80], 1
+%else
+    movu           m0, [srcq]
+    movu           m1, [srcq + 16]
+    movu           m2, [srcq + 32]
+%endif
+    pshufb         m3, m0, [pb_shuf%2_0]
+    pshufb         m6, m1, [pb_shuf%2_1]
+    por            m3, m6
+    pshufb         m6, m2, [pb_shuf%2_2]
+    por            m3, m6
+    pshufb         m4, m0, [pb_shuf1_0]
+    pshufb         m6, m1, [pb_shuf1_1]
+    por            m4, m6
+    pshufb         m6, m2, [pb_shuf1_2]
+    por            m4, m6
+    pshufb         m0, [pb_shuf%3_0]
+    pshufb         m1, [pb_shuf%3_1]
+    pshufb         m2, [pb_shuf%3_2]
+    por            m0, m1
+    por            m0, m2
+    QUANTIZE       m3, m4, m0, [ditherq], [ditherq + 32]
+    movu  [dstq + wq], m3
+    add          srcq, 3 * mmsize
+    add            wq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM ssse3
+PACKED24_TO_RGB8 rgb24, 0, 2
+PACKED24_TO_RGB8 bgr24, 2, 0
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+PACKED24_TO_RGB8 rgb24, 0, 2
+PACKED24_TO_RGB8 bgr24, 2, 0
+%endif
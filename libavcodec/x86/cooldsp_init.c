@@ -0,0 +1,61 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavcodec/cooldsp.h"
+
+void ff_cool_planar_to_rgb8_sse2(uint8_t *dst, const uint8_t *r, const uint8_t *g,
+                                 const uint8_t *b, const CoolDither *dither,
+                                 ptrdiff_t width);
+void ff_cool_planar_to_rgb8_avx2(uint8_t *dst, const uint8_t *r, const uint8_t *g,
+                                 const uint8_t *b, const CoolDither *dither,
+                                 ptrdiff_t width);
+
+void ff_cool_rgba_to_rgb8_sse2(uint8_t *dst, const uint8_t *src,
+                               const CoolDither *dither, ptrdiff_t width);
+
+void ff_cool_rgb24_to_rgb8_ssse3(uint8_t *dst, const uint8_t *src,
+                                const CoolDither *dither, ptrdiff_t width);
+void ff_cool_rgb24_to_rgb8_avx2(uint8_t *dst, const uint8_t *src,
+                               const CoolDither *dither, ptrdiff_t width);
+void ff_cool_bgr24_to_rgb8_ssse3(uint8_t *dst, const uint8_t *src,
+                                const CoolDither *dither, ptrdiff_t width);
+void ff_cool_bgr24_to_rgb8_avx2(uint8_t *dst, const uint8_t *src,
+                               const CoolDither *dither, ptrdiff_t width);
+
+av_cold void ff_cooldsp_init_x86(CoolDSPContext *c)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        c->planar_to_rgb8 = ff_cool_planar_to_rgb8_sse2;
+        c->rgba_to_rgb8   = ff_cool_rgba_to_rgb8_sse2;
+    }
+    if (EXTERNAL_SSSE3(cpu_flags)) {
+        c->rgb24_to_rgb8  = ff_cool_rgb24_to_rgb8_ssse3;
+        c->bgr24_to_rgb8  = ff_cool_bgr24_to_rgb8_ssse3;
+    }
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        c->planar_to_rgb8 = ff_cool_planar_to_rgb8_avx2;
+        c->rgb24_to_rgb8  = ff_cool_rgb24_to_rgb8_avx2;
+        c->bgr24_to_rgb8  = ff_cool_bgr24_to_rgb8_avx2;
+    }
+}
@@ -26,6 +26,7 @@
 #include "audio.h"
 #include "avfilter.h"
 #include "internal.h"
+#include "thread.h"
 
 #define BUFFER_ALIGN 0
 
@@ -42,11 +43,14 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
 
     av_assert0(channels == av_get_channel_layout_nb_channels(link->channel_layout) || !av_get_channel_layout_nb_channels(link->channel_layout));
 
+    /* The pool may also be used by the filter before, which can run at the
+       same time with frame threading. */
+    ff_graph_lock(link->src->graph);
     if (!link->frame_pool) {
         link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
                                                     nb_samples, link->format, BUFFER_ALIGN);
         if (!link->frame_pool)
-            return NULL;
+            goto end;
     } else {
         int pool_channels = 0;
         int pool_nb_samples = 0;
@@ -56,7 +60,7 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
         if (ff_frame_pool_get_audio_config(link->frame_pool,
                                            &pool_channels, &pool_nb_samples,
                                            &pool_format, &pool_align) < 0) {
-            return NULL;
+            goto end;
         }
 
         if (pool_channels != channels || pool_nb_samples < nb_samples ||
@@ -66,11 +70,13 @@ AVFrame *ff_default_get_audio_buffer(AVFilterLink *link, int nb_samples)
             link->frame_pool = ff_frame_pool_audio_init(av_buffer_allocz, channels,
                                                         nb_samples, link->format, BUFFER_ALIGN);
             if (!link->frame_pool)
-                return NULL;
+                goto end;
         }
     }
 
     frame = ff_frame_pool_get(link->frame_pool);
+end:
+    ff_graph_unlock(link->src->graph);
     if (!frame)
         return NULL;
 
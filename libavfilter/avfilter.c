@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <time.h>
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/buffer.h"
@@ -33,6 +35,7 @@
 #include "libavutil/rational.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 
 #define FF_INTERNAL_FIELDS 1
 #include "framequeue.h"
@@ -42,6 +45,7 @@
 #include "filters.h"
 #include "formats.h"
 #include "internal.h"
+#include "thread.h"
 
 #include "libavutil/ffversion.h"
 const char av_filter_ffversion[] = "FFmpeg version " FFMPEG_VERSION;
@@ -190,14 +194,47 @@ int avfilter_link_get_channels(AVFilterLink *link)
 }
 #endif
 
+/*
+ * With frame threading, the filters at both ends of a link may run at the
+ * same time: the fields of the link used for activation and its FIFO are
+ * only accessed with the graph lock held, and the lock is never held while
+ * calling into a filter.
+ */
+static void graph_lock(AVFilterContext *filter)
+{
+    if (filter->graph)
+        ff_graph_lock(filter->graph);
+}
+
+static void graph_unlock(AVFilterContext *filter)
+{
+    if (filter->graph)
+        ff_graph_unlock(filter->graph);
+}
+
+/**
+ * Same as ff_filter_set_ready(), with the graph lock held.
+ */
+static void filter_set_ready(AVFilterContext *filter, unsigned priority)
+{
+    if (priority > filter->ready) {
+        filter->ready = priority;
+        if (filter->graph)
+            ff_filter_graph_update_ready(filter);
+    }
+}
+
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
-    filter->ready = FFMAX(filter->ready, priority);
+    graph_lock(filter);
+    filter_set_ready(filter, priority);
+    graph_unlock(filter);
 }
 
 /**
  * Clear frame_blocked_in on all outputs.
  * This is necessary whenever something changes on input.
+ * The graph lock must be held.
  */
 static void filter_unblock(AVFilterContext *filter)
 {
@@ -207,8 +244,7 @@ static void filter_unblock(AVFilterContext *filter)
         filter->outputs[i]->frame_blocked_in = 0;
 }
 
-
-void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
+static void link_set_in_status(AVFilterLink *link, int status, int64_t pts)
 {
     if (link->status_in == status)
         return;
@@ -218,18 +254,31 @@ void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
     link->frame_wanted_out = 0;
     link->frame_blocked_in = 0;
     filter_unblock(link->dst);
-    ff_filter_set_ready(link->dst, 200);
+    filter_set_ready(link->dst, 200);
 }
 
-void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts)
+void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
+{
+    graph_lock(link->dst);
+    link_set_in_status(link, status, pts);
+    graph_unlock(link->dst);
+}
+
+static void link_set_out_status(AVFilterLink *link, int status, int64_t pts)
 {
     av_assert0(!link->frame_wanted_out);
     av_assert0(!link->status_out);
     link->status_out = status;
-    if (pts != AV_NOPTS_VALUE)
-        ff_update_link_current_pts(link, pts);
+    ff_update_link_current_pts(link, pts);
     filter_unblock(link->dst);
-    ff_filter_set_ready(link->src, 200);
+    filter_set_ready(link->src, 200);
+}
+
+void ff_avfilter_link_set_out_status(AVFilterLink *link, int status, int64_t pts)
+{
+    graph_lock(link->dst);
+    link_set_out_status(link, status, pts);
+    graph_unlock(link->dst);
 }
 
 void avfilter_link_set_closed(AVFilterLink *link, int closed)
@@ -406,29 +455,36 @@ void ff_tlog_link(void *ctx, AVFilterLink *link, int end)
 
 int ff_request_frame(AVFilterLink *link)
 {
+    int ret = 0;
+
     FF_TPRINTF_START(NULL, request_frame); ff_tlog_link(NULL, link, 1);
 
     av_assert1(!link->dst->filter->activate);
-    if (link->status_out)
-        return link->status_out;
-    if (link->status_in) {
+    graph_lock(link->dst);
+    if (link->status_out) {
+        ret = link->status_out;
+    } else if (link->status_in) {
         if (ff_framequeue_queued_frames(&link->fifo)) {
             av_assert1(!link->frame_wanted_out);
             av_assert1(link->dst->ready >= 300);
-            return 0;
         } else {
             /* Acknowledge status change. Filters using ff_request_frame() will
                handle the change automatically. Filters can also check the
                status directly but none do yet. */
-            ff_avfilter_link_set_out_status(link, link->status_in, link->status_in_pts);
-            return link->status_out;
+            link_set_out_status(link, link->status_in, link->status_in_pts);
+            ret = link->status_out;
         }
+    } else {
+        link->frame_wanted_out = 1;
+        filter_set_ready(link->src, 100);
     }
-    link->frame_wanted_out = 1;
-    ff_filter_set_ready(link->src, 100);
-    return 0;
+    graph_unlock(link->dst);
+    return ret;
 }
 
+/**
+ * The graph lock must be held.
+ */
 static int64_t guess_status_pts(AVFilterContext *ctx, int status, AVRational link_time_base)
 {
     unsigned i;
@@ -453,14 +509,21 @@ static int ff_request_frame_to_filter(AVFilterLink *link)
 
     FF_TPRINTF_START(NULL, request_frame_to_filter); ff_tlog_link(NULL, link, 1);
     /* Assume the filter is blocked, let the method clear it if not */
+    graph_lock(link->dst);
     link->frame_blocked_in = 1;
+    graph_unlock(link->dst);
     if (link->srcpad->request_frame)
         ret = link->srcpad->request_frame(link);
     else if (link->src->inputs[0])
         ret = ff_request_frame(link->src->inputs[0]);
     if (ret < 0) {
-        if (ret != AVERROR(EAGAIN) && ret != link->status_in)
-            ff_avfilter_link_set_in_status(link, ret, guess_status_pts(link->src, ret, link->time_base));
+        if (ret != AVERROR(EAGAIN)) {
+            graph_lock(link->dst);
+            /* The destination may have closed the link in the meantime. */
+            if (!link->status_in)
+                link_set_in_status(link, ret, guess_status_pts(link->src, ret, link->time_base));
+            graph_unlock(link->dst);
+        }
         if (ret == AVERROR_EOF)
             ret = 0;
     }
@@ -627,8 +690,9 @@ static const AVClass *filter_child_class_next(const AVClass *prev)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption avfilter_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
-        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { .i64 = AVFILTER_THREAD_SLICE | AVFILTER_THREAD_FRAME }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = FLAGS, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = FLAGS, .unit = "thread_type" },
     { "enable", "set enable expression", OFFSET(enable_str), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = FLAGS },
     { "threads", "Allowed number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, FLAGS },
@@ -696,6 +760,8 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name)
     if (!ret->internal)
         goto err;
     ret->internal->execute = default_execute;
+    ret->internal->ready_index = -1;
+    ret->internal->writable_output = -1;
 
     ret->nb_inputs = avfilter_pad_count(filter->inputs);
     if (ret->nb_inputs ) {
@@ -746,6 +812,12 @@ static void free_link(AVFilterLink *link)
     if (link->dst)
         link->dst->inputs[link->dstpad - link->dst->input_pads] = NULL;
 
+    if (link->frame_copies)
+        av_log(link->dst ? (void *)link->dst : (void *)link->src, AV_LOG_VERBOSE,
+               "%"PRId64" frames copied on input %s to make them writable, "
+               "at most %"PRId64" frames queued\n",
+               link->frame_copies, link->dstpad->name, link->max_queued);
+
     av_buffer_unref(&link->hw_frames_ctx);
 
     ff_formats_unref(&link->in_formats);
@@ -886,7 +958,7 @@ static int process_options(AVFilterContext *ctx, AVDictionary **options,
 
 int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
-    int ret = 0;
+    int ret = 0, thread_type;
 
     ret = av_opt_set_dict(ctx, options);
     if (ret < 0) {
@@ -894,14 +966,19 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         return ret;
     }
 
+    thread_type = ctx->thread_type;
     if (ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
-        ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
+        thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
         ctx->graph->internal->thread_execute) {
         ctx->thread_type       = AVFILTER_THREAD_SLICE;
         ctx->internal->execute = ctx->graph->internal->thread_execute;
     } else {
         ctx->thread_type = 0;
     }
+    if (!(ctx->filter->flags_internal & FF_FILTER_FLAG_NO_FRAME_THREADS) &&
+        thread_type & ctx->graph->thread_type & AVFILTER_THREAD_FRAME &&
+        ctx->graph->internal->nb_frame_threads)
+        ctx->thread_type |= AVFILTER_THREAD_FRAME;
 
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict2(ctx->priv, options, AV_OPT_SEARCH_CHILDREN);
@@ -1068,7 +1145,13 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     if (dstctx->is_disabled &&
         (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
         filter_frame = default_filter_frame;
-    ret = filter_frame(link, frame);
+    if (dstctx->graph && dstctx->graph->profile) {
+        int64_t t = av_gettime_relative();
+        ret = filter_frame(link, frame);
+        dstctx->internal->profile.frame_time += av_gettime_relative() - t;
+    } else {
+        ret = filter_frame(link, frame);
+    }
     link->frame_count_out++;
     return ret;
 
@@ -1112,15 +1195,30 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         }
     }
 
+    graph_lock(link->dst);
     link->frame_blocked_in = link->frame_wanted_out = 0;
     link->frame_count_in++;
     filter_unblock(link->dst);
+    link->max_queued = FFMAX(link->max_queued,
+                             ff_framequeue_queued_frames(&link->fifo) + 1);
+    if (link->dst->graph && link->dst->graph->profile) {
+        AVFilterProfile *src = &link->src->internal->profile;
+        AVFilterProfile *dst = &link->dst->internal->profile;
+        int samples = link->type == AVMEDIA_TYPE_AUDIO ? frame->nb_samples : 0;
+        src->frames_out++;
+        src->samples_out += samples;
+        dst->frames_in++;
+        dst->samples_in  += samples;
+        dst->max_queued   = FFMAX(dst->max_queued, link->max_queued);
+    }
     ret = ff_framequeue_add(&link->fifo, frame);
+    if (ret >= 0)
+        filter_set_ready(link->dst, 300);
+    graph_unlock(link->dst);
     if (ret < 0) {
         av_frame_free(&frame);
         return ret;
     }
-    ff_filter_set_ready(link->dst, 300);
     return 0;
 
 error:
@@ -1135,6 +1233,9 @@ static int samples_ready(AVFilterLink *link, unsigned min)
             link->status_in);
 }
 
+/**
+ * The graph lock must be held; it is released while allocating the output.
+ */
 static int take_samples(AVFilterLink *link, unsigned min, unsigned max,
                         AVFrame **rframe)
 {
@@ -1165,7 +1266,10 @@ static int take_samples(AVFilterLink *link, unsigned min, unsigned max,
         frame = ff_framequeue_peek(&link->fifo, nb_frames);
     }
 
+    /* The source only appends to the FIFO, the frames counted above stay. */
+    graph_unlock(link->dst);
     buf = ff_get_audio_buffer(link, nb_samples);
+    graph_lock(link->dst);
     if (!buf)
         return AVERROR(ENOMEM);
     ret = av_frame_copy_props(buf, frame0);
@@ -1212,7 +1316,9 @@ static int ff_filter_frame_to_filter(AVFilterLink *link)
     }
     /* The filter will soon have received a new frame, that may allow it to
        produce one or more: unblock its outputs. */
+    graph_lock(dst);
     filter_unblock(dst);
+    graph_unlock(dst);
     /* AVFilterPad.filter_frame() expect frame_count_out to have the value
        before the frame; ff_filter_frame_framed() will re-increment it. */
     link->frame_count_out--;
@@ -1230,7 +1336,7 @@ static int ff_filter_frame_to_filter(AVFilterLink *link)
 static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
 {
     unsigned out = 0, progress = 0;
-    int ret;
+    int ret, closed;
 
     av_assert0(!in->status_out);
     if (!filter->nb_outputs) {
@@ -1238,7 +1344,10 @@ static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
         return 0;
     }
     while (!in->status_out) {
-        if (!filter->outputs[out]->status_in) {
+        graph_lock(filter);
+        closed = filter->outputs[out]->status_in;
+        graph_unlock(filter);
+        if (!closed) {
             progress++;
             ret = ff_request_frame_to_filter(filter->outputs[out]);
             if (ret < 0)
@@ -1259,28 +1368,40 @@ static int forward_status_change(AVFilterContext *filter, AVFilterLink *in)
     return 0;
 }
 
+static int forward_input_status_change(AVFilterLink *in)
+{
+    return forward_status_change(in->dst, in);
+}
+
 static int ff_filter_activate_default(AVFilterContext *filter)
 {
+    AVFilterLink *link = NULL;
+    int (*activate)(AVFilterLink *) = NULL;
     unsigned i;
 
-    for (i = 0; i < filter->nb_inputs; i++) {
+    graph_lock(filter);
+    for (i = 0; i < filter->nb_inputs && !link; i++) {
         if (samples_ready(filter->inputs[i], filter->inputs[i]->min_samples)) {
-            return ff_filter_frame_to_filter(filter->inputs[i]);
+            link     = filter->inputs[i];
+            activate = ff_filter_frame_to_filter;
         }
     }
-    for (i = 0; i < filter->nb_inputs; i++) {
+    for (i = 0; i < filter->nb_inputs && !link; i++) {
         if (filter->inputs[i]->status_in && !filter->inputs[i]->status_out) {
             av_assert1(!ff_framequeue_queued_frames(&filter->inputs[i]->fifo));
-            return forward_status_change(filter, filter->inputs[i]);
+            link     = filter->inputs[i];
+            activate = forward_input_status_change;
         }
     }
-    for (i = 0; i < filter->nb_outputs; i++) {
+    for (i = 0; i < filter->nb_outputs && !link; i++) {
         if (filter->outputs[i]->frame_wanted_out &&
             !filter->outputs[i]->frame_blocked_in) {
-            return ff_request_frame_to_filter(filter->outputs[i]);
+            link     = filter->outputs[i];
+            activate = ff_request_frame_to_filter;
         }
     }
-    return FFERROR_NOT_READY;
+    graph_unlock(filter);
+    return link ? activate(link) : FFERROR_NOT_READY;
 }
 
 /*
@@ -1353,7 +1474,8 @@ static int ff_filter_activate_default(AVFilterContext *filter)
      ff_avfilter_link_set_out_status().
 
    Filters are activated according to the ready field, set using the
-   ff_filter_set_ready(). Eventually, a priority queue will be used.
+   ff_filter_set_ready(), which keeps the ready filters of the graph in a
+   priority queue.
    ff_filter_set_ready() is called whenever anything could cause progress to
    be possible. Marking a filter ready when it is not is not a problem,
    except for the small overhead it causes.
@@ -1418,6 +1540,18 @@ static int ff_filter_activate_default(AVFilterContext *filter)
 
  */
 
+/* CPU time of the calling thread in microseconds, 0 if not available */
+static int64_t thread_cpu_time(void)
+{
+#if HAVE_CLOCK_GETTIME && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+    return 0;
+}
+
 int ff_filter_activate(AVFilterContext *filter)
 {
     int ret;
@@ -1425,54 +1559,113 @@ int ff_filter_activate(AVFilterContext *filter)
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
-    filter->ready = 0;
-    ret = filter->filter->activate ? filter->filter->activate(filter) :
-          ff_filter_activate_default(filter);
+    if (filter->graph) {
+        ff_graph_lock(filter->graph);
+        filter->ready = 0;
+        ff_filter_graph_update_ready(filter);
+        ff_graph_unlock(filter->graph);
+    } else {
+        filter->ready = 0;
+    }
+    if (filter->graph && filter->graph->profile) {
+        AVFilterProfile *p = &filter->internal->profile;
+        int64_t wall = av_gettime_relative(), cpu = thread_cpu_time();
+
+        ret = filter->filter->activate ? filter->filter->activate(filter) :
+              ff_filter_activate_default(filter);
+        p->nb_runs++;
+        p->wall_time += av_gettime_relative() - wall;
+        p->cpu_time  += thread_cpu_time() - cpu;
+    } else {
+        ret = filter->filter->activate ? filter->filter->activate(filter) :
+              ff_filter_activate_default(filter);
+    }
     if (ret == FFERROR_NOT_READY)
         ret = 0;
     return ret;
 }
 
+int avfilter_get_profile(const AVFilterContext *filter, AVFilterProfile *profile)
+{
+    if (!filter->graph || !filter->graph->profile)
+        return AVERROR(EINVAL);
+    *profile = filter->internal->profile;
+    return 0;
+}
+
 int ff_inlink_acknowledge_status(AVFilterLink *link, int *rstatus, int64_t *rpts)
 {
+    int ret = 0;
+
+    graph_lock(link->dst);
     *rpts = link->current_pts;
-    if (ff_framequeue_queued_frames(&link->fifo))
-        return *rstatus = 0;
-    if (link->status_out)
-        return *rstatus = link->status_out;
-    if (!link->status_in)
-        return *rstatus = 0;
-    *rstatus = link->status_out = link->status_in;
-    ff_update_link_current_pts(link, link->status_in_pts);
-    *rpts = link->current_pts;
-    return 1;
+    if (ff_framequeue_queued_frames(&link->fifo)) {
+        *rstatus = 0;
+    } else if (link->status_out) {
+        ret = *rstatus = link->status_out;
+    } else if (!link->status_in) {
+        *rstatus = 0;
+    } else {
+        *rstatus = link->status_out = link->status_in;
+        ff_update_link_current_pts(link, link->status_in_pts);
+        *rpts = link->current_pts;
+        ret = 1;
+    }
+    graph_unlock(link->dst);
+    return ret;
 }
 
 size_t ff_inlink_queued_frames(AVFilterLink *link)
 {
-    return ff_framequeue_queued_frames(&link->fifo);
+    size_t ret;
+
+    graph_lock(link->dst);
+    ret = ff_framequeue_queued_frames(&link->fifo);
+    graph_unlock(link->dst);
+    return ret;
 }
 
 int ff_inlink_check_available_frame(AVFilterLink *link)
 {
-    return ff_framequeue_queued_frames(&link->fifo) > 0;
+    return ff_inlink_queued_frames(link) > 0;
 }
 
 int ff_inlink_queued_samples(AVFilterLink *link)
 {
-    return ff_framequeue_queued_samples(&link->fifo);
+    int ret;
+
+    graph_lock(link->dst);
+    ret = ff_framequeue_queued_samples(&link->fifo);
+    graph_unlock(link->dst);
+    return ret;
 }
 
-int ff_inlink_check_available_samples(AVFilterLink *link, unsigned min)
+static int check_available_samples(AVFilterLink *link, unsigned min)
 {
     uint64_t samples = ff_framequeue_queued_samples(&link->fifo);
     av_assert1(min);
     return samples >= min || (link->status_in && samples);
 }
 
+int ff_inlink_check_available_samples(AVFilterLink *link, unsigned min)
+{
+    int ret;
+
+    graph_lock(link->dst);
+    ret = check_available_samples(link, min);
+    graph_unlock(link->dst);
+    return ret;
+}
+
 static void consume_update(AVFilterLink *link, const AVFrame *frame)
 {
-    ff_update_link_current_pts(link, frame->pts);
+    graph_lock(link->dst);
+    /* Frames still queued when the destination closed the link are only
+       drained: they must not move the EOF timestamp, or it would depend on
+       how far ahead the source filter ran. */
+    if (!link->status_out)
+        ff_update_link_current_pts(link, frame->pts);
+    graph_unlock(link->dst);
     ff_inlink_process_commands(link, frame);
     link->dst->is_disabled = !ff_inlink_evaluate_timeline_at_frame(link, frame);
     link->frame_count_out++;
@@ -1483,15 +1676,20 @@ int ff_inlink_consume_frame(AVFilterLink *link, AVFrame **rframe)
     AVFrame *frame;
 
     *rframe = NULL;
-    if (!ff_inlink_check_available_frame(link))
+    graph_lock(link->dst);
+    if (!ff_framequeue_queued_frames(&link->fifo)) {
+        graph_unlock(link->dst);
         return 0;
+    }
 
     if (link->fifo.samples_skipped) {
         frame = ff_framequeue_peek(&link->fifo, 0);
+        graph_unlock(link->dst);
         return ff_inlink_consume_samples(link, frame->nb_samples, frame->nb_samples, rframe);
     }
 
     frame = ff_framequeue_take(&link->fifo);
+    graph_unlock(link->dst);
     consume_update(link, frame);
     *rframe = frame;
     return 1;
@@ -1505,11 +1703,15 @@ int ff_inlink_consume_samples(AVFilterLink *link, unsigned min, unsigned max,
 
     av_assert1(min);
     *rframe = NULL;
-    if (!ff_inlink_check_available_samples(link, min))
+    graph_lock(link->dst);
+    if (!check_available_samples(link, min)) {
+        graph_unlock(link->dst);
         return 0;
+    }
     if (link->status_in)
         min = FFMIN(min, ff_framequeue_queued_samples(&link->fifo));
     ret = take_samples(link, min, max, &frame);
+    graph_unlock(link->dst);
     if (ret < 0)
         return ret;
     consume_update(link, frame);
@@ -1519,7 +1721,12 @@ int ff_inlink_consume_samples(AVFilterLink *link, unsigned min, unsigned max,
 
 AVFrame *ff_inlink_peek_frame(AVFilterLink *link, size_t idx)
 {
-    return ff_framequeue_peek(&link->fifo, idx);
+    AVFrame *frame;
+
+    graph_lock(link->dst);
+    frame = ff_framequeue_peek(&link->fifo, idx);
+    graph_unlock(link->dst);
+    return frame;
 }
 
 int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
@@ -1531,6 +1738,7 @@ int ff_inlink_make_frame_writable(AVFilterLink *link, AVFrame **rframe)
     if (av_frame_is_writable(frame))
         return 0;
     av_log(link->dst, AV_LOG_DEBUG, "Copying data in avfilter.\n");
+    link->frame_copies++;
 
     switch (link->type) {
     case AVMEDIA_TYPE_VIDEO:
@@ -1606,30 +1814,53 @@ int ff_inlink_evaluate_timeline_at_frame(AVFilterLink *link, const AVFrame *fram
 
 void ff_inlink_request_frame(AVFilterLink *link)
 {
-    av_assert1(!link->status_in);
     av_assert1(!link->status_out);
-    link->frame_wanted_out = 1;
-    ff_filter_set_ready(link->src, 100);
+    graph_lock(link->dst);
+    /* The source may have set a status since the caller checked it. */
+    if (!link->status_in) {
+        link->frame_wanted_out = 1;
+        filter_set_ready(link->src, 100);
+    }
+    graph_unlock(link->dst);
 }
 
 void ff_inlink_set_status(AVFilterLink *link, int status)
 {
-    if (link->status_out)
+    graph_lock(link->dst);
+    if (link->status_out) {
+        graph_unlock(link->dst);
         return;
+    }
     link->frame_wanted_out = 0;
     link->frame_blocked_in = 0;
-    ff_avfilter_link_set_out_status(link, status, AV_NOPTS_VALUE);
+    link_set_out_status(link, status, AV_NOPTS_VALUE);
     while (ff_framequeue_queued_frames(&link->fifo)) {
            AVFrame *frame = ff_framequeue_take(&link->fifo);
            av_frame_free(&frame);
     }
     if (!link->status_in)
         link->status_in = status;
+    graph_unlock(link->dst);
+}
+
+int ff_outlink_frame_wanted(AVFilterLink *link)
+{
+    int ret;
+
+    graph_lock(link->dst);
+    ret = link->frame_wanted_out;
+    graph_unlock(link->dst);
+    return ret;
 }
 
 int ff_outlink_get_status(AVFilterLink *link)
 {
-    return link->status_in;
+    int ret;
+
+    graph_lock(link->dst);
+    ret = link->status_in;
+    graph_unlock(link->dst);
+    return ret;
 }
 
 const AVClass *avfilter_get_class(void)
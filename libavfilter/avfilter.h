@@ -332,6 +332,14 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate different filters concurrently, so that independent branches and
+ * successive frames queued along a chain are processed in parallel. Only
+ * used by graphs that manage their own threads, i.e. when
+ * AVFilterGraph.execute is not set.
+ */
+#define AVFILTER_THREAD_FRAME (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -600,6 +608,19 @@ struct AVFilterLink {
      */
     AVBufferRef *hw_frames_ctx;
 
+    /**
+     * Number of frames copied because the destination filter needed to
+     * write to a frame that was shared with other filters.
+     */
+    int64_t frame_copies;
+
+    /**
+     * Highest number of frames queued on this link. The max_queued field
+     * of AVFilterProfile is the highest of these over the inputs of a
+     * filter.
+     */
+    int64_t max_queued;
+
 #ifndef FF_INTERNAL_FIELDS
 
     /**
@@ -896,6 +917,26 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * Maximum total size in bytes of the buffers allocated for the video
+     * frames of this graph. Links with the same format and size share their
+     * buffers. Once the buffers grow beyond this size, the buffer sources
+     * refuse every other frame with AVERROR(EAGAIN) while frames are queued
+     * anywhere in the graph, so that the caller retrieves the output first.
+     *
+     * This is advisory: it is not a hard cap on the allocations. The buffers
+     * stay allocated until the link that uses them is reconfigured or the
+     * graph is freed, so once the limit is reached it stays reached.
+     * Zero (the default) means no limit.
+     */
+    int64_t max_frame_memory;
+
+    /**
+     * If set, collect processing statistics for each filter of the graph,
+     * see avfilter_get_profile(). Must be set before the graph is configured.
+     */
+    int profile;
+
     /**
      * Private fields
      *
@@ -916,6 +957,35 @@ typedef struct AVFilterGraph {
  */
 AVFilterGraph *avfilter_graph_alloc(void);
 
+/**
+ * Processing statistics of a filter, collected when AVFilterGraph.profile
+ * is set. Times are in microseconds.
+ */
+typedef struct AVFilterProfile {
+    int64_t nb_runs;        ///< number of times the filter was activated
+    int64_t wall_time;      ///< wall clock time spent running the filter
+    /**
+     * CPU time of the thread running the filter, 0 where it cannot be
+     * measured. Work done by slice threads is not included.
+     */
+    int64_t cpu_time;
+    int64_t frame_time;     ///< part of wall_time spent in filter_frame() callbacks
+    int64_t frames_in;      ///< frames sent to the inputs of the filter
+    int64_t frames_out;     ///< frames sent by the filter on its outputs
+    int64_t samples_in;     ///< audio samples sent to the inputs of the filter
+    int64_t samples_out;    ///< audio samples sent by the filter on its outputs
+    int64_t max_queued;     ///< highest number of frames queued on one input
+} AVFilterProfile;
+
+/**
+ * Get the processing statistics of a filter.
+ *
+ * @param filter  a filter of a graph with AVFilterGraph.profile set
+ * @param profile filled with the statistics of the filter so far
+ * @return 0 on success, AVERROR(EINVAL) if profiling is not enabled
+ */
+int avfilter_get_profile(const AVFilterContext *filter, AVFilterProfile *profile);
+
 /**
  * Create a new filter instance in a filter graph.
  *
@@ -50,12 +50,17 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|V },
     {"aresample_swr_opts"   , "default aresample filter options"    , OFFSET(aresample_swr_opts)    ,
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
+    { "max_frame_memory", "Maximum size of the video frame pools before sources apply backpressure",
+        OFFSET(max_frame_memory), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, F|V },
+    { "profile",     "Collect processing statistics for each filter", OFFSET(profile),
+        AV_OPT_TYPE_BOOL,  { .i64 = 0 }, 0, 1, F|V|A },
     { NULL },
 };
 
@@ -78,6 +83,20 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+}
+
+int ff_graph_activate_frames(AVFilterGraph *graph, AVFilterContext **filters,
+                             int nb_filters)
+{
+    return AVERROR(ENOSYS);
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -92,6 +111,13 @@ AVFilterGraph *avfilter_graph_alloc(void)
         return NULL;
     }
 
+    ret->internal->frame_pools = ff_frame_pool_registry_alloc();
+    if (!ret->internal->frame_pools) {
+        av_freep(&ret->internal);
+        av_freep(&ret);
+        return NULL;
+    }
+
     ret->av_class = &filtergraph_class;
     av_opt_set_defaults(ret);
     ff_framequeue_global_init(&ret->internal->frame_queues);
@@ -99,14 +125,96 @@ AVFilterGraph *avfilter_graph_alloc(void)
     return ret;
 }
 
+static int ready_before(const AVFilterContext *a, const AVFilterContext *b)
+{
+    if (a->ready != b->ready)
+        return a->ready > b->ready;
+    if (a->internal->run_last != b->internal->run_last)
+        return b->internal->run_last;
+    return a->internal->graph_index < b->internal->graph_index;
+}
+
+static void ready_heap_set(AVFilterGraphInternal *gi, unsigned i, AVFilterContext *filter)
+{
+    gi->ready[i] = filter;
+    filter->internal->ready_index = i;
+}
+
+static void ready_heap_up(AVFilterGraphInternal *gi, unsigned i)
+{
+    AVFilterContext *filter = gi->ready[i];
+
+    while (i > 0 && ready_before(filter, gi->ready[(i - 1) / 2])) {
+        ready_heap_set(gi, i, gi->ready[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    ready_heap_set(gi, i, filter);
+}
+
+static void ready_heap_down(AVFilterGraphInternal *gi, unsigned i)
+{
+    AVFilterContext *filter = gi->ready[i];
+    unsigned child;
+
+    while ((child = 2 * i + 1) < gi->nb_ready) {
+        if (child + 1 < gi->nb_ready && ready_before(gi->ready[child + 1], gi->ready[child]))
+            child++;
+        if (!ready_before(gi->ready[child], filter))
+            break;
+        ready_heap_set(gi, i, gi->ready[child]);
+        i = child;
+    }
+    ready_heap_set(gi, i, filter);
+}
+
+static void ready_heap_remove(AVFilterGraphInternal *gi, AVFilterContext *filter)
+{
+    unsigned i = filter->internal->ready_index;
+    AVFilterContext *last = gi->ready[--gi->nb_ready];
+
+    filter->internal->ready_index = -1;
+    if (last == filter)
+        return;
+    ready_heap_set(gi, i, last);
+    ready_heap_up(gi, i);
+    ready_heap_down(gi, last->internal->ready_index);
+}
+
+void ff_filter_graph_update_ready(AVFilterContext *filter)
+{
+    AVFilterGraphInternal *gi = filter->graph->internal;
+    int i = filter->internal->ready_index;
+
+    if (!filter->ready) {
+        if (i >= 0)
+            ready_heap_remove(gi, filter);
+        return;
+    }
+    if (i < 0) {
+        i = gi->nb_ready++;
+        ready_heap_set(gi, i, filter);
+    }
+    ready_heap_up(gi, i);
+    ready_heap_down(gi, filter->internal->ready_index);
+}
+
 void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter)
 {
     int i, j;
     for (i = 0; i < graph->nb_filters; i++) {
         if (graph->filters[i] == filter) {
+            if (filter->internal->ready_index >= 0)
+                ready_heap_remove(graph->internal, filter);
             FFSWAP(AVFilterContext*, graph->filters[i],
                    graph->filters[graph->nb_filters - 1]);
             graph->nb_filters--;
+            /* the filter moved in its place now comes earlier among equals */
+            if (i < graph->nb_filters) {
+                AVFilterContext *moved = graph->filters[i];
+                moved->internal->graph_index = i;
+                if (moved->internal->ready_index >= 0)
+                    ready_heap_up(graph->internal, moved->internal->ready_index);
+            }
             filter->graph = NULL;
             for (j = 0; j<filter->nb_outputs; j++)
                 if (filter->outputs[j])
@@ -127,6 +235,8 @@ void avfilter_graph_free(AVFilterGraph **graph)
 
     ff_graph_thread_free(*graph);
 
+    av_freep(&(*graph)->internal->ready);
+    ff_frame_pool_registry_free(&(*graph)->internal->frame_pools);
     av_freep(&(*graph)->sink_links);
 
     av_freep(&(*graph)->scale_sws_opts);
@@ -171,7 +281,7 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
                                              const AVFilter *filter,
                                              const char *name)
 {
-    AVFilterContext **filters, *s;
+    AVFilterContext **filters, **ready, *s;
 
     if (graph->thread_type && !graph->internal->thread_execute) {
         if (graph->execute) {
@@ -196,6 +306,15 @@ AVFilterContext *avfilter_graph_alloc_filter(AVFilterGraph *graph,
     }
 
     graph->filters = filters;
+
+    ready = av_realloc_array(graph->internal->ready, graph->nb_filters + 1, sizeof(*ready));
+    if (!ready) {
+        avfilter_free(s);
+        return NULL;
+    }
+    graph->internal->ready = ready;
+
+    s->internal->graph_index = graph->nb_filters;
     graph->filters[graph->nb_filters++] = s;
 
     s->graph = graph;
@@ -1184,6 +1303,61 @@ static int graph_config_formats(AVFilterGraph *graph, AVClass *log_ctx)
     return 0;
 }
 
+/**
+ * Follow a link through the filters that pass frames on unchanged, and
+ * return the link the frames finally arrive on.
+ */
+static AVFilterLink *passthrough_end(AVFilterLink *link)
+{
+    while ((link->dst->filter->flags_internal & FF_FILTER_FLAG_PASSTHROUGH) &&
+           link->dst->nb_outputs == 1 && link->dst->outputs[0])
+        link = link->dst->outputs[0];
+    return link;
+}
+
+/**
+ * Hand the writable reference of each fan-out filter to one consumer.
+ *
+ * The outputs of a fan-out filter all share the same frame, so every
+ * destination that needs to write to it has to copy it first, unless the
+ * other references are gone by then. Among the outputs whose destination
+ * pad needs writable frames, possibly behind pass-through filters, the
+ * first one is sent the frame last and its writer is activated after the
+ * other equally ready filters; the branches that only read the frame have
+ * then usually released it, and the copy is skipped. The other writers
+ * still copy.
+ */
+static void graph_config_writable(AVFilterGraph *graph, void *log_ctx)
+{
+    int i, j;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        int writers = 0;
+
+        if (!(f->filter->flags_internal & FF_FILTER_FLAG_FANOUT))
+            continue;
+
+        f->internal->writable_output = -1;
+        for (j = 0; j < f->nb_outputs; j++) {
+            AVFilterLink *link = f->outputs[j];
+
+            if (!link || !(link = passthrough_end(link))->dstpad->needs_writable)
+                continue;
+            if (!writers++) {
+                f->internal->writable_output = j;
+                link->dst->internal->run_last = 1;
+                ff_filter_graph_update_ready(link->dst);
+            }
+        }
+        if (writers)
+            av_log(log_ctx, AV_LOG_DEBUG,
+                   "Filter '%s': output %d gets the writable reference, "
+                   "%d of %d outputs read only\n", f->name,
+                   f->internal->writable_output, f->nb_outputs - writers, f->nb_outputs);
+    }
+}
+
 static int graph_config_pointers(AVFilterGraph *graph,
                                              AVClass *log_ctx)
 {
@@ -1280,6 +1454,7 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    graph_config_writable(graphctx, log_ctx);
 
     return 0;
 }
@@ -1439,17 +1614,61 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
-int ff_filter_graph_run_once(AVFilterGraph *graph)
+/**
+ * Activate the most urgent filter together with other ready filters, on the
+ * frame threads. The filters at both ends of a link only share its FIFO and
+ * its activation fields, which are protected by ff_graph_lock(), so the
+ * filters of a chain each work on their own frame at the same time.
+ */
+static int run_frame_batch(AVFilterGraph *graph)
 {
-    AVFilterContext *filter;
+    AVFilterGraphInternal *gi = graph->internal;
+    AVFilterContext *top = gi->ready[0];
     unsigned i;
+    int nb = 0;
+
+    gi->frame_batch[nb++] = top;
+    if (top->thread_type & AVFILTER_THREAD_FRAME) {
+        for (i = 1; i < gi->nb_ready && nb < gi->nb_frame_threads; i++) {
+            AVFilterContext *filter = gi->ready[i];
+
+            /* A filter writing to a shared frame waits for its readers. */
+            if (!(filter->thread_type & AVFILTER_THREAD_FRAME) ||
+                filter->internal->run_last)
+                continue;
+            gi->frame_batch[nb++] = filter;
+        }
+    }
+    if (nb == 1)
+        return ff_filter_activate(top);
+    return ff_graph_activate_frames(graph, gi->frame_batch, nb);
+}
+
+int ff_filter_graph_frame_memory_exceeded(AVFilterGraph *graph)
+{
+    int i, j, queued = 0;
 
+    if (!graph->max_frame_memory ||
+        ff_frame_pool_registry_memory(graph->internal->frame_pools) <= graph->max_frame_memory)
+        return 0;
+    /* Frames queued between filters hold pool buffers just as well as the
+     * ones waiting in the sinks. */
+    ff_graph_lock(graph);
+    for (i = 0; i < graph->nb_filters && !queued; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        for (j = 0; j < filter->nb_inputs && !queued; j++)
+            queued = ff_framequeue_queued_frames(&filter->inputs[j]->fifo) > 0;
+    }
+    ff_graph_unlock(graph);
+    return queued;
+}
+
+int ff_filter_graph_run_once(AVFilterGraph *graph)
+{
     av_assert0(graph->nb_filters);
-    filter = graph->filters[0];
-    for (i = 1; i < graph->nb_filters; i++)
-        if (graph->filters[i]->ready > filter->ready)
-            filter = graph->filters[i];
-    if (!filter->ready)
+    if (!graph->internal->nb_ready)
         return AVERROR(EAGAIN);
-    return ff_filter_activate(filter);
+    if (graph->internal->nb_frame_threads)
+        return run_frame_batch(graph);
+    return ff_filter_activate(graph->internal->ready[0]);
 }
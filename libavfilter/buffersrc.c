@@ -65,6 +65,7 @@ typedef struct BufferSourceContext {
 
     int got_format_from_params;
     int eof;
+    int backpressure;   ///< the last frame was refused with EAGAIN
 } BufferSourceContext;
 
 #define CHECK_VIDEO_PARAM_CHANGE(s, c, width, height, format)\
@@ -201,6 +202,12 @@ static int av_buffersrc_add_frame_internal(AVFilterContext *ctx,
     if (s->eof)
         return AVERROR(EINVAL);
 
+    if (!s->backpressure && ff_filter_graph_frame_memory_exceeded(ctx->graph)) {
+        s->backpressure = 1;
+        return AVERROR(EAGAIN);
+    }
+    s->backpressure = 0;
+
     refcounted = !!frame->buf[0];
 
     if (!(flags & AV_BUFFERSRC_FLAG_NO_CHECK_FORMAT)) {
@@ -187,7 +187,11 @@ int av_buffersrc_add_frame(AVFilterContext *ctx, AVFrame *frame);
  * @param frame       a frame, or NULL to mark EOF
  * @param flags       a combination of AV_BUFFERSRC_FLAG_*
  * @return            >= 0 in case of success, a negative AVERROR code
- *                    in case of failure
+ *                    in case of failure. AVERROR(EAGAIN) means that the
+ *                    graph is over its AVFilterGraph.max_frame_memory and the
+ *                    frames queued in it must be retrieved from its buffer
+ *                    sinks first. A frame refused this way is always accepted by
+ *                    the next call.
  */
 av_warn_unused_result
 int av_buffersrc_add_frame_flags(AVFilterContext *buffer_src,
@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "framepool.h"
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
@@ -26,6 +28,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixfmt.h"
+#include "libavutil/thread.h"
 
 struct FFFramePool {
 
@@ -46,8 +49,31 @@ struct FFFramePool {
     int linesize[4];
     AVBufferPool *pools[4];
 
+    /* video */
+    AVBufferRef* (*alloc)(int size);
+    atomic_int_least64_t memory;
+
+    /* shared pools, refcount is protected by the registry mutex */
+    FFFramePoolRegistry *registry;
+    int refcount;
 };
 
+struct FFFramePoolRegistry {
+    AVMutex mutex;
+    FFFramePool **pools;
+    int nb_pools;
+};
+
+static AVBufferRef *pool_alloc_video(void *opaque, int size)
+{
+    FFFramePool *pool = opaque;
+    AVBufferRef *buf = pool->alloc(size);
+
+    if (buf)
+        atomic_fetch_add_explicit(&pool->memory, size, memory_order_relaxed);
+    return buf;
+}
+
 FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
                                       int width,
                                       int height,
@@ -70,6 +96,8 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
     pool->height = height;
     pool->format = format;
     pool->align = align;
+    pool->alloc = alloc ? alloc : av_buffer_alloc;
+    atomic_init(&pool->memory, 0);
 
     if ((ret = av_image_check_size2(width, height, INT64_MAX, format, 0, NULL)) < 0) {
         goto fail;
@@ -96,15 +124,16 @@ FFFramePool *ff_frame_pool_video_init(AVBufferRef* (*alloc)(int size),
         if (i == 1 || i == 2)
             h = AV_CEIL_RSHIFT(h, desc->log2_chroma_h);
 
-        pool->pools[i] = av_buffer_pool_init(pool->linesize[i] * h + 16 + 16 - 1,
-                                             alloc);
+        pool->pools[i] = av_buffer_pool_init2(pool->linesize[i] * h + 16 + 16 - 1,
+                                              pool, pool_alloc_video, NULL);
         if (!pool->pools[i])
             goto fail;
     }
 
     if (desc->flags & AV_PIX_FMT_FLAG_PAL ||
         desc->flags & FF_PSEUDOPAL) {
-        pool->pools[1] = av_buffer_pool_init(AVPALETTE_SIZE, alloc);
+        pool->pools[1] = av_buffer_pool_init2(AVPALETTE_SIZE, pool,
+                                              pool_alloc_video, NULL);
         if (!pool->pools[1])
             goto fail;
     }
@@ -281,6 +310,24 @@ fail:
     return NULL;
 }
 
+/* drop a reference to a shared pool, return 1 if it was the last one */
+static int registry_release(FFFramePoolRegistry *registry, FFFramePool *pool)
+{
+    int i, last;
+
+    ff_mutex_lock(&registry->mutex);
+    last = !--pool->refcount;
+    if (last) {
+        for (i = 0; i < registry->nb_pools; i++)
+            if (registry->pools[i] == pool)
+                break;
+        av_assert0(i < registry->nb_pools);
+        registry->pools[i] = registry->pools[--registry->nb_pools];
+    }
+    ff_mutex_unlock(&registry->mutex);
+    return last;
+}
+
 void ff_frame_pool_uninit(FFFramePool **pool)
 {
     int i;
@@ -288,9 +335,90 @@ void ff_frame_pool_uninit(FFFramePool **pool)
     if (!pool || !*pool)
         return;
 
+    if ((*pool)->registry && !registry_release((*pool)->registry, *pool)) {
+        *pool = NULL;
+        return;
+    }
+
     for (i = 0; i < 4; i++) {
         av_buffer_pool_uninit(&(*pool)->pools[i]);
     }
 
     av_freep(pool);
 }
+
+FFFramePoolRegistry *ff_frame_pool_registry_alloc(void)
+{
+    FFFramePoolRegistry *registry = av_mallocz(sizeof(*registry));
+
+    if (!registry)
+        return NULL;
+    ff_mutex_init(&registry->mutex, NULL);
+    return registry;
+}
+
+void ff_frame_pool_registry_free(FFFramePoolRegistry **registry)
+{
+    if (!registry || !*registry)
+        return;
+
+    av_assert0(!(*registry)->nb_pools);
+    ff_mutex_destroy(&(*registry)->mutex);
+    av_freep(&(*registry)->pools);
+    av_freep(registry);
+}
+
+FFFramePool *ff_frame_pool_registry_get_video(FFFramePoolRegistry *registry,
+                                              AVBufferRef* (*alloc)(int size),
+                                              int width,
+                                              int height,
+                                              enum AVPixelFormat format,
+                                              int align)
+{
+    FFFramePool *pool = NULL, **pools;
+    int i;
+
+    if (!alloc)
+        alloc = av_buffer_alloc;
+
+    ff_mutex_lock(&registry->mutex);
+    for (i = 0; i < registry->nb_pools; i++) {
+        FFFramePool *p = registry->pools[i];
+        if (p->width == width && p->height == height && p->format == format &&
+            p->align == align && p->alloc == alloc) {
+            pool = p;
+            pool->refcount++;
+            goto end;
+        }
+    }
+
+    pools = av_realloc_array(registry->pools, registry->nb_pools + 1,
+                             sizeof(*registry->pools));
+    if (!pools)
+        goto end;
+    registry->pools = pools;
+
+    pool = ff_frame_pool_video_init(alloc, width, height, format, align);
+    if (!pool)
+        goto end;
+    pool->registry = registry;
+    pool->refcount = 1;
+    registry->pools[registry->nb_pools++] = pool;
+
+end:
+    ff_mutex_unlock(&registry->mutex);
+    return pool;
+}
+
+int64_t ff_frame_pool_registry_memory(FFFramePoolRegistry *registry)
+{
+    int64_t memory = 0;
+    int i;
+
+    ff_mutex_lock(&registry->mutex);
+    for (i = 0; i < registry->nb_pools; i++)
+        memory += atomic_load_explicit(&registry->pools[i]->memory,
+                                       memory_order_relaxed);
+    ff_mutex_unlock(&registry->mutex);
+    return memory;
+}
@@ -114,5 +114,54 @@ int ff_frame_pool_get_audio_config(FFFramePool *pool,
  */
 AVFrame *ff_frame_pool_get(FFFramePool *pool);
 
+/**
+ * Registry of video frame pools, shared by all the users that ask for the
+ * same parameters. This structure is opaque and not meant to be accessed
+ * directly. It is allocated with ff_frame_pool_registry_alloc() and freed
+ * with ff_frame_pool_registry_free().
+ */
+typedef struct FFFramePoolRegistry FFFramePoolRegistry;
+
+/**
+ * Allocate an empty frame pool registry.
+ *
+ * @return newly created registry on success, NULL on error.
+ */
+FFFramePoolRegistry *ff_frame_pool_registry_alloc(void);
+
+/**
+ * Free a frame pool registry. All the pools obtained from it must have been
+ * released with ff_frame_pool_uninit() before.
+ *
+ * @param registry pointer to the registry to be freed. It will be set to NULL.
+ */
+void ff_frame_pool_registry_free(FFFramePoolRegistry **registry);
+
+/**
+ * Get a video frame pool from a registry. If the registry already holds a
+ * pool with the same parameters, a new reference to it is returned,
+ * otherwise a pool is created and added to the registry. Each pool obtained
+ * this way must be released with ff_frame_pool_uninit(), the pool is freed
+ * and removed from the registry once all its users have released it.
+ * This function may be called simultaneously from multiple threads.
+ *
+ * The parameters are the same as for ff_frame_pool_video_init().
+ *
+ * @return a video frame pool on success, NULL on error.
+ */
+FFFramePool *ff_frame_pool_registry_get_video(FFFramePoolRegistry *registry,
+                                              AVBufferRef* (*alloc)(int size),
+                                              int width,
+                                              int height,
+                                              enum AVPixelFormat format,
+                                              int align);
+
+/**
+ * Get the total size of the buffers allocated by the pools of a registry,
+ * whether they are in use or not.
+ *
+ * @return size in bytes
+ */
+int64_t ff_frame_pool_registry_memory(FFFramePoolRegistry *registry);
 
 #endif /* AVFILTER_FRAMEPOOL_H */
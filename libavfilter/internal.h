@@ -149,10 +149,52 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Filters with a non-zero ready field, as a binary heap ordered by
+     * decreasing ready value, then by increasing position in the graph.
+     * It is allocated to hold all the filters of the graph.
+     */
+    AVFilterContext **ready;
+    unsigned nb_ready;
+
+    /**
+     * Filters activated concurrently by one round of frame threading,
+     * nb_frame_threads entries are allocated. Frame threading is disabled
+     * when nb_frame_threads is 0.
+     */
+    AVFilterContext **frame_batch;
+    int nb_frame_threads;
+
+    /**
+     * Video frame pools of the links of the graph, shared between the links
+     * with the same format and size.
+     */
+    FFFramePoolRegistry *frame_pools;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    unsigned graph_index;   ///< position of the filter in AVFilterGraph.filters
+    int ready_index;        ///< position of the filter in the ready heap, or -1
+
+    /**
+     * For FF_FILTER_FLAG_FANOUT filters, the output whose destination writes
+     * to its frames, or -1. Set by avfilter_graph_config().
+     */
+    int writable_output;
+
+    /**
+     * Activate the filter after the other filters with the same ready value,
+     * so that the filters that only read a shared frame release it first.
+     */
+    int run_last;
+
+    /**
+     * Statistics returned by avfilter_get_profile(), updated only when
+     * AVFilterGraph.profile is set.
+     */
+    AVFilterProfile profile;
 };
 
 /**
@@ -226,6 +268,10 @@ av_warn_unused_result
 int ff_parse_channel_layout(int64_t *ret, int *nret, const char *arg,
                             void *log_ctx);
 
+/**
+ * Update the current pts of a link and its place in the graph age heap.
+ * With frame threading, the graph lock must be held.
+ */
 void ff_update_link_current_pts(AVFilterLink *link, int64_t pts);
 
 /**
@@ -384,11 +430,46 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter reaches into other filters of the graph, and must never be
+ * activated concurrently with any of them by frame threading.
+ */
+#define FF_FILTER_FLAG_NO_FRAME_THREADS (1 << 1)
+
+/**
+ * The filter sends a reference to each input frame to every output,
+ * as split does. avfilter_graph_config() finds the output, if any, whose
+ * destination needs writable frames; the filter must send the frame to
+ * that output last, see AVFilterInternal.writable_output.
+ */
+#define FF_FILTER_FLAG_FANOUT (1 << 2)
+
+/**
+ * The filter has one input and one output, and sends its input frames to
+ * the output without touching their data. When looking for the output of
+ * a FF_FILTER_FLAG_FANOUT filter that writes to its frames,
+ * avfilter_graph_config() looks through such filters.
+ */
+#define FF_FILTER_FLAG_PASSTHROUGH (1 << 3)
+
 /**
  * Run one round of processing on a filter graph.
  */
 int ff_filter_graph_run_once(AVFilterGraph *graph);
 
+/**
+ * Update the place of a filter in the ready queue of its graph, after its
+ * ready field changed.
+ */
+void ff_filter_graph_update_ready(AVFilterContext *filter);
+
+/**
+ * Check whether a graph source should hold back new frames until the caller
+ * has retrieved the output, because the frame pools of the graph have grown
+ * beyond AVFilterGraph.max_frame_memory and frames are queued on its links.
+ */
+int ff_filter_graph_frame_memory_exceeded(AVFilterGraph *graph);
+
 /**
  * Normalize the qscale factor
  * FIXME the H264 qscale is a log based scale, mpeg1/2 is not, the code below
@@ -42,6 +42,13 @@ typedef struct ThreadContext {
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+
+    /* frame threading, only set up with AVFILTER_THREAD_FRAME */
+    AVSliceThread *frame_thread;
+    pthread_mutex_t lock;           ///< protects the scheduling state of the graph
+    pthread_mutex_t execute_lock;   ///< serializes the slice threaded jobs of concurrent filters
+    AVFilterContext **frames;
+    int *frame_rets;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
@@ -52,9 +59,21 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
         c->rets[jobnr] = ret;
 }
 
+static void frame_worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ThreadContext *c = priv;
+    c->frame_rets[jobnr] = ff_filter_activate(c->frames[jobnr]);
+}
+
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    if (c->frame_thread) {
+        avpriv_slicethread_free(&c->frame_thread);
+        pthread_mutex_destroy(&c->lock);
+        pthread_mutex_destroy(&c->execute_lock);
+    }
+    av_freep(&c->frame_rets);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -64,12 +83,72 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+    if (c->frame_thread)
+        pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    if (c->frame_thread)
+        pthread_mutex_unlock(&c->execute_lock);
+    return 0;
+}
+
+void ff_graph_lock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->internal->thread;
+
+    if (c && c->frame_thread)
+        pthread_mutex_lock(&c->lock);
+}
+
+void ff_graph_unlock(AVFilterGraph *graph)
+{
+    ThreadContext *c = graph->internal->thread;
+
+    if (c && c->frame_thread)
+        pthread_mutex_unlock(&c->lock);
+}
+
+int ff_graph_activate_frames(AVFilterGraph *graph, AVFilterContext **filters,
+                             int nb_filters)
+{
+    ThreadContext *c = graph->internal->thread;
+    int i;
+
+    c->frames = filters;
+    avpriv_slicethread_execute(c->frame_thread, nb_filters, 0);
+    for (i = 0; i < nb_filters; i++)
+        if (c->frame_rets[i] < 0)
+            return c->frame_rets[i];
+    return 0;
+}
+
+static int frame_thread_init(AVFilterGraph *graph, ThreadContext *c)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    int nb_threads;
+
+    nb_threads = avpriv_slicethread_create(&c->frame_thread, c, frame_worker_func,
+                                           NULL, graph->nb_threads);
+    if (nb_threads <= 1) {
+        avpriv_slicethread_free(&c->frame_thread);
+        return nb_threads < 0 ? nb_threads : 0;
+    }
+
+    c->frame_rets   = av_calloc(nb_threads, sizeof(*c->frame_rets));
+    gi->frame_batch = av_calloc(nb_threads, sizeof(*gi->frame_batch));
+    if (!c->frame_rets || !gi->frame_batch) {
+        avpriv_slicethread_free(&c->frame_thread);
+        av_freep(&c->frame_rets);
+        av_freep(&gi->frame_batch);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_mutex_init(&c->execute_lock, NULL);
+    gi->nb_frame_threads = nb_threads;
     return 0;
 }
 
@@ -105,6 +184,12 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_FRAME) {
+        ret = frame_thread_init(graph, graph->internal->thread);
+        if (ret < 0)
+            return ret;
+    }
+
     return 0;
 }
 
@@ -113,4 +198,6 @@ void ff_graph_thread_free(AVFilterGraph *graph)
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
+    av_freep(&graph->internal->frame_batch);
+    graph->internal->nb_frame_threads = 0;
 }
@@ -263,6 +263,7 @@ AVFilter ff_vf_setpts = {
 
     .inputs    = avfilter_vf_setpts_inputs,
     .outputs   = avfilter_vf_setpts_outputs,
+    .flags_internal = FF_FILTER_FLAG_PASSTHROUGH,
 };
 #endif /* CONFIG_SETPTS_FILTER */
 
@@ -298,5 +299,6 @@ AVFilter ff_af_asetpts = {
     .priv_class  = &asetpts_class,
     .inputs      = asetpts_inputs,
     .outputs     = asetpts_outputs,
+    .flags_internal = FF_FILTER_FLAG_PASSTHROUGH,
 };
 #endif /* CONFIG_ASETPTS_FILTER */
@@ -150,6 +150,7 @@ AVFilter ff_vf_settb = {
     .priv_class  = &settb_class,
     .inputs      = avfilter_vf_settb_inputs,
     .outputs     = avfilter_vf_settb_outputs,
+    .flags_internal = FF_FILTER_FLAG_PASSTHROUGH,
 };
 #endif /* CONFIG_SETTB_FILTER */
 
@@ -183,5 +184,6 @@ AVFilter ff_af_asettb = {
     .inputs      = avfilter_af_asettb_inputs,
     .outputs     = avfilter_af_asettb_outputs,
     .priv_class  = &asettb_class,
+    .flags_internal = FF_FILTER_FLAG_PASSTHROUGH,
 };
 #endif /* CONFIG_ASETTB_FILTER */
@@ -77,12 +77,15 @@ static av_cold void split_uninit(AVFilterContext *ctx)
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
+    int writable = ctx->internal->writable_output;
     int i, ret = AVERROR_EOF;
 
+    /* the output that needs a writable frame comes last */
     for (i = 0; i < ctx->nb_outputs; i++) {
+        int out = writable < 0 ? i : (writable + 1 + i) % ctx->nb_outputs;
         AVFrame *buf_out;
 
-        if (ff_outlink_get_status(ctx->outputs[i]))
+        if (ff_outlink_get_status(ctx->outputs[out]))
             continue;
         buf_out = av_frame_clone(frame);
         if (!buf_out) {
@@ -90,7 +93,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
             break;
         }
 
-        ret = ff_filter_frame(ctx->outputs[i], buf_out);
+        ret = ff_filter_frame(ctx->outputs[out], buf_out);
         if (ret < 0)
             break;
     }
@@ -130,6 +133,7 @@ AVFilter ff_vf_split = {
     .inputs      = avfilter_vf_split_inputs,
     .outputs     = NULL,
     .flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags_internal = FF_FILTER_FLAG_FANOUT,
 };
 
 static const AVFilterPad avfilter_af_asplit_inputs[] = {
@@ -151,4 +155,5 @@ AVFilter ff_af_asplit = {
     .inputs      = avfilter_af_asplit_inputs,
     .outputs     = NULL,
     .flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags_internal = FF_FILTER_FLAG_FANOUT,
 };
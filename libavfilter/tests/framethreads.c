@@ -0,0 +1,200 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Check that frame threading does not change the output of a graph.
+ *
+ * All the input frames are queued before the sink is drained, so that the
+ * filters of a frame threaded graph can run ahead of each other. Each graph
+ * is run once without threads and several times with frame threads, and
+ * the md5 of the output frames and timestamps must be the same.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/md5.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
+
+#undef printf
+
+#define FRAMES  100
+#define THREADS 4
+#define RUNS    3
+
+static const struct {
+    const char *desc;
+    int audio;
+} graphs[] = {
+    { "unsharp,hflip,unsharp,vflip,setpts=PTS*2,unsharp", 0 },
+    { "split[a][b];[a]negate[a1];[b]drawbox=t=fill[b1];[a1][b1]overlay=10:10,trim=end_frame=50,fps=50", 0 },
+    { "asetnsamples=n=333,volume=0.5,asetnsamples=n=1024:p=0,aresample=44100,asetnsamples=n=77", 1 },
+    { "asplit[a][b];[a]volume=2[a1];[b]aecho[b1];[a1][b1]amix,atrim=end_sample=30000", 1 },
+};
+
+static int fill_frame(AVFrame *frame, int audio, int i, int64_t *next_pts)
+{
+    int p, k, ret;
+
+    if (audio) {
+        frame->format         = AV_SAMPLE_FMT_S16;
+        frame->channel_layout = AV_CH_LAYOUT_STEREO;
+        frame->channels       = 2;
+        frame->sample_rate    = 48000;
+        frame->nb_samples     = 100 + (i * 37) % 900;
+    } else {
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width  = 64;
+        frame->height = 48;
+    }
+    frame->pts = *next_pts;
+    *next_pts += audio ? frame->nb_samples : 1;
+
+    if ((ret = av_frame_get_buffer(frame, 32)) < 0)
+        return ret;
+    for (p = 0; p < FF_ARRAY_ELEMS(frame->buf) && frame->buf[p]; p++)
+        for (k = 0; k < frame->buf[p]->size; k++)
+            frame->buf[p]->data[k] = (k * 7 + i * 13 + p) & 0xff;
+    return 0;
+}
+
+static void hash_frame(struct AVMD5 *md5, const AVFrame *frame, int audio)
+{
+    int p, y;
+
+    if (audio) {
+        int planar = av_sample_fmt_is_planar(frame->format);
+        int size   = frame->nb_samples * av_get_bytes_per_sample(frame->format) *
+                     (planar ? 1 : frame->channels);
+
+        for (p = 0; p < (planar ? frame->channels : 1); p++)
+            av_md5_update(md5, frame->extended_data[p], size);
+    } else {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+
+        for (p = 0; p < 3; p++) {
+            int w = p ? AV_CEIL_RSHIFT(frame->width,  desc->log2_chroma_w) : frame->width;
+            int h = p ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+
+            for (y = 0; y < h; y++)
+                av_md5_update(md5, frame->data[p] + y * frame->linesize[p], w);
+        }
+    }
+    av_md5_update(md5, (const uint8_t *)&frame->pts, sizeof(frame->pts));
+}
+
+static int run(const char *desc, int audio, int nb_threads,
+               uint8_t digest[16], int *nb_frames)
+{
+    AVFilterContext *src = NULL, *sink = NULL;
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    struct AVMD5 *md5 = av_md5_alloc();
+    AVFrame *frame = NULL;
+    int64_t next_pts = 0;
+    int i, ret = AVERROR(ENOMEM);
+
+    if (!graph || !md5)
+        goto end;
+    graph->nb_threads = nb_threads;
+    if (nb_threads > 1)
+        graph->thread_type = AVFILTER_THREAD_FRAME;
+
+    if ((ret = avfilter_graph_create_filter(&src, avfilter_get_by_name(audio ? "abuffer" : "buffer"), "in",
+                                            audio ? "sample_rate=48000:sample_fmt=s16:channel_layout=stereo:time_base=1/48000"
+                                                  : "video_size=64x48:pix_fmt=yuv420p:time_base=1/25",
+                                            NULL, graph)) < 0 ||
+        (ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name(audio ? "abuffersink" : "buffersink"), "out",
+                                            NULL, NULL, graph)) < 0 ||
+        (ret = avfilter_graph_parse2(graph, desc, &inputs, &outputs)) < 0 ||
+        (ret = avfilter_link(src, 0, inputs->filter_ctx, inputs->pad_idx)) < 0 ||
+        (ret = avfilter_link(outputs->filter_ctx, outputs->pad_idx, sink, 0)) < 0 ||
+        (ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    for (i = 0; i < FRAMES; i++) {
+        if (!(frame = av_frame_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = fill_frame(frame, audio, i, &next_pts)) < 0 ||
+            (ret = av_buffersrc_add_frame(src, frame)) < 0)
+            goto end;
+        av_frame_free(&frame);
+    }
+    if ((ret = av_buffersrc_add_frame(src, NULL)) < 0)
+        goto end;
+
+    if (!(frame = av_frame_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    av_md5_init(md5);
+    *nb_frames = 0;
+    while ((ret = av_buffersink_get_frame(sink, frame)) >= 0) {
+        hash_frame(md5, frame, audio);
+        av_frame_unref(frame);
+        (*nb_frames)++;
+    }
+    if (ret != AVERROR_EOF)
+        goto end;
+    av_md5_final(md5, digest);
+    ret = 0;
+end:
+    av_frame_free(&frame);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(&graph);
+    av_free(md5);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t ref[16], digest[16];
+    int i, j, nb_ref, nb_frames, ret = 0;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(graphs); i++) {
+        printf("%s\n", graphs[i].desc);
+        if (run(graphs[i].desc, graphs[i].audio, 1, ref, &nb_ref) < 0) {
+            fprintf(stderr, "failed to run %s\n", graphs[i].desc);
+            return 1;
+        }
+        printf("  %d frames\n", nb_ref);
+        for (j = 0; j < RUNS; j++) {
+            if (run(graphs[i].desc, graphs[i].audio, THREADS, digest, &nb_frames) < 0) {
+                fprintf(stderr, "failed to run %s with frame threads\n", graphs[i].desc);
+                return 1;
+            }
+            if (nb_frames != nb_ref || memcmp(ref, digest, sizeof(ref))) {
+                printf("  run %d with %d frame threads: %d frames, output differs\n",
+                       j, THREADS, nb_frames);
+                ret = 1;
+            }
+        }
+    }
+    return ret;
+}
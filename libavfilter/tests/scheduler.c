@@ -0,0 +1,224 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Filter graph scheduling benchmark.
+ *
+ * Pushes tiny frames through graphs of 10 to 1000 filters that do nothing,
+ * so that the time per frame is mostly spent picking the next filter to
+ * activate. Two shapes are timed: a chain of null filters, where few filters
+ * are ready at once, and a split into as many null branches, each ending in
+ * its own sink, where most of them are.
+ *
+ * Then frame threading is timed on a chain of unsharp filters with 1 to 8
+ * threads. All the frames are queued before the first one is taken from the
+ * sink, so that each filter of the chain can work on its own frame.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+#include "libavutil/time.h"
+
+#undef printf
+
+#define FRAMES         100
+#define THREAD_FRAMES  50
+#define THREAD_FILTERS 16
+
+static int link_filter(AVFilterGraph *graph, AVFilterContext **prev, int pad,
+                       const char *name, const char *args, AVFilterContext **ret)
+{
+    int err = avfilter_graph_create_filter(ret, avfilter_get_by_name(name),
+                                           NULL, args, NULL, graph);
+    if (err >= 0 && *prev)
+        err = avfilter_link(*prev, pad, *ret, 0);
+    return err;
+}
+
+static AVFilterGraph *build_graph(AVFilterGraph *graph, const char *src_args,
+                                  const char *name, const char *args,
+                                  int nb_filters, int fanout, AVFilterContext **src,
+                                  AVFilterContext ***sinks, int *nb_sinks)
+{
+    AVFilterContext *prev = NULL, *f, *split;
+    char split_args[32];
+    int i;
+
+    *nb_sinks = fanout ? nb_filters : 1;
+    *sinks    = av_calloc(*nb_sinks, sizeof(**sinks));
+    if (!graph || !*sinks)
+        goto fail;
+
+    if (link_filter(graph, &prev, 0, "buffer", src_args, src) < 0)
+        goto fail;
+    prev = *src;
+
+    if (fanout) {
+        snprintf(split_args, sizeof(split_args), "%d", nb_filters);
+        if (link_filter(graph, &prev, 0, "split", split_args, &split) < 0)
+            goto fail;
+        for (i = 0; i < nb_filters; i++) {
+            prev = split;
+            if (link_filter(graph, &prev, i, name, args, &f) < 0 ||
+                link_filter(graph, &f, 0, "buffersink", NULL, &(*sinks)[i]) < 0)
+                goto fail;
+        }
+    } else {
+        for (i = 0; i < nb_filters; i++) {
+            if (link_filter(graph, &prev, 0, name, args, &f) < 0)
+                goto fail;
+            prev = f;
+        }
+        if (link_filter(graph, &prev, 0, "buffersink", NULL, &(*sinks)[0]) < 0)
+            goto fail;
+    }
+
+    if (avfilter_graph_config(graph, NULL) < 0)
+        goto fail;
+    return graph;
+fail:
+    av_freep(sinks);
+    avfilter_graph_free(&graph);
+    return NULL;
+}
+
+static int run(int nb_filters, int fanout, AVFrame *frame, AVFrame *out)
+{
+    AVFilterContext *src, **sinks;
+    AVFilterGraph *graph;
+    int64_t t;
+    int i, j, nb_sinks, ret = AVERROR(ENOMEM);
+
+    graph = build_graph(avfilter_graph_alloc(),
+                        "video_size=16x16:pix_fmt=gray:time_base=1/25", "null", NULL,
+                        nb_filters, fanout, &src, &sinks, &nb_sinks);
+    if (!graph)
+        return ret;
+
+    t = av_gettime_relative();
+    for (i = 0; i < FRAMES; i++) {
+        frame->pts = i;
+        if ((ret = av_buffersrc_add_frame_flags(src, frame, AV_BUFFERSRC_FLAG_KEEP_REF)) < 0)
+            goto end;
+        for (j = 0; j < nb_sinks; j++) {
+            if ((ret = av_buffersink_get_frame(sinks[j], out)) < 0)
+                goto end;
+            av_frame_unref(out);
+        }
+    }
+    t = av_gettime_relative() - t;
+
+    printf("%-6s %4d filters: %9.2f us per frame\n", fanout ? "split" : "chain",
+           nb_filters, t / (double)FRAMES);
+    ret = 0;
+end:
+    av_freep(&sinks);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+static int run_threads(int nb_threads, AVFrame *frame, AVFrame *out, int64_t *t1)
+{
+    AVFilterContext *src, **sinks;
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    int64_t t;
+    int i, nb_sinks, ret = AVERROR(ENOMEM);
+
+    if (!graph)
+        return ret;
+    graph->thread_type = AVFILTER_THREAD_FRAME;
+    graph->nb_threads  = nb_threads;
+    graph = build_graph(graph, "video_size=320x240:pix_fmt=yuv420p:time_base=1/25",
+                        "unsharp", NULL, THREAD_FILTERS, 0, &src, &sinks, &nb_sinks);
+    if (!graph)
+        return ret;
+
+    t = av_gettime_relative();
+    for (i = 0; i < THREAD_FRAMES; i++) {
+        frame->pts = i;
+        if ((ret = av_buffersrc_add_frame_flags(src, frame, AV_BUFFERSRC_FLAG_KEEP_REF)) < 0)
+            goto end;
+    }
+    for (i = 0; i < THREAD_FRAMES; i++) {
+        if ((ret = av_buffersink_get_frame(sinks[0], out)) < 0)
+            goto end;
+        av_frame_unref(out);
+    }
+    t = av_gettime_relative() - t;
+    if (nb_threads == 1)
+        *t1 = t;
+
+    printf("frame threads %d, %d unsharp: %9.2f ms per frame, %.2fx\n",
+           nb_threads, THREAD_FILTERS, t / (1000.0 * THREAD_FRAMES), *t1 / (double)t);
+    ret = 0;
+end:
+    av_freep(&sinks);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const int sizes[] = { 10, 30, 100, 300, 1000 };
+    AVFrame *frame = av_frame_alloc();
+    AVFrame *out   = av_frame_alloc();
+    int64_t t1 = 1;
+    int i, fanout, ret = 1;
+
+    if (!frame || !out)
+        goto end;
+    frame->width  = 16;
+    frame->height = 16;
+    frame->format = AV_PIX_FMT_GRAY8;
+    if (av_frame_get_buffer(frame, 32) < 0)
+        goto end;
+    av_log_set_level(AV_LOG_WARNING);
+
+    for (fanout = 0; fanout <= 1; fanout++)
+        for (i = 0; i < FF_ARRAY_ELEMS(sizes); i++)
+            if (run(sizes[i], fanout, frame, out) < 0) {
+                fprintf(stderr, "failed with %d filters\n", sizes[i]);
+                goto end;
+            }
+
+    av_frame_free(&frame);
+    if (!(frame = av_frame_alloc()))
+        goto end;
+    frame->width  = 320;
+    frame->height = 240;
+    frame->format = AV_PIX_FMT_YUV420P;
+    if (av_frame_get_buffer(frame, 32) < 0)
+        goto end;
+    for (i = 1; i <= 8; i *= 2)
+        if (run_threads(i, frame, out, &t1) < 0) {
+            fprintf(stderr, "failed with %d frame threads\n", i);
+            goto end;
+        }
+    ret = 0;
+end:
+    av_frame_free(&frame);
+    av_frame_free(&out);
+    return ret;
+}
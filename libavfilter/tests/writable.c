@@ -0,0 +1,133 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Count the frames copied to make them writable behind a split.
+ *
+ * Each graph splits its input in three. One branch ends in drawbox, which
+ * writes to its frames, possibly behind filters that pass them through
+ * unchanged; the others only read them. After every input frame, one frame
+ * is taken from each sink, read-only branches first, and the number of
+ * frames copied on the input of each writer is printed at the end.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavfilter/internal.h"
+#include "libavutil/common.h"
+#include "libavutil/frame.h"
+
+#undef printf
+
+#define FRAMES 10
+
+static const char *const graphs[] = {
+    "split=3[a][b][c];[a]drawbox=t=fill[w];[b]scale=16:16[b1];[c]scale=16:16[c1]",
+    "split=3[a][b][c];[a]null,setpts=PTS+1,drawbox=t=fill[w];[b]scale=16:16[b1];[c]scale=16:16[c1]",
+    "split=3[a][b][c];[a]null,drawbox=t=fill[w];[b]drawbox=t=fill[w2];[c]scale=16:16[c1]",
+};
+
+static int run(const char *desc)
+{
+    static const char *const sink_names[] = { "w", "w2", "b1", "c1" };
+    AVFilterContext *src = NULL, *sinks[FF_ARRAY_ELEMS(sink_names)];
+    AVFilterInOut *inputs = NULL, *outputs = NULL, *io;
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFrame *frame = NULL;
+    int i, j, nb_sinks = 0, ret = AVERROR(ENOMEM);
+
+    if (!graph)
+        goto end;
+    graph->nb_threads = 1;
+
+    if ((ret = avfilter_graph_create_filter(&src, avfilter_get_by_name("buffer"), "in",
+                                            "video_size=32x32:pix_fmt=yuv420p:time_base=1/25",
+                                            NULL, graph)) < 0 ||
+        (ret = avfilter_graph_parse2(graph, desc, &inputs, &outputs)) < 0 ||
+        (ret = avfilter_link(src, 0, inputs->filter_ctx, inputs->pad_idx)) < 0)
+        goto end;
+    for (i = 0; i < FF_ARRAY_ELEMS(sink_names); i++) {
+        for (io = outputs; io; io = io->next)
+            if (!strcmp(io->name, sink_names[i]))
+                break;
+        if (!io)
+            continue;
+        if ((ret = avfilter_graph_create_filter(&sinks[nb_sinks], avfilter_get_by_name("buffersink"),
+                                                io->name, NULL, NULL, graph)) < 0 ||
+            (ret = avfilter_link(io->filter_ctx, io->pad_idx, sinks[nb_sinks], 0)) < 0)
+            goto end;
+        nb_sinks++;
+    }
+    if ((ret = avfilter_graph_config(graph, NULL)) < 0)
+        goto end;
+
+    for (i = 0; i < FRAMES; i++) {
+        if (!(frame = av_frame_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        frame->width  = 32;
+        frame->height = 32;
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->pts    = i;
+        if ((ret = av_frame_get_buffer(frame, 32)) < 0 ||
+            (ret = av_buffersrc_add_frame_flags(src, frame, AV_BUFFERSRC_FLAG_PUSH)) < 0)
+            goto end;
+        for (j = 0; j < nb_sinks; j++) {
+            if ((ret = av_buffersink_get_frame(sinks[j], frame)) < 0)
+                goto end;
+            av_frame_unref(frame);
+        }
+        av_frame_free(&frame);
+    }
+
+    printf("%s\n", desc);
+    for (i = 0; i < graph->nb_filters; i++) {
+        const AVFilterContext *f = graph->filters[i];
+        for (j = 0; j < f->nb_inputs; j++)
+            if (f->inputs[j]->dstpad->needs_writable)
+                printf("  %s: %"PRId64" of %"PRId64" frames copied, %"PRId64" queued at most\n",
+                       f->name, f->inputs[j]->frame_copies, f->inputs[j]->frame_count_out,
+                       f->inputs[j]->max_queued);
+    }
+    ret = 0;
+end:
+    av_frame_free(&frame);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(graphs); i++)
+        if (run(graphs[i]) < 0) {
+            fprintf(stderr, "failed to run %s\n", graphs[i]);
+            return 1;
+        }
+    return 0;
+}
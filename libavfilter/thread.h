@@ -25,4 +25,24 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Lock the scheduling state of the graph, i.e. the ready fields of its
+ * filters, the ready and sink heaps, and the FIFOs and activation fields of
+ * its links, against concurrent frame threads. Not recursive, and never held
+ * while calling into a filter. Does nothing when frame threading is not in
+ * use.
+ */
+void ff_graph_lock(AVFilterGraph *graph);
+
+void ff_graph_unlock(AVFilterGraph *graph);
+
+/**
+ * Activate filters concurrently on the frame threads of the graph and wait
+ * for all of them.
+ *
+ * @return 0, or the first error returned by ff_filter_activate()
+ */
+int ff_graph_activate_frames(AVFilterGraph *graph, AVFilterContext **filters,
+                             int nb_filters);
+
 #endif /* AVFILTER_THREAD_H */
@@ -0,0 +1,314 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale video to several sizes at once
+ *
+ * Each output is scaled either from the input or, when cascading is
+ * enabled, from the smallest larger output that is at least twice its size
+ * in both dimensions, so that the full size input is read as few times as
+ * possible.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct LadderRung {
+    int w, h;
+    int src;                    ///< index of the rung this one is scaled from, -1 for the input
+    struct SwsContext *sws;
+} LadderRung;
+
+typedef struct ScaleLadderContext {
+    const AVClass *class;
+    char *sizes_str;
+    char *flags_str;
+    int cascade;
+
+    int flags;
+    LadderRung *rungs;
+    int nb_rungs;
+    int *order;                 ///< rung indices by decreasing area, the order they are scaled in
+} ScaleLadderContext;
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ScaleLadderContext *s = ctx->priv;
+    LadderRung *rung = &s->rungs[FF_OUTLINK_IDX(outlink)];
+    int i, src_w = inlink->w, src_h = inlink->h, ret;
+
+    /* the smallest larger rung that is not an upscale of the input itself */
+    rung->src = -1;
+    for (i = 0; s->cascade && i < s->nb_rungs; i++) {
+        const LadderRung *r = &s->rungs[i];
+
+        if (r->w >= 2 * rung->w && r->h >= 2 * rung->h &&
+            r->w <= inlink->w && r->h <= inlink->h &&
+            (int64_t)r->w * r->h < (int64_t)src_w * src_h) {
+            rung->src = i;
+            src_w     = r->w;
+            src_h     = r->h;
+        }
+    }
+
+    outlink->w = rung->w;
+    outlink->h = rung->h;
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    sws_freeContext(rung->sws);
+    rung->sws = sws_alloc_context();
+    if (!rung->sws)
+        return AVERROR(ENOMEM);
+
+    av_opt_set_int(rung->sws, "srcw",       src_w,            0);
+    av_opt_set_int(rung->sws, "srch",       src_h,            0);
+    av_opt_set_int(rung->sws, "src_format", inlink->format,   0);
+    av_opt_set_int(rung->sws, "dstw",       outlink->w,       0);
+    av_opt_set_int(rung->sws, "dsth",       outlink->h,       0);
+    av_opt_set_int(rung->sws, "dst_format", outlink->format,  0);
+    av_opt_set_int(rung->sws, "sws_flags",  s->flags,         0);
+    if (ctx->graph->thread_type & AVFILTER_THREAD_SLICE)
+        av_opt_set_int(rung->sws, "threads", ff_filter_get_nb_threads(ctx), 0);
+    /* MPEG-2 chroma positions, as the scale filter uses */
+    if (inlink->format == AV_PIX_FMT_YUV420P) {
+        av_opt_set_int(rung->sws, "src_v_chr_pos", 128, 0);
+        av_opt_set_int(rung->sws, "dst_v_chr_pos", 128, 0);
+    }
+    if ((ret = sws_init_context(rung->sws, NULL, NULL)) < 0)
+        return ret;
+
+    av_log(ctx, AV_LOG_VERBOSE, "output%d: %dx%d from %s %dx%d fmt:%s\n",
+           FF_OUTLINK_IDX(outlink), outlink->w, outlink->h,
+           rung->src < 0 ? "input" : "output", src_w, src_h,
+           av_get_pix_fmt_name(outlink->format));
+    return 0;
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+    const char *p = s->sizes_str;
+    int i, j, ret;
+
+    if (!p || !*p) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified.\n");
+        return AVERROR(EINVAL);
+    }
+
+    while (*p) {
+        char *size = av_get_token(&p, "|");
+        LadderRung *rung;
+
+        if (!size)
+            return AVERROR(ENOMEM);
+        if (*p)
+            p++;
+
+        if ((ret = av_reallocp_array(&s->rungs, s->nb_rungs + 1, sizeof(*s->rungs))) < 0) {
+            s->nb_rungs = 0;
+            av_free(size);
+            return ret;
+        }
+        rung = &s->rungs[s->nb_rungs];
+        memset(rung, 0, sizeof(*rung));
+        ret = av_parse_video_size(&rung->w, &rung->h, size);
+        if (ret < 0)
+            av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'.\n", size);
+        av_free(size);
+        if (ret < 0)
+            return ret;
+        s->nb_rungs++;
+    }
+
+    s->order = av_malloc_array(s->nb_rungs, sizeof(*s->order));
+    if (!s->order)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_rungs; i++) {
+        int64_t area = (int64_t)s->rungs[i].w * s->rungs[i].h;
+
+        for (j = i; j > 0 && (int64_t)s->rungs[s->order[j - 1]].w *
+                                      s->rungs[s->order[j - 1]].h < area; j--)
+            s->order[j] = s->order[j - 1];
+        s->order[j] = i;
+    }
+
+    for (i = 0; i < s->nb_rungs; i++) {
+        AVFilterPad pad = { 0 };
+        char name[32];
+
+        snprintf(name, sizeof(name), "output%d", i);
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_strdup(name);
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+        if ((ret = ff_insert_outpad(ctx, i, &pad)) < 0) {
+            av_freep(&pad.name);
+            return ret;
+        }
+    }
+
+    if (s->flags_str) {
+        const AVClass *class = sws_get_class();
+        const AVOption    *o = av_opt_find(&class, "sws_flags", NULL, 0,
+                                           AV_OPT_SEARCH_FAKE_OBJ);
+        if ((ret = av_opt_eval_flags(&class, o, s->flags_str, &s->flags)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    ScaleLadderContext *s = ctx->priv;
+    int i;
+
+    for (i = 0; i < s->nb_rungs; i++)
+        sws_freeContext(s->rungs[i].sws);
+    av_freep(&s->rungs);
+    av_freep(&s->order);
+    for (i = 0; i < ctx->nb_outputs; i++)
+        av_freep(&ctx->output_pads[i].name);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    AVFilterFormats *formats = NULL;
+    const AVPixFmtDescriptor *desc = NULL;
+    int ret;
+
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if (sws_isSupportedInput(pix_fmt) && sws_isSupportedOutput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+    return ff_set_common_formats(ctx, formats);
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+{
+    AVFilterContext *ctx = inlink->dst;
+    ScaleLadderContext *s = ctx->priv;
+    AVFrame **out;
+    int i, ret = AVERROR_EOF;
+
+    out = av_mallocz_array(s->nb_rungs, sizeof(*out));
+    if (!out) {
+        av_frame_free(&in);
+        return AVERROR(ENOMEM);
+    }
+
+    /* larger rungs first, as smaller ones may be scaled from them */
+    for (i = 0; i < s->nb_rungs; i++) {
+        int k = s->order[i];
+        AVFilterLink *outlink = ctx->outputs[k];
+        const AVFrame *src = s->rungs[k].src < 0 ? in : out[s->rungs[k].src];
+
+        out[k] = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out[k]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        av_frame_copy_props(out[k], in);
+        out[k]->width  = outlink->w;
+        out[k]->height = outlink->h;
+        out[k]->sample_aspect_ratio = outlink->sample_aspect_ratio;
+
+        sws_scale(s->rungs[k].sws, (const uint8_t * const *)src->data,
+                  src->linesize, 0, src->height, out[k]->data, out[k]->linesize);
+    }
+    av_frame_free(&in);
+
+    ret = AVERROR_EOF;
+    for (i = 0; i < s->nb_rungs; i++) {
+        if (ff_outlink_get_status(ctx->outputs[i])) {
+            av_frame_free(&out[i]);
+            continue;
+        }
+        ret = ff_filter_frame(ctx->outputs[i], out[i]);
+        out[i] = NULL;
+        if (ret < 0)
+            break;
+    }
+
+end:
+    av_frame_free(&in);
+    for (i = 0; i < s->nb_rungs; i++)
+        av_frame_free(&out[i]);
+    av_free(out);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(ScaleLadderContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption scale_ladder_options[] = {
+    { "sizes",   "set the '|'-separated output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL },       .flags = FLAGS },
+    { "flags",   "Flags to pass to libswscale",        OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "bilinear" }, .flags = FLAGS },
+    { "cascade", "scale smaller outputs from larger ones", OFFSET(cascade), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(scale_ladder);
+
+static const AVFilterPad scale_ladder_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .filter_frame = filter_frame,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_scale_ladder = {
+    .name          = "scale_ladder",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes."),
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .priv_size     = sizeof(ScaleLadderContext),
+    .priv_class    = &scale_ladder_class,
+    .inputs        = scale_ladder_inputs,
+    .outputs       = NULL,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
@@ -31,6 +31,7 @@
 
 #include "avfilter.h"
 #include "internal.h"
+#include "thread.h"
 #include "video.h"
 
 #define BUFFER_ALIGN 32
@@ -43,6 +44,7 @@ AVFrame *ff_null_get_video_buffer(AVFilterLink *link, int w, int h)
 
 AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
 {
+    FFFramePoolRegistry *pools = link->src->graph->internal->frame_pools;
     AVFrame *frame = NULL;
     int pool_width = 0;
     int pool_height = 0;
@@ -64,30 +66,35 @@ AVFrame *ff_default_get_video_buffer(AVFilterLink *link, int w, int h)
         return frame;
     }
 
+    /* The pool may also be used by the filter before, which can run at the
+       same time with frame threading. */
+    ff_graph_lock(link->src->graph);
     if (!link->frame_pool) {
-        link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                    link->format, BUFFER_ALIGN);
+        link->frame_pool = ff_frame_pool_registry_get_video(pools, av_buffer_allocz, w, h,
+                                                            link->format, BUFFER_ALIGN);
         if (!link->frame_pool)
-            return NULL;
+            goto end;
     } else {
         if (ff_frame_pool_get_video_config(link->frame_pool,
                                            &pool_width, &pool_height,
                                            &pool_format, &pool_align) < 0) {
-            return NULL;
+            goto end;
         }
 
         if (pool_width != w || pool_height != h ||
             pool_format != link->format || pool_align != BUFFER_ALIGN) {
 
             ff_frame_pool_uninit((FFFramePool **)&link->frame_pool);
-            link->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
-                                                        link->format, BUFFER_ALIGN);
+            link->frame_pool = ff_frame_pool_registry_get_video(pools, av_buffer_allocz, w, h,
+                                                                link->format, BUFFER_ALIGN);
             if (!link->frame_pool)
-                return NULL;
+                goto end;
         }
     }
 
     frame = ff_frame_pool_get(link->frame_pool);
+end:
+    ff_graph_unlock(link->src->graph);
     if (!frame)
         return NULL;
 
@@ -101,6 +101,8 @@ extern AVOutputFormat ff_codec2_muxer;
 extern AVInputFormat  ff_codec2raw_demuxer;
 extern AVOutputFormat ff_codec2raw_muxer;
 extern AVInputFormat  ff_concat_demuxer;
+extern AVInputFormat  ff_coolseq_demuxer;
+extern AVOutputFormat ff_coolseq_muxer;
 extern AVOutputFormat ff_crc_muxer;
 extern AVInputFormat  ff_dash_demuxer;
 extern AVOutputFormat ff_dash_muxer;
@@ -1944,6 +1944,24 @@ typedef struct AVFormatContext {
      * - decoding: set by user
      */
     int skip_estimate_duration_from_pts;
+
+    /**
+     * Directory in which the stream parameters and, for some demuxers, the
+     * index of seekable inputs are cached, so that opening the same input
+     * again does not need to probe and parse them.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *index_cache;
+
+    /**
+     * Number of threads used to decode the packets of different streams
+     * in avformat_find_stream_info(). 0 decodes them serially, while
+     * reading.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_threads;
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
@@ -57,6 +57,8 @@ static const AVOption options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  CHAR_MIN, CHAR_MAX, D },
     {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  CHAR_MIN, CHAR_MAX, D },
     {"rw_timeout", "Timeout for IO operations (in microseconds)", offsetof(URLContext, rw_timeout), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_DECODING_PARAM },
+    {"prefetch_window", "Number of bytes to read ahead in the background", OFFSET(prefetch_window), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    {"prefetch_requests", "Maximum number of background reads in flight", OFFSET(prefetch_requests), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, D },
     { NULL }
 };
 
@@ -97,6 +99,7 @@ static int url_alloc_for_protocol(URLContext **puc, const URLProtocol *up,
         goto fail;
     }
     uc->av_class = &ffurl_context_class;
+    av_opt_set_defaults(uc);
     uc->filename = (char *)&uc[1];
     strcpy(uc->filename, filename);
     uc->prot            = up;
@@ -140,6 +140,18 @@ int ffio_fdopen(AVIOContext **s, URLContext *h);
  */
 URLContext *ffio_geturlcontext(AVIOContext *s);
 
+/**
+ * Get a reference to the next size bytes of s without copying them, and
+ * skip over them, if the underlying protocol keeps the data in memory.
+ *
+ * @param buf set to a read-only reference on success, followed by
+ *            AV_INPUT_BUFFER_PADDING_SIZE zero bytes
+ * @return size on success, AVERROR(ENOSYS) if the data cannot be
+ *         referenced, in which case s is left untouched, or another
+ *         negative error code
+ */
+int ffio_read_mapped(AVIOContext *s, int size, AVBufferRef **buf);
+
 /**
  * Open a write-only fake memory stream. The written data is not stored
  * anywhere - this is only used for measuring the amount of data
@@ -30,6 +30,7 @@
 #include "avio.h"
 #include "avio_internal.h"
 #include "internal.h"
+#include "prefetch.h"
 #include "url.h"
 #include <stdarg.h>
 
@@ -44,13 +45,22 @@
 
 typedef struct AVIOInternal {
     URLContext *h;
+    FFPrefetch *prefetch;
 } AVIOInternal;
 
+/* The URLContext, unless the prefetch thread is reading through it. */
+static URLContext *io_urlcontext(AVIOInternal *internal)
+{
+    if (internal->prefetch && ff_prefetch_owns_url(internal->prefetch))
+        return NULL;
+    return internal->h;
+}
+
 static void *ff_avio_child_next(void *obj, void *prev)
 {
     AVIOContext *s = obj;
     AVIOInternal *internal = s->opaque;
-    return prev ? NULL : internal->h;
+    return prev ? NULL : io_urlcontext(internal);
 }
 
 static const AVClass *ff_avio_child_class_next(const AVClass *prev)
@@ -941,6 +951,8 @@ uint64_t ffio_read_varlen(AVIOContext *bc){
 static int io_read_packet(void *opaque, uint8_t *buf, int buf_size)
 {
     AVIOInternal *internal = opaque;
+    if (internal->prefetch)
+        return ff_prefetch_read(internal->prefetch, buf, buf_size);
     return ffurl_read(internal->h, buf, buf_size);
 }
 
@@ -953,13 +965,14 @@ static int io_write_packet(void *opaque, uint8_t *buf, int buf_size)
 static int64_t io_seek(void *opaque, int64_t offset, int whence)
 {
     AVIOInternal *internal = opaque;
+    if (internal->prefetch)
+        return ff_prefetch_seek(internal->prefetch, offset, whence);
     return ffurl_seek(internal->h, offset, whence);
 }
 
 static int io_short_seek(void *opaque)
 {
-    AVIOInternal *internal = opaque;
-    return ffurl_get_short_seek(internal->h);
+    return ffurl_get_short_seek(io_urlcontext(opaque));
 }
 
 static int io_read_pause(void *opaque, int pause)
@@ -1044,11 +1057,34 @@ URLContext* ffio_geturlcontext(AVIOContext *s)
 
     internal = s->opaque;
     if (internal && s->read_packet == io_read_packet)
-        return internal->h;
+        return io_urlcontext(internal);
     else
         return NULL;
 }
 
+int ffio_read_mapped(AVIOContext *s, int size, AVBufferRef **buf)
+{
+    URLContext *h = ffio_geturlcontext(s);
+    int64_t pos   = avio_tell(s);
+    int64_t ret;
+
+    /* the prefetch threads may be using h */
+    if (!h || ((AVIOInternal *)s->opaque)->prefetch ||
+        !h->prot->url_get_mapped_buffer || s->write_flag ||
+        s->update_checksum || pos < 0 || size <= 0)
+        return AVERROR(ENOSYS);
+    if ((ret = h->prot->url_get_mapped_buffer(h, pos, size, buf)) < 0)
+        return ret;
+
+    if (size <= s->buf_end - s->buf_ptr) {
+        s->buf_ptr += size;
+    } else if ((ret = avio_seek(s, pos + size, SEEK_SET)) != pos + size) {
+        av_buffer_unref(buf);
+        return ret < 0 ? ret : AVERROR(EIO);
+    }
+    return size;
+}
+
 int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size)
 {
     uint8_t *buffer;
@@ -1162,17 +1198,37 @@ int ffio_open_whitelist(AVIOContext **s, const char *filename, int flags,
                         )
 {
     URLContext *h;
+    AVIOInternal *internal;
+    AVDictionary *opts = NULL;
     int err;
 
+    /* keep the options for the connections the prefetcher opens */
+    if (options && (err = av_dict_copy(&opts, *options, 0)) < 0)
+        return err;
     err = ffurl_open_whitelist(&h, filename, flags, int_cb, options, whitelist, blacklist, NULL);
     if (err < 0)
-        return err;
+        goto end;
     err = ffio_fdopen(s, h);
     if (err < 0) {
         ffurl_close(h);
-        return err;
+        goto end;
     }
-    return 0;
+
+    internal = (*s)->opaque;
+    if (h->prefetch_window > 0) {
+        err = ff_prefetch_init(&internal->prefetch, h, opts);
+        if (err == AVERROR(ENOSYS)) {
+            av_log(h, AV_LOG_WARNING, "Prefetching is not supported here, reading synchronously\n");
+        } else if (err < 0) {
+            avio_closep(s);
+            goto end;
+        }
+        err = 0;
+    }
+
+end:
+    av_dict_free(&opts);
+    return err;
 }
 
 int avio_open2(AVIOContext **s, const char *filename, int flags,
@@ -1199,6 +1255,7 @@ int avio_close(AVIOContext *s)
     internal = s->opaque;
     h        = internal->h;
 
+    ff_prefetch_free(&internal->prefetch);
     av_freep(&s->opaque);
     av_freep(&s->buffer);
     if (s->write_flag)
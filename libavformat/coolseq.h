@@ -0,0 +1,44 @@
+/*
+ * COOL image sequence common definitions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_COOLSEQ_H
+#define AVFORMAT_COOLSEQ_H
+
+/*
+ * A COOL sequence stores any number of COOL images back to back:
+ *
+ * header:  "CSEQ", le16 version, le16 header size, le32 time base numerator,
+ *          le32 time base denominator, le32 width, le32 height,
+ *          le64 index offset, le32 frame count
+ * frames:  le32 payload size, le64 pts, payload
+ * end:     le32 0
+ * index:   le64 pts, le64 frame offset, le32 payload size, for every frame
+ *
+ * The index offset and frame count are zero when the file could not be
+ * rewritten once complete; the frames can still be read sequentially.
+ */
+#define COOLSEQ_TAG              MKTAG('C', 'S', 'E', 'Q')
+#define COOLSEQ_VERSION          1
+#define COOLSEQ_HEADER_SIZE      36
+#define COOLSEQ_INDEX_POS        24      ///< where the index offset is in the header
+#define COOLSEQ_FRAME_HEADER     12
+#define COOLSEQ_INDEX_ENTRY_SIZE 20
+
+#endif /* AVFORMAT_COOLSEQ_H */
@@ -0,0 +1,159 @@
+/*
+ * COOL image sequence demuxer
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/intreadwrite.h"
+#include "avformat.h"
+#include "coolseq.h"
+#include "internal.h"
+
+typedef struct CoolSeqDemuxContext {
+    int64_t index_pos;
+} CoolSeqDemuxContext;
+
+static int coolseq_probe(AVProbeData *p)
+{
+    if (AV_RL32(p->buf) == COOLSEQ_TAG &&
+        AV_RL16(p->buf + 4) == COOLSEQ_VERSION &&
+        AV_RL16(p->buf + 6) >= COOLSEQ_HEADER_SIZE)
+        return AVPROBE_SCORE_MAX;
+    return 0;
+}
+
+static int coolseq_read_index(AVFormatContext *s, AVStream *st,
+                              int64_t index_pos, unsigned nb_frames)
+{
+    AVIOContext *pb = s->pb;
+    int64_t data_pos = avio_tell(pb), first_pts = AV_NOPTS_VALUE, pts = 0;
+    unsigned i;
+
+    if (avio_seek(pb, index_pos, SEEK_SET) < 0)
+        return 0;
+
+    for (i = 0; i < nb_frames && !avio_feof(pb); i++) {
+        int64_t pos;
+        int size;
+
+        pts  = avio_rl64(pb);
+        pos  = avio_rl64(pb);
+        size = avio_rl32(pb);
+        if (pos < data_pos || pos >= index_pos || size <= 0) {
+            av_log(s, AV_LOG_WARNING, "Invalid index entry %u, ignoring the rest\n", i);
+            break;
+        }
+        if (first_pts == AV_NOPTS_VALUE)
+            first_pts = pts;
+        av_add_index_entry(st, pos, pts, size, 0, AVINDEX_KEYFRAME);
+    }
+
+    if (i) {
+        st->nb_frames  = i;
+        st->start_time = first_pts;
+        st->duration   = pts - first_pts + (i > 1 ? (pts - first_pts) / (i - 1) : 1);
+    }
+
+    return avio_seek(pb, data_pos, SEEK_SET) < 0 ? AVERROR(EIO) : 0;
+}
+
+static int coolseq_read_header(AVFormatContext *s)
+{
+    CoolSeqDemuxContext *c = s->priv_data;
+    AVIOContext *pb = s->pb;
+    AVStream *st;
+    AVRational time_base;
+    unsigned header_size, nb_frames;
+
+    avio_skip(pb, 6);                   // tag, version
+    header_size    = avio_rl16(pb);
+    time_base.num  = avio_rl32(pb);
+    time_base.den  = avio_rl32(pb);
+
+    st = avformat_new_stream(s, NULL);
+    if (!st)
+        return AVERROR(ENOMEM);
+
+    st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    st->codecpar->codec_id   = AV_CODEC_ID_COOL;
+    st->codecpar->format     = AV_PIX_FMT_RGB8;
+    st->codecpar->width      = avio_rl32(pb);
+    st->codecpar->height     = avio_rl32(pb);
+    c->index_pos             = avio_rl64(pb);
+    nb_frames                = avio_rl32(pb);
+
+    if (header_size < COOLSEQ_HEADER_SIZE) {
+        av_log(s, AV_LOG_ERROR, "Invalid header size %u\n", header_size);
+        return AVERROR_INVALIDDATA;
+    }
+    if (time_base.num <= 0 || time_base.den <= 0) {
+        av_log(s, AV_LOG_ERROR, "Invalid time base %d/%d\n",
+               time_base.num, time_base.den);
+        return AVERROR_INVALIDDATA;
+    }
+    avpriv_set_pts_info(st, 64, time_base.num, time_base.den);
+
+    avio_skip(pb, header_size - COOLSEQ_HEADER_SIZE);
+    if (avio_feof(pb))
+        return AVERROR_INVALIDDATA;
+
+    if (c->index_pos > avio_tell(pb) && nb_frames &&
+        (pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return coolseq_read_index(s, st, c->index_pos, nb_frames);
+
+    return 0;
+}
+
+static int coolseq_read_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    CoolSeqDemuxContext *c = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t pos = avio_tell(pb), pts;
+    int size, ret;
+
+    if (c->index_pos > 0 && pos >= c->index_pos)
+        return AVERROR_EOF;
+
+    size = avio_rl32(pb);
+    pts  = avio_rl64(pb);
+    if (avio_feof(pb) || !size)
+        return AVERROR_EOF;
+    if (size < 0)
+        return AVERROR_INVALIDDATA;
+
+    ret = av_get_packet(pb, pkt, size);
+    if (ret < 0)
+        return ret;
+    pkt->stream_index = 0;
+    pkt->pts          = pts;
+    pkt->dts          = pts;
+    pkt->pos          = pos;
+    pkt->flags       |= AV_PKT_FLAG_KEY;
+
+    return 0;
+}
+
+AVInputFormat ff_coolseq_demuxer = {
+    .name           = "coolseq",
+    .long_name      = NULL_IF_CONFIG_SMALL("COOL image sequence"),
+    .priv_data_size = sizeof(CoolSeqDemuxContext),
+    .read_probe     = coolseq_probe,
+    .read_header    = coolseq_read_header,
+    .read_packet    = coolseq_read_packet,
+    .extensions     = "cools",
+    .flags          = AVFMT_GENERIC_INDEX,
+};
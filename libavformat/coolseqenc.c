@@ -0,0 +1,137 @@
+/*
+ * COOL image sequence muxer
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "avformat.h"
+#include "coolseq.h"
+#include "internal.h"
+
+typedef struct CoolSeqIndexEntry {
+    int64_t pts;
+    int64_t pos;
+    int size;
+} CoolSeqIndexEntry;
+
+typedef struct CoolSeqMuxContext {
+    CoolSeqIndexEntry *index;
+    unsigned nb_frames;
+    unsigned index_alloc;
+} CoolSeqMuxContext;
+
+static int coolseq_write_header(AVFormatContext *s)
+{
+    AVIOContext *pb = s->pb;
+    AVStream *st;
+
+    if (s->nb_streams != 1 ||
+        s->streams[0]->codecpar->codec_id != AV_CODEC_ID_COOL) {
+        av_log(s, AV_LOG_ERROR, "Only a single COOL stream is supported\n");
+        return AVERROR(EINVAL);
+    }
+    st = s->streams[0];
+
+    avio_wl32(pb, COOLSEQ_TAG);
+    avio_wl16(pb, COOLSEQ_VERSION);
+    avio_wl16(pb, COOLSEQ_HEADER_SIZE);
+    avio_wl32(pb, st->time_base.num);
+    avio_wl32(pb, st->time_base.den);
+    avio_wl32(pb, st->codecpar->width);
+    avio_wl32(pb, st->codecpar->height);
+    avio_wl64(pb, 0);                   // index offset, filled in by the trailer
+    avio_wl32(pb, 0);                   // frame count
+
+    return 0;
+}
+
+static int coolseq_write_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    CoolSeqMuxContext *c = s->priv_data;
+    AVIOContext *pb = s->pb;
+    CoolSeqIndexEntry *e;
+
+    if (c->nb_frames >= (INT_MAX - COOLSEQ_HEADER_SIZE) / COOLSEQ_INDEX_ENTRY_SIZE)
+        return AVERROR(ERANGE);
+
+    e = av_fast_realloc(c->index, &c->index_alloc,
+                        (c->nb_frames + 1) * sizeof(*c->index));
+    if (!e)
+        return AVERROR(ENOMEM);
+    c->index = e;
+    e = &c->index[c->nb_frames++];
+    e->pts  = pkt->pts;
+    e->pos  = avio_tell(pb);
+    e->size = pkt->size;
+
+    avio_wl32(pb, pkt->size);
+    avio_wl64(pb, pkt->pts);
+    avio_write(pb, pkt->data, pkt->size);
+
+    return 0;
+}
+
+static int coolseq_write_trailer(AVFormatContext *s)
+{
+    CoolSeqMuxContext *c = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t index_pos;
+    unsigned i;
+
+    avio_wl32(pb, 0);                   // end of the frames
+
+    /* the index is only reachable through the header */
+    if (!(pb->seekable & AVIO_SEEKABLE_NORMAL) || !c->nb_frames)
+        return 0;
+
+    index_pos = avio_tell(pb);
+    for (i = 0; i < c->nb_frames; i++) {
+        avio_wl64(pb, c->index[i].pts);
+        avio_wl64(pb, c->index[i].pos);
+        avio_wl32(pb, c->index[i].size);
+    }
+
+    avio_seek(pb, COOLSEQ_INDEX_POS, SEEK_SET);
+    avio_wl64(pb, index_pos);
+    avio_wl32(pb, c->nb_frames);
+    avio_seek(pb, 0, SEEK_END);
+
+    return 0;
+}
+
+static void coolseq_deinit(AVFormatContext *s)
+{
+    CoolSeqMuxContext *c = s->priv_data;
+
+    av_freep(&c->index);
+}
+
+AVOutputFormat ff_coolseq_muxer = {
+    .name           = "coolseq",
+    .long_name      = NULL_IF_CONFIG_SMALL("COOL image sequence"),
+    .extensions     = "cools",
+    .priv_data_size = sizeof(CoolSeqMuxContext),
+    .audio_codec    = AV_CODEC_ID_NONE,
+    .video_codec    = AV_CODEC_ID_COOL,
+    .write_header   = coolseq_write_header,
+    .write_packet   = coolseq_write_packet,
+    .write_trailer  = coolseq_write_trailer,
+    .deinit         = coolseq_deinit,
+    .flags          = AVFMT_VARIABLE_FPS,
+};
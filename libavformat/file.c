@@ -19,7 +19,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE     /* Needed for F_SETLEASE with glibc */
+
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/internal.h"
 #include "libavutil/opt.h"
 #include "avformat.h"
@@ -34,6 +37,10 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_MMAP
+#include <signal.h>
+#include <sys/mman.h>
+#endif
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
@@ -67,21 +74,50 @@
 
 /* standard file protocol */
 
+enum FileMapMode {
+    FILE_MAP_OFF,
+    FILE_MAP_READ,      ///< reads are copied from the mapping
+    FILE_MAP_ZEROCOPY,  ///< demuxers may also reference packet data in the mapping
+};
+
+/* How far ahead of the read position the kernel is asked to read, and how
+ * often the file size is checked again. */
+#define FILE_MAP_WINDOW (4 << 20)
+
+/* Smaller packets are copied, as that is cheaper than mapping them. */
+#define FILE_MAP_MIN_PACKET (64 << 10)
+
+typedef struct FileMapping {
+    uint8_t *data;
+    size_t size;
+} FileMapping;
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
     int trunc;
     int blocksize;
     int follow;
+    int map_mode;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
+    AVBufferRef *map;       ///< FileMapping of the whole file, NULL if not mapped
+    int64_t map_size;       ///< bytes of the mapping known to be backed by the file
+    int64_t map_checked;    ///< end of the window the size was last checked for
+    int64_t map_file_size;  ///< file size when mapped
+    int64_t map_mtime;      ///< file modification time when mapped
+    int64_t pos;            ///< read position, when mapped
 } FileContext;
 
 static const AVOption file_options[] = {
     { "truncate", "truncate existing files on write", offsetof(FileContext, trunc), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "mmap", "map the file in memory when reading", offsetof(FileContext, map_mode), AV_OPT_TYPE_INT, { .i64 = FILE_MAP_OFF }, FILE_MAP_OFF, FILE_MAP_ZEROCOPY, AV_OPT_FLAG_DECODING_PARAM, "mmap" },
+        { "off",      "read with read()",                           0, AV_OPT_TYPE_CONST, { .i64 = FILE_MAP_OFF },      0, 0, AV_OPT_FLAG_DECODING_PARAM, "mmap" },
+        { "read",     "copy reads from the mapping",                0, AV_OPT_TYPE_CONST, { .i64 = FILE_MAP_READ },     0, 0, AV_OPT_FLAG_DECODING_PARAM, "mmap" },
+        { "zerocopy", "also let packets point into the mapping",    0, AV_OPT_TYPE_CONST, { .i64 = FILE_MAP_ZEROCOPY }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "mmap" },
     { NULL }
 };
 
@@ -104,11 +140,229 @@ static const AVClass pipe_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if HAVE_MMAP
+static int64_t file_page_size(void)
+{
+#if HAVE_SYSCONF
+    return sysconf(_SC_PAGESIZE);
+#else
+    return 4096;
+#endif
+}
+
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    FileMapping *m = (FileMapping *)data;
+    munmap(m->data, m->size);
+    av_free(m);
+}
+
+/**
+ * Check whether the file is open for writing, by this or another process.
+ *
+ * @return 1 if it is, 0 if it is not, a negative error code if this
+ *         cannot be told
+ */
+static int file_open_for_writing(int fd)
+{
+#if defined(F_SETLEASE) && defined(F_SETSIG) && defined(SIGURG)
+    /* A read lease is refused while the file is open for writing. The lease
+     * is dropped right away, but if a writer comes in between, the signal
+     * telling about it must not kill the process: SIGURG is ignored by
+     * default. */
+    if (fcntl(fd, F_SETSIG, SIGURG) < 0)
+        return AVERROR(errno);
+    if (fcntl(fd, F_SETLEASE, F_RDLCK) < 0)
+        return errno == EAGAIN ? 1 : AVERROR(errno);
+    fcntl(fd, F_SETLEASE, F_UNLCK);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int file_map(URLContext *h, const struct stat *st)
+{
+    FileContext *c = h->priv_data;
+    FileMapping *m;
+    void *data;
+
+    if (st->st_size <= 0 || st->st_size > SIZE_MAX)
+        return 0;
+
+    if (c->map_mode == FILE_MAP_ZEROCOPY) {
+        int ret = file_open_for_writing(c->fd);
+        if (ret > 0) {
+            av_log(h, AV_LOG_WARNING, "The file is open for writing, "
+                   "packets are copied instead of mapped.\n");
+            c->map_mode = FILE_MAP_READ;
+        } else if (ret < 0) {
+            av_log(h, AV_LOG_VERBOSE, "Cannot tell whether the file is open "
+                   "for writing: %s\n", av_err2str(ret));
+        }
+    }
+
+    data = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (data == MAP_FAILED) {
+        av_log(h, AV_LOG_WARNING, "Cannot map the file, reading it instead: %s\n",
+               av_err2str(AVERROR(errno)));
+        return 0;
+    }
+    m = av_malloc(sizeof(*m));
+    if (m)
+        c->map = av_buffer_create((uint8_t *)m, sizeof(*m), file_unmap, NULL, 0);
+    if (!c->map) {
+        av_free(m);
+        munmap(data, st->st_size);
+        return AVERROR(ENOMEM);
+    }
+    m->data          = data;
+    m->size          = st->st_size;
+    c->map_size      = st->st_size;
+    c->map_file_size = st->st_size;
+    c->map_mtime     = st->st_mtime;
+#ifdef POSIX_MADV_SEQUENTIAL
+    posix_madvise(data, st->st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+    return 0;
+}
+
+/**
+ * Check the file size again, and stop handing out mapped packets once the
+ * file has been changed.
+ */
+static void file_map_stat(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+    int ret = fstat(c->fd, &st);
+
+    if (!ret && st.st_size < c->map_size)
+        c->map_size = st.st_size;
+    if (c->map_mode == FILE_MAP_ZEROCOPY &&
+        (ret < 0 || st.st_size != c->map_file_size || st.st_mtime != c->map_mtime)) {
+        av_log(h, AV_LOG_WARNING, "The file changed while being read, "
+               "packets are copied instead of mapped from now on.\n");
+        c->map_mode = FILE_MAP_READ;
+    }
+}
+
+/**
+ * Make sure [pos, end) may be accessed, and ask the kernel to read ahead.
+ *
+ * Touching a page past the end of a file that was truncated after being
+ * mapped raises SIGBUS, so the size is checked again once per window.
+ * This narrows, but cannot close, the race with a concurrent truncation.
+ */
+static void file_map_check(URLContext *h, int64_t pos, int64_t end)
+{
+    FileContext *c = h->priv_data;
+
+    if (pos >= c->map_checked - FILE_MAP_WINDOW && end <= c->map_checked)
+        return;
+    file_map_stat(h);
+    c->map_checked = FFMIN(FFMAX(pos + FILE_MAP_WINDOW, end), c->map_size);
+#ifdef POSIX_MADV_WILLNEED
+    if (pos < c->map_checked) {
+        const FileMapping *m = (const FileMapping *)c->map->data;
+        int64_t page  = file_page_size();
+        int64_t start = pos / page * page;
+        posix_madvise(m->data + start, c->map_checked - start, POSIX_MADV_WILLNEED);
+    }
+#endif
+}
+
+static int file_read_mapped(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    const FileMapping *m = (const FileMapping *)c->map->data;
+    int ret;
+
+    file_map_check(h, c->pos, c->pos + size);
+    if (c->pos < c->map_size) {
+        size = FFMIN(size, c->map_size - c->pos);
+        memcpy(buf, m->data + c->pos, size);
+        c->pos += size;
+        return size;
+    }
+
+    /* past the mapping, the file may have grown since it was mapped */
+    if (lseek(c->fd, c->pos, SEEK_SET) < 0)
+        return AVERROR(errno);
+    ret = read(c->fd, buf, size);
+    if (ret > 0)
+        c->pos += ret;
+    if (ret == 0 && c->follow)
+        return AVERROR(EAGAIN);
+    if (ret == 0)
+        return AVERROR_EOF;
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+
+static void file_unmap_packet(void *opaque, uint8_t *data)
+{
+    FileMapping *m = opaque;
+    munmap(m->data, m->size);
+    av_free(m);
+}
+
+static int file_get_mapped_buffer(URLContext *h, int64_t pos, int size,
+                                  AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+    int64_t page  = file_page_size();
+    int64_t start = pos / page * page;
+    int64_t end   = pos + size + AV_INPUT_BUFFER_PADDING_SIZE;
+    FileMapping *m;
+    uint8_t *data;
+
+    if (!c->map || c->map_mode != FILE_MAP_ZEROCOPY || pos < 0 ||
+        size < FILE_MAP_MIN_PACKET)
+        return AVERROR(ENOSYS);
+    /* packets outlive the window, so check the file for each of them */
+    file_map_stat(h);
+    file_map_check(h, pos, end);
+    /* pages past the one holding the end of the file cannot be accessed,
+     * the rest of that one reads as zeros */
+    if (c->map_mode != FILE_MAP_ZEROCOPY ||
+        end > (c->map_size + page - 1) / page * page)
+        return AVERROR(ENOSYS);
+
+    /* Each packet gets its own private mapping, so that its padding can be
+     * zeroed: only the pages holding the padding are copied by doing so,
+     * the packet data stays shared with the page cache. */
+    m = av_malloc(sizeof(*m));
+    if (!m)
+        return AVERROR(ENOMEM);
+    m->size = end - start;
+    data = mmap(NULL, m->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, c->fd, start);
+    if (data == MAP_FAILED) {
+        av_free(m);
+        return AVERROR(ENOSYS);
+    }
+    m->data = data;
+    memset(data + pos - start + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    mprotect(data, m->size, PROT_READ);
+
+    *buf = av_buffer_create(data + pos - start, size, file_unmap_packet, m,
+                            AV_BUFFER_FLAG_READONLY);
+    if (!*buf) {
+        file_unmap_packet(m, NULL);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+#endif /* HAVE_MMAP */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_MMAP
+    if (c->map)
+        return file_read_mapped(h, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -238,6 +492,19 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (!h->is_streamed && flags & AVIO_FLAG_WRITE)
         h->min_packet_size = h->max_packet_size = 262144;
 
+    if (c->map_mode != FILE_MAP_OFF && !(flags & AVIO_FLAG_WRITE) &&
+        !h->is_streamed && S_ISREG(st.st_mode)) {
+#if HAVE_MMAP
+        int ret = file_map(h, &st);
+        if (ret < 0) {
+            close(fd);
+            return ret;
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "Memory mapping is not supported on this platform.\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -253,6 +520,21 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+    if (c->map) {
+        if (whence == SEEK_CUR) {
+            pos += c->pos;
+        } else if (whence == SEEK_END) {
+            if ((ret = file_seek(h, 0, AVSEEK_SIZE)) < 0)
+                return ret;
+            pos += ret;
+        } else if (whence != SEEK_SET) {
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->pos = pos;
+    }
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -261,6 +543,8 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
+    /* packets have mappings of their own */
+    av_buffer_unref(&c->map);
     return close(c->fd);
 }
 
@@ -356,6 +640,9 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+#if HAVE_MMAP
+    .url_get_mapped_buffer = file_get_mapped_buffer,
+#endif
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
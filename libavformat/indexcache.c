@@ -0,0 +1,521 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Sidecar cache of the stream parameters and seek index of an input.
+ *
+ * The cache file of an input is named after the MD5 of the demuxer name,
+ * the size, the modification time when the protocol has a file handle, and
+ * the first and last 64 KiB of the input, and is kept in the directory set
+ * with the index_cache option. It holds what avformat_find_stream_info() found for
+ * every stream and, for demuxers that mark their index as complete, the
+ * index entries, so that the next open of the same input skips probing and
+ * index parsing.
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/random_seed.h"
+
+#include "avformat.h"
+#include "avio.h"
+#include "avio_internal.h"
+#include "internal.h"
+#include "url.h"
+
+#define CACHE_MAGIC     MKTAG('F', 'F', 'I', 'C')
+#define CACHE_VERSION   1
+#define KEY_BLOCK_SIZE  (64 * 1024)
+#define MAX_EXTRADATA   (1 << 28)
+#define ENTRY_SIZE      28          ///< size of an index entry in the file
+
+typedef struct CachedStream {
+    AVCodecParameters *par;
+    AVRational time_base;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+    AVRational sample_aspect_ratio;
+    int64_t start_time;
+    int64_t duration;
+    int64_t nb_frames;
+    int codec_info_nb_frames;
+    AVIndexEntry *index_entries;
+    int nb_index_entries;
+} CachedStream;
+
+struct FFIndexCache {
+    char *path;
+    int has_info;               ///< the file exists and matches the streams
+    int has_index;              ///< the file holds index entries
+
+    int64_t start_time;
+    int64_t duration;
+    int64_t bit_rate;
+    int duration_estimation_method;
+
+    CachedStream *streams;
+    int nb_streams;
+};
+
+static void free_streams(FFIndexCache *c)
+{
+    int i;
+
+    for (i = 0; i < c->nb_streams; i++) {
+        avcodec_parameters_free(&c->streams[i].par);
+        av_freep(&c->streams[i].index_entries);
+    }
+    av_freep(&c->streams);
+    c->nb_streams = 0;
+}
+
+void ff_index_cache_free(FFIndexCache **pc)
+{
+    FFIndexCache *c = *pc;
+
+    if (!c)
+        return;
+    free_streams(c);
+    av_freep(&c->path);
+    av_freep(pc);
+}
+
+static int compute_key(AVFormatContext *s, char *hex)
+{
+    AVIOContext *pb = s->pb;
+    URLContext *h   = ffio_geturlcontext(pb);
+    int fd          = h ? ffurl_get_file_handle(h) : -1;
+    int64_t pos  = avio_tell(pb);
+    int64_t size = avio_size(pb);
+    int64_t tail = FFMAX(KEY_BLOCK_SIZE, size - KEY_BLOCK_SIZE);
+    uint8_t *buf, key[16], size_le[8];
+    struct AVMD5 *md5;
+    struct stat st;
+    int64_t ret = 0;
+    int len, i;
+
+    if (size <= 0 || !(pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return AVERROR(ENOSYS);
+
+    buf = av_malloc(KEY_BLOCK_SIZE);
+    md5 = av_md5_alloc();
+    if (!buf || !md5) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    av_md5_init(md5);
+    av_md5_update(md5, (const uint8_t *)s->iformat->name, strlen(s->iformat->name) + 1);
+    AV_WL64(size_le, size);
+    av_md5_update(md5, size_le, sizeof(size_le));
+    if (fd >= 0 && !fstat(fd, &st)) {
+        AV_WL64(size_le, st.st_mtime);
+        av_md5_update(md5, size_le, sizeof(size_le));
+    }
+
+    if ((ret = avio_seek(pb, 0, SEEK_SET)) < 0)
+        goto end;
+    len = avio_read(pb, buf, FFMIN(size, KEY_BLOCK_SIZE));
+    if (len > 0)
+        av_md5_update(md5, buf, len);
+    if (tail < size) {
+        if ((ret = avio_seek(pb, tail, SEEK_SET)) < 0)
+            goto end;
+        len = avio_read(pb, buf, size - tail);
+        if (len > 0)
+            av_md5_update(md5, buf, len);
+    }
+    av_md5_final(md5, key);
+
+    for (i = 0; i < sizeof(key); i++)
+        snprintf(hex + 2 * i, 3, "%02x", key[i]);
+
+end:
+    if (avio_seek(pb, pos, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    av_free(md5);
+    av_free(buf);
+    return ret < 0 ? ret : 0;
+}
+
+static AVRational read_rational(AVIOContext *pb)
+{
+    AVRational q;
+    q.num = avio_rl32(pb);
+    q.den = avio_rl32(pb);
+    return q;
+}
+
+static void write_rational(AVIOContext *pb, AVRational q)
+{
+    avio_wl32(pb, q.num);
+    avio_wl32(pb, q.den);
+}
+
+/* Number of bytes left in the cache file, that the counts read from it are
+   checked against before allocating anything. */
+static int64_t bytes_left(AVIOContext *pb)
+{
+    int64_t size = avio_size(pb);
+
+    return size < 0 ? size : size - avio_tell(pb);
+}
+
+static int read_cache(FFIndexCache *c, AVIOContext *pb)
+{
+    int i, j;
+
+    if (avio_rl32(pb) != CACHE_MAGIC || avio_rl32(pb) != CACHE_VERSION)
+        return AVERROR_INVALIDDATA;
+
+    c->nb_streams = 0;
+    i             = avio_rl32(pb);
+    c->has_index  = avio_rl32(pb) & 1;
+    if (i <= 0 || i > INT_MAX / sizeof(*c->streams))
+        return AVERROR_INVALIDDATA;
+    if (!(c->streams = av_mallocz_array(i, sizeof(*c->streams))))
+        return AVERROR(ENOMEM);
+    c->nb_streams = i;
+
+    c->start_time                 = avio_rl64(pb);
+    c->duration                   = avio_rl64(pb);
+    c->bit_rate                   = avio_rl64(pb);
+    c->duration_estimation_method = avio_rl32(pb);
+
+    for (i = 0; i < c->nb_streams; i++) {
+        CachedStream *cs = &c->streams[i];
+        AVCodecParameters *par;
+
+        if (!(par = cs->par = avcodec_parameters_alloc()))
+            return AVERROR(ENOMEM);
+
+        par->codec_type            = (int)avio_rl32(pb);
+        par->codec_id              = avio_rl32(pb);
+        par->codec_tag             = avio_rl32(pb);
+        par->format                = (int)avio_rl32(pb);
+        par->bit_rate              = avio_rl64(pb);
+        par->bits_per_coded_sample = avio_rl32(pb);
+        par->bits_per_raw_sample   = avio_rl32(pb);
+        par->profile               = (int)avio_rl32(pb);
+        par->level                 = (int)avio_rl32(pb);
+        par->width                 = avio_rl32(pb);
+        par->height                = avio_rl32(pb);
+        par->sample_aspect_ratio   = read_rational(pb);
+        par->field_order           = avio_rl32(pb);
+        par->color_range           = avio_rl32(pb);
+        par->color_primaries       = avio_rl32(pb);
+        par->color_trc             = avio_rl32(pb);
+        par->color_space           = avio_rl32(pb);
+        par->chroma_location       = avio_rl32(pb);
+        par->video_delay           = avio_rl32(pb);
+        par->channel_layout        = avio_rl64(pb);
+        par->channels              = avio_rl32(pb);
+        par->sample_rate           = avio_rl32(pb);
+        par->block_align           = avio_rl32(pb);
+        par->frame_size            = avio_rl32(pb);
+        par->initial_padding       = avio_rl32(pb);
+        par->trailing_padding      = avio_rl32(pb);
+        par->seek_preroll          = avio_rl32(pb);
+
+        par->extradata_size = avio_rl32(pb);
+        if (par->extradata_size < 0 || par->extradata_size > MAX_EXTRADATA ||
+            par->extradata_size > bytes_left(pb)) {
+            par->extradata_size = 0;
+            return AVERROR_INVALIDDATA;
+        }
+        if (par->extradata_size) {
+            par->extradata = av_mallocz(par->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (!par->extradata) {
+                par->extradata_size = 0;
+                return AVERROR(ENOMEM);
+            }
+            if (avio_read(pb, par->extradata, par->extradata_size) != par->extradata_size)
+                return AVERROR_INVALIDDATA;
+        }
+
+        cs->time_base            = read_rational(pb);
+        cs->avg_frame_rate       = read_rational(pb);
+        cs->r_frame_rate         = read_rational(pb);
+        cs->sample_aspect_ratio  = read_rational(pb);
+        cs->start_time           = avio_rl64(pb);
+        cs->duration             = avio_rl64(pb);
+        cs->nb_frames            = avio_rl64(pb);
+        cs->codec_info_nb_frames = avio_rl32(pb);
+
+        cs->nb_index_entries = avio_rl32(pb);
+        if (cs->nb_index_entries < 0 ||
+            cs->nb_index_entries > INT_MAX / sizeof(*cs->index_entries) ||
+            cs->nb_index_entries > bytes_left(pb) / ENTRY_SIZE) {
+            cs->nb_index_entries = 0;
+            return AVERROR_INVALIDDATA;
+        }
+        if (cs->nb_index_entries) {
+            cs->index_entries = av_malloc_array(cs->nb_index_entries, sizeof(*cs->index_entries));
+            if (!cs->index_entries) {
+                cs->nb_index_entries = 0;
+                return AVERROR(ENOMEM);
+            }
+        }
+        for (j = 0; j < cs->nb_index_entries; j++) {
+            AVIndexEntry *e = &cs->index_entries[j];
+            e->pos          = avio_rl64(pb);
+            e->timestamp    = avio_rl64(pb);
+            e->size         = avio_rl32(pb) & 0x3FFFFFFF;
+            e->flags        = avio_rl32(pb) & 3;
+            e->min_distance = avio_rl32(pb);
+            if (avio_feof(pb))
+                return AVERROR_INVALIDDATA;
+        }
+        if (avio_feof(pb))
+            return AVERROR_INVALIDDATA;
+    }
+    return pb->error;
+}
+
+static int write_cache(AVFormatContext *s, AVIOContext *pb, int with_index)
+{
+    int i, j;
+
+    avio_wl32(pb, CACHE_MAGIC);
+    avio_wl32(pb, CACHE_VERSION);
+    avio_wl32(pb, s->nb_streams);
+    avio_wl32(pb, !!with_index);
+    avio_wl64(pb, s->start_time);
+    avio_wl64(pb, s->duration);
+    avio_wl64(pb, s->bit_rate);
+    avio_wl32(pb, s->duration_estimation_method);
+
+    for (i = 0; i < s->nb_streams; i++) {
+        const AVStream *st = s->streams[i];
+        const AVCodecParameters *par = st->codecpar;
+
+        avio_wl32(pb, par->codec_type);
+        avio_wl32(pb, par->codec_id);
+        avio_wl32(pb, par->codec_tag);
+        avio_wl32(pb, par->format);
+        avio_wl64(pb, par->bit_rate);
+        avio_wl32(pb, par->bits_per_coded_sample);
+        avio_wl32(pb, par->bits_per_raw_sample);
+        avio_wl32(pb, par->profile);
+        avio_wl32(pb, par->level);
+        avio_wl32(pb, par->width);
+        avio_wl32(pb, par->height);
+        write_rational(pb, par->sample_aspect_ratio);
+        avio_wl32(pb, par->field_order);
+        avio_wl32(pb, par->color_range);
+        avio_wl32(pb, par->color_primaries);
+        avio_wl32(pb, par->color_trc);
+        avio_wl32(pb, par->color_space);
+        avio_wl32(pb, par->chroma_location);
+        avio_wl32(pb, par->video_delay);
+        avio_wl64(pb, par->channel_layout);
+        avio_wl32(pb, par->channels);
+        avio_wl32(pb, par->sample_rate);
+        avio_wl32(pb, par->block_align);
+        avio_wl32(pb, par->frame_size);
+        avio_wl32(pb, par->initial_padding);
+        avio_wl32(pb, par->trailing_padding);
+        avio_wl32(pb, par->seek_preroll);
+        avio_wl32(pb, par->extradata_size);
+        avio_write(pb, par->extradata, par->extradata_size);
+
+        write_rational(pb, st->time_base);
+        write_rational(pb, st->avg_frame_rate);
+        write_rational(pb, st->r_frame_rate);
+        write_rational(pb, st->sample_aspect_ratio);
+        avio_wl64(pb, st->start_time);
+        avio_wl64(pb, st->duration);
+        avio_wl64(pb, st->nb_frames);
+        avio_wl32(pb, st->codec_info_nb_frames);
+
+        avio_wl32(pb, with_index ? st->nb_index_entries : 0);
+        for (j = 0; with_index && j < st->nb_index_entries; j++) {
+            const AVIndexEntry *e = &st->index_entries[j];
+            avio_wl64(pb, e->pos);
+            avio_wl64(pb, e->timestamp);
+            avio_wl32(pb, e->size);
+            avio_wl32(pb, e->flags & 3);
+            avio_wl32(pb, e->min_distance);
+        }
+    }
+    avio_flush(pb);
+    return pb->error;
+}
+
+/* The cache is a local file whatever protocol the input itself uses, so
+ * it does not go through the io_open callback and its whitelist. */
+static int open_cache_file(AVFormatContext *s, AVIOContext **pb,
+                           const char *path, int flags)
+{
+    return ffio_open_whitelist(pb, path, flags, &s->interrupt_callback,
+                               NULL, "file", NULL);
+}
+
+/* The demuxer creates the streams again on every open; the cache is only
+ * used if it describes the same ones. Codec ids may differ, as probing
+ * refines what the header says, e.g. MP3 into MP2 in MPEG-TS. */
+static int streams_match(AVFormatContext *s, FFIndexCache *c)
+{
+    int i;
+
+    if (c->nb_streams != s->nb_streams)
+        return 0;
+    for (i = 0; i < s->nb_streams; i++) {
+        const AVStream *st     = s->streams[i];
+        const CachedStream *cs = &c->streams[i];
+
+        if ((st->codecpar->codec_type != cs->par->codec_type && st->request_probe <= 0) ||
+            av_cmp_q(st->time_base, cs->time_base))
+            return 0;
+    }
+    return 1;
+}
+
+int ff_index_cache_open(AVFormatContext *s)
+{
+    FFIndexCache *c;
+    AVIOContext *pb = NULL;
+    char hex[33];
+    int i, ret;
+
+    if (!s->index_cache || !*s->index_cache || !s->pb ||
+        (s->flags & AVFMT_FLAG_CUSTOM_IO))
+        return 0;
+    if ((ret = compute_key(s, hex)) < 0)
+        return ret == AVERROR(ENOSYS) ? 0 : ret;
+
+    if (!(c = av_mallocz(sizeof(*c))))
+        return AVERROR(ENOMEM);
+    s->internal->index_cache = c;
+    if (!(c->path = av_asprintf("%s/%s.idx", s->index_cache, hex)))
+        return AVERROR(ENOMEM);
+
+    if (open_cache_file(s, &pb, c->path, AVIO_FLAG_READ) < 0) {
+        av_log(s, AV_LOG_VERBOSE, "No index cache at %s\n", c->path);
+        return 0;
+    }
+    ret = read_cache(c, pb);
+    avio_closep(&pb);
+    if (ret < 0 || !streams_match(s, c)) {
+        av_log(s, AV_LOG_WARNING, "Ignoring unusable index cache %s\n", c->path);
+        free_streams(c);
+        c->has_index = 0;
+        return 0;
+    }
+    c->has_info = 1;
+
+    /* Only tell the demuxer to skip its own index if something replaces it. */
+    if (c->has_index && !(s->flags & AVFMT_FLAG_IGNIDX)) {
+        for (i = 0; i < s->nb_streams; i++) {
+            AVStream *st     = s->streams[i];
+            CachedStream *cs = &c->streams[i];
+
+            if (st->nb_index_entries || !cs->nb_index_entries)
+                continue;
+            st->index_entries                = cs->index_entries;
+            st->nb_index_entries             = cs->nb_index_entries;
+            st->index_entries_allocated_size = cs->nb_index_entries * sizeof(*cs->index_entries);
+            cs->index_entries    = NULL;
+            cs->nb_index_entries = 0;
+            s->internal->index_restored = 1;
+        }
+    }
+
+    av_log(s, AV_LOG_VERBOSE, "Using index cache %s%s\n", c->path,
+           s->internal->index_restored ? " with index" : "");
+    return 0;
+}
+
+int ff_index_cache_restore_info(AVFormatContext *s)
+{
+    FFIndexCache *c = s->internal->index_cache;
+    int i, ret;
+
+    if (!c || !c->has_info || !streams_match(s, c))
+        return 0;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st     = s->streams[i];
+        CachedStream *cs = &c->streams[i];
+
+        if ((ret = avcodec_parameters_copy(st->codecpar, cs->par)) < 0)
+            return ret;
+        st->avg_frame_rate       = cs->avg_frame_rate;
+        st->r_frame_rate         = cs->r_frame_rate;
+        st->sample_aspect_ratio  = cs->sample_aspect_ratio;
+        st->start_time           = cs->start_time;
+        st->duration             = cs->duration;
+        st->nb_frames            = cs->nb_frames;
+        st->codec_info_nb_frames = cs->codec_info_nb_frames;
+        st->request_probe        = 0;
+        st->internal->orig_codec_id       = st->codecpar->codec_id;
+        st->internal->need_context_update = 1;
+#if FF_API_LAVF_AVCTX
+FF_DISABLE_DEPRECATION_WARNINGS
+        st->codec->framerate = st->avg_frame_rate;
+FF_ENABLE_DEPRECATION_WARNINGS
+#endif
+    }
+    s->start_time                 = c->start_time;
+    s->duration                   = c->duration;
+    s->bit_rate                   = c->bit_rate;
+    s->duration_estimation_method = c->duration_estimation_method;
+
+    free_streams(c);
+    return 1;
+}
+
+void ff_index_cache_save(AVFormatContext *s)
+{
+    FFIndexCache *c = s->internal->index_cache;
+    int with_index  = s->internal->index_complete;
+    AVIOContext *pb = NULL;
+    char *tmp;
+    int ret;
+
+    if (!c || (c->has_info && (c->has_index || !with_index)))
+        return;
+
+    /* Other processes may write the same entry at the same time, only the
+     * rename is atomic. */
+    if (!(tmp = av_asprintf("%s.%08x.tmp", c->path, av_get_random_seed())))
+        return;
+    if ((ret = open_cache_file(s, &pb, tmp, AVIO_FLAG_WRITE)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not write index cache %s\n", tmp);
+        goto end;
+    }
+    ret = write_cache(s, pb, with_index);
+    avio_closep(&pb);
+    if (ret >= 0)
+        ret = ff_rename(tmp, c->path, s);
+    if (ret < 0) {
+        avpriv_io_delete(tmp);
+        goto end;
+    }
+    c->has_info  = 1;
+    c->has_index = with_index;
+
+end:
+    av_free(tmp);
+}
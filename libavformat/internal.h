@@ -41,6 +41,8 @@
 #    define hex_dump_debug(class, buf, size) do { if (0) av_hex_dump_log(class, AV_LOG_DEBUG, buf, size); } while(0)
 #endif
 
+typedef struct FFIndexCache FFIndexCache;
+
 typedef struct AVCodecTag {
     enum AVCodecID id;
     unsigned int tag;
@@ -144,6 +146,22 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Cache opened from AVFormatContext.index_cache, NULL if unused.
+     */
+    FFIndexCache *index_cache;
+
+    /**
+     * Set by the demuxer once the index entries of all streams cover the
+     * whole input, so that they may be cached.
+     */
+    int index_complete;
+
+    /**
+     * Set if the index entries were restored from the cache.
+     */
+    int index_restored;
 };
 
 struct AVStreamInternal {
@@ -487,6 +505,42 @@ int ff_add_param_change(AVPacket *pkt, int32_t channels,
  */
 int ff_framehash_write_header(AVFormatContext *s);
 
+/**
+ * Same as av_get_packet(), but reference the data in place instead of
+ * copying it when the protocol allows it, e.g. the file protocol with
+ * mmap=zerocopy.
+ *
+ * Such packets are read-only. Only use this where the packet data is not
+ * modified in place afterwards.
+ */
+int ff_get_packet_mapped(AVIOContext *s, AVPacket *pkt, int size);
+
+/**
+ * Look up the input in the index cache, after the header was read.
+ * A cached index is restored into the streams that have none.
+ *
+ * @return 0 on success, including when there is nothing cached,
+ *         a negative AVERROR code on failure
+ */
+int ff_index_cache_open(AVFormatContext *s);
+
+/**
+ * Set the stream parameters found by a previous
+ * avformat_find_stream_info() call.
+ *
+ * @return 1 if they were set, 0 if there are none for these streams,
+ *         a negative AVERROR code on failure
+ */
+int ff_index_cache_restore_info(AVFormatContext *s);
+
+/**
+ * Write the stream parameters, and the index if it is complete, to the
+ * cache unless it already holds them.
+ */
+void ff_index_cache_save(AVFormatContext *s);
+
+void ff_index_cache_free(FFIndexCache **c);
+
 /**
  * Read a transport packet from a media file.
  *
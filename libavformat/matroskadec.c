@@ -1705,6 +1705,8 @@ static void matroska_parse_cues(MatroskaDemuxContext *matroska) {
     }
 
     matroska_add_index_entries(matroska);
+    if (matroska->cues_parsing_deferred >= 0 && matroska->index.nb_elem >= 2)
+        matroska->ctx->internal->index_complete = 1;
 }
 
 static int matroska_aac_profile(char *codec_id)
@@ -3552,10 +3554,12 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     AVStream *st = s->streams[stream_index];
     int i, index, index_min;
 
-    /* Parse the CUES now since we need the index data to seek. */
+    /* Parse the CUES now since we need the index data to seek, unless
+     * they were restored from the index cache. */
     if (matroska->cues_parsing_deferred > 0) {
         matroska->cues_parsing_deferred = 0;
-        matroska_parse_cues(matroska);
+        if (!s->internal->index_restored)
+            matroska_parse_cues(matroska);
     }
 
     if (!st->nb_index_entries)
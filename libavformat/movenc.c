@@ -68,6 +68,7 @@ static const AVOption options[] = {
     { "frag_custom", "Flush fragments on caller requests", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_CUSTOM}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "isml", "Create a live smooth streaming feed (for pushing to a publishing point)", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_ISML}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "faststart", "Run a second pass to put the index (moov atom) at the beginning of the file", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FASTSTART}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "reserve_moov", "Reserve space for the index (moov atom) at the beginning of the file, estimated from the stream durations", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RESERVE_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "omit_tfhd_offset", "Omit the base data offset in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_OMIT_TFHD_OFFSET}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "disable_chpl", "Disable Nero chapter atom", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DISABLE_CHPL}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "default_base_moof", "Set the default-base-is-moof flag in tfhd atoms", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_DEFAULT_BASE_MOOF}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -6026,6 +6027,65 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+/*
+ * Predict the size of the moov atom from the durations of the streams,
+ * which have to be set by the caller. The sample tables are assumed to
+ * need one stsz and co64 entry per sample, plus a ctts and stss entry per
+ * video sample; variable frame durations are left to the fallback in
+ * write_reserved_moov().
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t size = 4096 + 1024 * (mov->nb_streams - s->nb_streams);
+    AVDictionaryEntry *t = NULL;
+    int i;
+
+    while ((t = av_dict_get(s->metadata, "", t, AV_DICT_IGNORE_SUFFIX)))
+        size += strlen(t->key) + strlen(t->value) + 32;
+    size += 16 * s->nb_chapters;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        AVRational rate;
+        int64_t nb_samples;
+        int entry_size;
+
+        if (st->duration <= 0 || st->duration == AV_NOPTS_VALUE ||
+            st->time_base.num <= 0 || st->time_base.den <= 0)
+            return AVERROR(EINVAL);
+
+        switch (par->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            rate = st->avg_frame_rate;
+            if (rate.num <= 0 || rate.den <= 0)
+                rate = st->r_frame_rate;
+            if (rate.num <= 0 || rate.den <= 0)
+                rate = (AVRational){ 60, 1 };
+            entry_size = 4 + 8 + 8 + 4;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            rate = (AVRational){ par->sample_rate,
+                                 par->frame_size > 0 ? par->frame_size : 1024 };
+            if (rate.num <= 0)
+                return AVERROR(EINVAL);
+            entry_size = 4 + 8;
+            break;
+        default:
+            rate = (AVRational){ 1, 1 };
+            entry_size = 4 + 8 + 8;
+            break;
+        }
+        nb_samples = av_rescale(st->duration, (int64_t)st->time_base.num * rate.num,
+                                (int64_t)st->time_base.den * rate.den) + 1;
+        size += 1024 + par->extradata_size + nb_samples * entry_size;
+        if (size > INT_MAX)
+            return AVERROR(EINVAL);
+    }
+    return size;
+}
+
 static int mov_init(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6163,6 +6223,27 @@ static int mov_init(AVFormatContext *s)
         mov->nb_streams += mov->nb_meta_tmcd;
     }
 
+    if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV) {
+        int64_t size = estimate_moov_size(s);
+
+        if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
+            av_log(s, AV_LOG_WARNING, "reserve_moov is ignored for fragmented output\n");
+            mov->flags &= ~FF_MOV_FLAG_RESERVE_MOOV;
+        } else if (mov->reserved_moov_size > 0) {
+            /* an explicit moov_size is kept, but may now be exceeded */
+        } else if (size < 0) {
+            av_log(s, AV_LOG_WARNING, "Stream durations are not known, "
+                   "cannot reserve space for the moov atom; using faststart\n");
+            mov->flags &= ~FF_MOV_FLAG_RESERVE_MOOV;
+            mov->flags |= FF_MOV_FLAG_FASTSTART;
+            mov->reserved_moov_size = -1;
+        } else {
+            av_log(s, AV_LOG_VERBOSE, "Reserving %"PRId64" bytes for the moov atom\n", size);
+            mov->flags &= ~FF_MOV_FLAG_FASTSTART;
+            mov->reserved_moov_size = size;
+        }
+    }
+
     // Reserve an extra stream for chapters for the case where chapters
     // are written in the trailer
     mov->tracks = av_mallocz_array((mov->nb_streams + 1), sizeof(*mov->tracks));
@@ -6554,28 +6635,27 @@ static int compute_sidx_size(AVFormatContext *s)
     return sidx_size;
 }
 
-static int shift_data(AVFormatContext *s)
+/*
+ * Move the data from pos to the current output position forward by
+ * shift bytes.
+ */
+static int shift_data_from(AVFormatContext *s, int64_t pos, int shift)
 {
-    int ret = 0, moov_size;
-    MOVMuxContext *mov = s->priv_data;
-    int64_t pos, pos_end = avio_tell(s->pb);
+    int ret = 0;
+    int64_t pos_end;
     uint8_t *buf, *read_buf[2];
     int read_buf_id = 0;
     int read_size[2];
+    /* blocks have to be at least as large as the shift, so that a block is
+     * read before anything is written over it */
+    int block_size = FFMAX(shift, 1 << 16);
     AVIOContext *read_pb;
 
-    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
-        moov_size = compute_sidx_size(s);
-    else
-        moov_size = compute_moov_size(s);
-    if (moov_size < 0)
-        return moov_size;
-
-    buf = av_malloc(moov_size * 2);
+    buf = av_malloc(block_size * 2);
     if (!buf)
         return AVERROR(ENOMEM);
     read_buf[0] = buf;
-    read_buf[1] = buf + moov_size;
+    read_buf[1] = buf + block_size;
 
     /* Shift the data: the AVIO context of the output can only be used for
      * writing, so we re-open the same output, but for reading. It also avoids
@@ -6591,18 +6671,17 @@ static int shift_data(AVFormatContext *s)
     /* mark the end of the shift to up to the last data we wrote, and get ready
      * for writing */
     pos_end = avio_tell(s->pb);
-    avio_seek(s->pb, mov->reserved_header_pos + moov_size, SEEK_SET);
+    avio_seek(s->pb, pos + shift, SEEK_SET);
 
-    /* start reading at where the new moov will be placed */
-    avio_seek(read_pb, mov->reserved_header_pos, SEEK_SET);
-    pos = avio_tell(read_pb);
+    /* start reading at where the new data will be placed */
+    avio_seek(read_pb, pos, SEEK_SET);
 
-#define READ_BLOCK do {                                                             \
-    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], moov_size);  \
-    read_buf_id ^= 1;                                                               \
+#define READ_BLOCK do {                                                              \
+    read_size[read_buf_id] = avio_read(read_pb, read_buf[read_buf_id], block_size);  \
+    read_buf_id ^= 1;                                                                \
 } while (0)
 
-    /* shift data by chunk of at most moov_size */
+    /* shift data by chunk of at most block_size */
     READ_BLOCK;
     do {
         int n;
@@ -6620,6 +6699,74 @@ end:
     return ret;
 }
 
+static int shift_data(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int moov_size;
+
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
+        moov_size = compute_sidx_size(s);
+    else
+        moov_size = compute_moov_size(s);
+    if (moov_size < 0)
+        return moov_size;
+
+    return shift_data_from(s, mov->reserved_header_pos, moov_size);
+}
+
+/*
+ * Write the moov atom into the space reserved by reserve_moov, followed
+ * by a free atom for the unused part. If the reservation is too small,
+ * the data after it is shifted by the missing size only.
+ */
+static int write_reserved_moov(AVFormatContext *s, int64_t moov_pos)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *pb = s->pb;
+    int64_t shift = 0, free_size;
+    int i, ret, moov_size;
+
+    for (;;) {
+        if ((moov_size = get_moov_size(s)) < 0)
+            return moov_size;
+        free_size = mov->reserved_moov_size + shift - moov_size;
+        if (!free_size || free_size >= 8)
+            break;
+        /* shifting can switch the chunk offsets to co64, so check again */
+        for (i = 0; i < mov->nb_streams; i++)
+            mov->tracks[i].data_offset += free_size < 0 ? -free_size : 8 - free_size;
+        shift += free_size < 0 ? -free_size : 8 - free_size;
+    }
+
+    if (shift) {
+        av_log(s, AV_LOG_WARNING, "Reserved moov space exceeded: %d bytes "
+               "reserved, %d needed; shifting the data by %"PRId64" bytes\n",
+               mov->reserved_moov_size, moov_size, shift);
+        if (shift > INT_MAX)
+            return AVERROR(EINVAL);
+        avio_seek(pb, moov_pos, SEEK_SET);
+        ret = shift_data_from(s, mov->reserved_header_pos + mov->reserved_moov_size, shift);
+        if (ret < 0)
+            return ret;
+        mov->mdat_pos += shift;
+        moov_pos      += shift;
+    } else {
+        av_log(s, AV_LOG_VERBOSE, "moov atom uses %d of %d reserved bytes\n",
+               moov_size, mov->reserved_moov_size);
+    }
+
+    avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+    if ((ret = mov_write_moov_tag(pb, mov, s)) < 0)
+        return ret;
+    if (free_size) {
+        avio_wb32(pb, free_size);
+        ffio_wfourcc(pb, "free");
+        ffio_fill(pb, 0, free_size - 8);
+    }
+    avio_seek(pb, moov_pos, SEEK_SET);
+    return 0;
+}
+
 static int mov_write_trailer(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6684,7 +6831,10 @@ static int mov_write_trailer(AVFormatContext *s)
         }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_RESERVE_MOOV) {
+            if ((res = write_reserved_moov(s, moov_pos)) < 0)
+                return res;
+        } else if (mov->flags & FF_MOV_FLAG_FASTSTART) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
@@ -0,0 +1,476 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Background read-ahead below AVIOContext.
+ *
+ * The window in front of the read position is split into blocks, which
+ * are read by a small pool of threads. For seekable inputs every thread
+ * opens its own connection, so that several blocks are in flight at once
+ * and the connection of the caller stays free for it to use. Streamed
+ * inputs can only be read through the connection of the caller, by a
+ * single thread, and the caller must then leave it alone. A seek gives the
+ * blocks of the new window their positions, and a read still running for
+ * a block that was moved is interrupted through the interrupt callback of
+ * the connection it runs on.
+ */
+
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avio.h"
+#include "prefetch.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+#define BLOCK_ALIGN 4096
+
+enum BlockState {
+    BLOCK_EMPTY,
+    BLOCK_PENDING,              ///< waiting for a thread to read it
+    BLOCK_LOADING,
+    BLOCK_READY,
+    BLOCK_ERROR,
+};
+
+typedef struct PrefetchBlock {
+    int64_t pos;
+    int size;                   ///< bytes read, less than block_size only at EOF
+    int error;
+    enum BlockState state;
+    unsigned gen;               ///< bumped whenever the block is moved
+    uint8_t *data;
+} PrefetchBlock;
+
+typedef struct PrefetchWorker {
+    FFPrefetch *p;
+    URLContext *h;
+    uint8_t *buf;
+    int64_t pos;                ///< position of h, -1 if unknown
+    int block;                  ///< index of the block being read, -1 if idle
+    unsigned gen;               ///< generation of that block when it was taken
+    pthread_t thread;
+    int thread_started;
+} PrefetchWorker;
+
+struct FFPrefetch {
+    URLContext *h;
+    AVIOInterruptCB interrupt_callback; ///< the one h was opened with
+    int owns_h;                 ///< the thread reads through h
+
+    PrefetchBlock *blocks;
+    int nb_blocks;
+    int block_size;
+
+    PrefetchWorker *workers;
+    int nb_workers;
+
+    int64_t pos;                ///< read position
+    int64_t size;
+    int64_t eof_pos;
+    int seekable;
+    int abort;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_worker;
+    pthread_cond_t cond_reader;
+};
+
+static int worker_interrupt(void *opaque)
+{
+    PrefetchWorker *w = opaque;
+    FFPrefetch *p = w->p;
+    int stale;
+
+    pthread_mutex_lock(&p->mutex);
+    stale = p->abort || (w->block >= 0 && p->blocks[w->block].gen != w->gen);
+    pthread_mutex_unlock(&p->mutex);
+
+    return stale || ff_check_interrupt(&p->interrupt_callback);
+}
+
+/**
+ * Give the blocks of the window that starts at the read position their
+ * positions. The block right before it is left alone for short seeks
+ * back. Must be called with the mutex held.
+ */
+static void schedule(FFPrefetch *p)
+{
+    int64_t first = p->pos / p->block_size;
+    int i;
+
+    for (i = 0; i < p->nb_blocks - 1; i++) {
+        int64_t pos = (first + i) * p->block_size;
+        PrefetchBlock *b = &p->blocks[(first + i) % p->nb_blocks];
+
+        if (pos >= p->eof_pos)
+            break;
+        if (b->pos == pos && b->state != BLOCK_EMPTY)
+            continue;
+        b->pos   = pos;
+        b->size  = 0;
+        b->state = BLOCK_PENDING;
+        b->gen++;
+    }
+    pthread_cond_broadcast(&p->cond_worker);
+}
+
+static PrefetchBlock *next_pending(FFPrefetch *p)
+{
+    PrefetchBlock *next = NULL;
+    int i;
+
+    for (i = 0; i < p->nb_blocks; i++) {
+        PrefetchBlock *b = &p->blocks[i];
+        if (b->state == BLOCK_PENDING && (!next || b->pos < next->pos))
+            next = b;
+    }
+    return next;
+}
+
+static void *prefetch_worker(void *arg)
+{
+    PrefetchWorker *w = arg;
+    FFPrefetch *p = w->p;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort) {
+        PrefetchBlock *b = next_pending(p);
+        int64_t pos;
+        int got = 0, ret = 0;
+
+        if (!b) {
+            pthread_cond_wait(&p->cond_worker, &p->mutex);
+            continue;
+        }
+        b->state = BLOCK_LOADING;
+        pos      = b->pos;
+        w->block = b - p->blocks;
+        w->gen   = b->gen;
+        pthread_mutex_unlock(&p->mutex);
+
+        if (w->pos != pos) {
+            int64_t r = ffurl_seek(w->h, pos, SEEK_SET);
+            w->pos = r < 0 ? -1 : r;
+            if (r < 0)
+                ret = r;
+        }
+        while (ret >= 0 && got < p->block_size) {
+            ret = ffurl_read(w->h, w->buf + got, p->block_size - got);
+            if (ret == 0)
+                ret = AVERROR_EOF;
+            if (ret > 0) {
+                got    += ret;
+                w->pos += ret;
+            }
+        }
+
+        pthread_mutex_lock(&p->mutex);
+        w->block = -1;
+        if (b->gen != w->gen)
+            continue;
+        if (ret < 0 && ret != AVERROR_EOF) {
+            b->state = BLOCK_ERROR;
+            b->error = ret;
+        } else {
+            FFSWAP(uint8_t *, b->data, w->buf);
+            b->size  = got;
+            b->state = BLOCK_READY;
+            if (got < p->block_size)
+                p->eof_pos = FFMIN(p->eof_pos, pos + got);
+        }
+        pthread_cond_broadcast(&p->cond_reader);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+int ff_prefetch_init(FFPrefetch **pp, URLContext *h, AVDictionary *options)
+{
+    FFPrefetch *p;
+    int i, ret, nb_workers;
+
+    *pp = NULL;
+    if (h->prefetch_window <= 0 || (h->flags & AVIO_FLAG_WRITE) ||
+        h->prot->url_read_seek || h->prot->url_read_pause)
+        return AVERROR(ENOSYS);
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        av_free(p);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&p->cond_worker, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        av_free(p);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&p->cond_reader, NULL))) {
+        pthread_cond_destroy(&p->cond_worker);
+        pthread_mutex_destroy(&p->mutex);
+        av_free(p);
+        return AVERROR(ret);
+    }
+
+    p->h                  = h;
+    p->interrupt_callback = h->interrupt_callback;
+    p->seekable           = !h->is_streamed;
+    p->size               = ffurl_size(h);
+    p->eof_pos            = INT64_MAX;
+
+    nb_workers    = p->seekable ? h->prefetch_requests : 1;
+    p->nb_blocks  = FFMAX(2 * nb_workers, 4);
+    p->block_size = FFALIGN(FFMAX(h->prefetch_window / p->nb_blocks, BLOCK_ALIGN),
+                            BLOCK_ALIGN);
+
+    p->blocks  = av_mallocz_array(p->nb_blocks, sizeof(*p->blocks));
+    p->workers = av_mallocz_array(nb_workers,   sizeof(*p->workers));
+    if (!p->blocks || !p->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < p->nb_blocks; i++) {
+        p->blocks[i].pos = -1;
+        if (!(p->blocks[i].data = av_malloc(p->block_size))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+    for (i = 0; i < nb_workers; i++) {
+        p->workers[i].p     = p;
+        p->workers[i].block = -1;
+    }
+
+    /* threads reading seekable inputs open their own connections to the
+     * same URL, a streamed input can only be read through h */
+    for (p->nb_workers = 0; p->seekable && p->nb_workers < nb_workers; p->nb_workers++) {
+        PrefetchWorker *w = &p->workers[p->nb_workers];
+        AVIOInterruptCB cb = { worker_interrupt, w };
+        AVDictionary *opts = NULL;
+
+        av_dict_copy(&opts, options, 0);
+        ret = ffurl_open_whitelist(&w->h, h->filename, AVIO_FLAG_READ, &cb, &opts,
+                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        av_dict_free(&opts);
+        if (ret < 0) {
+            av_log(h, AV_LOG_WARNING, "Could not open connection %d for prefetching: %s\n",
+                   p->nb_workers + 1, av_err2str(ret));
+            break;
+        }
+    }
+    if (!p->nb_workers) {
+        p->workers[0].h = h;
+        p->owns_h       = 1;
+        p->nb_workers   = 1;
+        h->interrupt_callback = (AVIOInterruptCB){ worker_interrupt, &p->workers[0] };
+    }
+
+    for (i = 0; i < p->nb_workers; i++) {
+        PrefetchWorker *w = &p->workers[i];
+
+        if (!(w->buf = av_malloc(p->block_size))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        if ((ret = pthread_create(&w->thread, NULL, prefetch_worker, w))) {
+            ret = AVERROR(ret);
+            goto fail;
+        }
+        w->thread_started = 1;
+    }
+
+    av_log(h, AV_LOG_VERBOSE, "Prefetching %d blocks of %d bytes, %d read%s in flight\n",
+           p->nb_blocks - 1, p->block_size, p->nb_workers, p->nb_workers > 1 ? "s" : "");
+
+    pthread_mutex_lock(&p->mutex);
+    schedule(p);
+    pthread_mutex_unlock(&p->mutex);
+
+    *pp = p;
+    return 0;
+
+fail:
+    ff_prefetch_free(&p);
+    return ret;
+}
+
+int ff_prefetch_read(FFPrefetch *p, uint8_t *buf, int size)
+{
+    PrefetchBlock *b;
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    b = &p->blocks[p->pos / p->block_size % p->nb_blocks];
+    for (;;) {
+        if (p->pos >= p->eof_pos) {
+            ret = AVERROR_EOF;
+            break;
+        }
+        if (b->pos != p->pos - p->pos % p->block_size || b->state == BLOCK_EMPTY)
+            schedule(p);
+
+        if (b->state == BLOCK_READY) {
+            ret = FFMIN(size, b->pos + b->size - p->pos);
+            if (ret <= 0) {
+                ret = AVERROR_EOF;
+                break;
+            }
+            memcpy(buf, b->data + (p->pos - b->pos), ret);
+            p->pos += ret;
+            /* move the window along as soon as a block is used up */
+            if (p->pos == b->pos + p->block_size)
+                schedule(p);
+            break;
+        }
+        if (b->state == BLOCK_ERROR) {
+            ret      = b->error;
+            b->state = BLOCK_EMPTY;
+            break;
+        }
+        if (ff_check_interrupt(&p->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        pthread_cond_wait(&p->cond_reader, &p->mutex);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+int64_t ff_prefetch_seek(FFPrefetch *p, int64_t pos, int whence)
+{
+    int64_t ret;
+
+    pthread_mutex_lock(&p->mutex);
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        ret = p->size >= 0 ? p->size : AVERROR(ENOSYS);
+        goto end;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += p->pos;
+        break;
+    case SEEK_END:
+        if (p->size < 0) {
+            ret = AVERROR(ENOSYS);
+            goto end;
+        }
+        pos += p->size;
+        break;
+    default:
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    if (pos < 0) {
+        ret = AVERROR(EINVAL);
+    } else if (!p->seekable && pos != p->pos) {
+        ret = AVERROR(ENOSYS);
+    } else {
+        p->pos = pos;
+        schedule(p);
+        ret = pos;
+    }
+
+end:
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+
+int ff_prefetch_owns_url(const FFPrefetch *p)
+{
+    return p->owns_h;
+}
+
+void ff_prefetch_free(FFPrefetch **pp)
+{
+    FFPrefetch *p = *pp;
+    int i;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort = 1;
+    pthread_cond_broadcast(&p->cond_worker);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (i = 0; i < p->nb_workers; i++) {
+        PrefetchWorker *w = &p->workers[i];
+
+        if (w->thread_started)
+            pthread_join(w->thread, NULL);
+        if (w->h != p->h)
+            ffurl_closep(&w->h);
+        av_freep(&w->buf);
+    }
+    if (p->owns_h)
+        p->h->interrupt_callback = p->interrupt_callback;
+
+    for (i = 0; p->blocks && i < p->nb_blocks; i++)
+        av_freep(&p->blocks[i].data);
+    av_freep(&p->blocks);
+    av_freep(&p->workers);
+
+    pthread_cond_destroy(&p->cond_reader);
+    pthread_cond_destroy(&p->cond_worker);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(pp);
+}
+
+#else /* HAVE_THREADS */
+
+int ff_prefetch_init(FFPrefetch **p, URLContext *h, AVDictionary *options)
+{
+    *p = NULL;
+    return AVERROR(ENOSYS);
+}
+
+int ff_prefetch_read(FFPrefetch *p, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+int64_t ff_prefetch_seek(FFPrefetch *p, int64_t pos, int whence)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_prefetch_owns_url(const FFPrefetch *p)
+{
+    return 0;
+}
+
+void ff_prefetch_free(FFPrefetch **p)
+{
+}
+
+#endif /* HAVE_THREADS */
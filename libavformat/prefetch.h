@@ -0,0 +1,70 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_PREFETCH_H
+#define AVFORMAT_PREFETCH_H
+
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+
+#include "url.h"
+
+/**
+ * Background read-ahead of a URLContext, used by the AVIOContexts
+ * opened through ffio_open_whitelist() when the prefetch_window option
+ * is set.
+ */
+typedef struct FFPrefetch FFPrefetch;
+
+/**
+ * Start reading ahead of h.
+ *
+ * @param options the options h was opened with; they are used to open
+ *                the additional connections of seekable inputs
+ * @return 0 on success, AVERROR(ENOSYS) if h cannot be prefetched,
+ *         another negative AVERROR code on failure
+ */
+int ff_prefetch_init(FFPrefetch **p, URLContext *h, AVDictionary *options);
+
+/**
+ * Read from the current position, waiting for the block that holds it
+ * if it has not arrived yet.
+ */
+int ff_prefetch_read(FFPrefetch *p, uint8_t *buf, int size);
+
+/**
+ * Move the read position. Blocks outside of the new window are dropped
+ * and the reads still running for them are interrupted.
+ */
+int64_t ff_prefetch_seek(FFPrefetch *p, int64_t pos, int whence);
+
+/**
+ * @return 1 if the background reads go through the URLContext passed to
+ *         ff_prefetch_init(), which nothing else may then access until
+ *         ff_prefetch_free(), 0 if they use connections of their own
+ */
+int ff_prefetch_owns_url(const FFPrefetch *p);
+
+/**
+ * Stop the background reads and give h back its interrupt callback.
+ * The URLContext passed to ff_prefetch_init() is not closed.
+ */
+void ff_prefetch_free(FFPrefetch **p);
+
+#endif /* AVFORMAT_PREFETCH_H */
@@ -27,6 +27,7 @@
 #include "avio.h"
 #include "libavformat/version.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -49,6 +50,8 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int prefetch_window;        /**< bytes to read ahead in the background, 0 to read synchronously */
+    int prefetch_requests;      /**< maximum number of background reads in flight */
 } URLContext;
 
 typedef struct URLProtocol {
@@ -86,6 +89,14 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    /**
+     * Return a read-only reference to size bytes of the resource starting
+     * at pos without copying them. They must be followed by
+     * AV_INPUT_BUFFER_PADDING_SIZE zero bytes.
+     * Return AVERROR(ENOSYS) when this is not possible for that range.
+     */
+    int (*url_get_mapped_buffer)(URLContext *h, int64_t pos, int size,
+                                 AVBufferRef **buf);
     int (*url_shutdown)(URLContext *h, int flags);
     int priv_data_size;
     const AVClass *priv_data_class;
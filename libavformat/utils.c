@@ -32,6 +32,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/time_internal.h"
@@ -317,6 +318,25 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return append_packet_chunked(s, pkt, size);
 }
 
+int ff_get_packet_mapped(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(s);
+    AVBufferRef *buf;
+    int ret = ffio_read_mapped(s, size, &buf);
+
+    if (ret == AVERROR(ENOSYS))
+        return av_get_packet(s, pkt, size);
+    if (ret < 0)
+        return ret;
+
+    av_init_packet(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     if (!pkt->size)
@@ -664,6 +684,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->pb && !s->internal->data_offset)
         s->internal->data_offset = avio_tell(s->pb);
 
+    if ((ret = ff_index_cache_open(s)) < 0)
+        goto fail;
+
     s->internal->raw_packet_buffer_remaining_size = RAW_PACKET_BUFFER_SIZE;
 
     update_stream_avctx(s);
@@ -3013,8 +3036,9 @@ static int has_codec_parameters(AVStream *st, const char **errmsg_ptr)
 }
 
 /* returns 1 or 0 if or if not decoded data was returned, or a negative error */
+/* nb_frames is st->codec_info_nb_frames as of when avpkt was read */
 static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
-                            AVDictionary **options)
+                            AVDictionary **options, int nb_frames)
 {
     AVCodecContext *avctx = st->internal->avctx;
     const AVCodec *codec;
@@ -3071,7 +3095,7 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
     while ((pkt.size > 0 || (!pkt.data && got_picture)) &&
            ret >= 0 &&
            (!has_codec_parameters(st, NULL) || !has_decode_delay_been_guessed(st) ||
-            (!st->codec_info_nb_frames &&
+            (!nb_frames &&
              (avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF)))) {
         got_picture = 0;
         if (avctx->codec_type == AVMEDIA_TYPE_VIDEO ||
@@ -3111,6 +3135,205 @@ fail:
     return ret;
 }
 
+/**
+ * Probe packets whose decoding is deferred so that the packets of
+ * different streams can be decoded in parallel. Each stream is decoded
+ * by one job at a time, in packet order, and nothing else touches the
+ * streams while the jobs run.
+ */
+typedef struct ProbeBatch {
+    AVFormatContext *s;
+    AVSliceThread *thread;
+    int nb_threads;
+
+    struct {
+        AVStream *st;
+        AVPacket pkt;
+        AVDictionary **options;
+        int nb_frames;
+    } *pkts;
+    int nb_pkts;
+    int max_pkts;
+
+    int *streams;               ///< indices of the streams in the batch
+    int nb_streams;
+
+    AVDictionary **options;     ///< for flushing
+    int orig_nb_streams;
+
+    void (*job)(struct ProbeBatch *b, int jobnr);
+} ProbeBatch;
+
+static int probe_batch_has_stream(const ProbeBatch *b, int index)
+{
+    int i;
+    for (i = 0; i < b->nb_streams; i++)
+        if (b->streams[i] == index)
+            return 1;
+    return 0;
+}
+
+/* try_decode_frame() would neither open a decoder nor decode anything */
+static int probe_decode_done(AVStream *st)
+{
+    AVCodecContext *avctx = st->internal->avctx;
+
+    if (!avcodec_is_open(avctx))
+        return st->info->found_decoder < 0 &&
+               st->codecpar->codec_id == -st->info->found_decoder &&
+               st->codecpar->codec_id;
+    return has_codec_parameters(st, NULL) && has_decode_delay_been_guessed(st) &&
+           (st->codec_info_nb_frames ||
+            !(avctx->codec->capabilities & AV_CODEC_CAP_CHANNEL_CONF));
+}
+
+static void probe_decode_job(ProbeBatch *b, int jobnr)
+{
+    int index = b->streams[jobnr];
+    int i;
+
+    for (i = 0; i < b->nb_pkts; i++)
+        if (b->pkts[i].st->index == index)
+            try_decode_frame(b->s, b->pkts[i].st, &b->pkts[i].pkt,
+                             b->pkts[i].options, b->pkts[i].nb_frames);
+}
+
+static void probe_flush_job(ProbeBatch *b, int jobnr)
+{
+    AVStream *st  = b->s->streams[jobnr];
+    AVPacket empty_pkt = { 0 };
+    int err;
+
+    av_init_packet(&empty_pkt);
+    if (st->info->found_decoder != 1)
+        return;
+    do {
+        err = try_decode_frame(b->s, st, &empty_pkt,
+                               (b->options && jobnr < b->orig_nb_streams) ?
+                               &b->options[jobnr] : NULL,
+                               st->codec_info_nb_frames);
+    } while (err > 0 && !has_codec_parameters(st, NULL));
+
+    if (err < 0)
+        av_log(b->s, AV_LOG_INFO, "decoding for stream %d failed\n", st->index);
+}
+
+static void probe_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    ProbeBatch *b = priv;
+    b->job(b, jobnr);
+}
+
+static void probe_batch_run(ProbeBatch *b,
+                            void (*job)(ProbeBatch *b, int jobnr), int nb_jobs)
+{
+    int i;
+
+    if (!nb_jobs)
+        return;
+    b->job = job;
+    if (b->thread)
+        avpriv_slicethread_execute(b->thread, nb_jobs, 0);
+    else
+        for (i = 0; i < nb_jobs; i++)
+            job(b, i);
+}
+
+static int probe_batch_init(ProbeBatch *b, AVFormatContext *s,
+                            AVDictionary **options, int orig_nb_streams)
+{
+    int ret;
+
+    b->s               = s;
+    b->options         = options;
+    b->orig_nb_streams = orig_nb_streams;
+    b->nb_threads      = s->probe_threads;
+
+    ret = avpriv_slicethread_create(&b->thread, b, probe_worker, NULL,
+                                    s->probe_threads);
+    if (ret == AVERROR(ENOSYS))
+        av_log(s, AV_LOG_WARNING,
+               "No thread support, probe packets are decoded serially\n");
+    else if (ret < 0)
+        return ret;
+    return 0;
+}
+
+static void probe_batch_flush(ProbeBatch *b)
+{
+    probe_batch_run(b, probe_flush_job, b->s->nb_streams);
+}
+
+static void probe_batch_decode(ProbeBatch *b)
+{
+    int i;
+
+    probe_batch_run(b, probe_decode_job, b->nb_streams);
+    for (i = 0; i < b->nb_pkts; i++)
+        av_packet_unref(&b->pkts[i].pkt);
+    b->nb_pkts    = 0;
+    b->nb_streams = 0;
+}
+
+static int probe_batch_add(ProbeBatch *b, AVStream *st, AVPacket *pkt,
+                           AVDictionary **options)
+{
+    int i, ret;
+
+    /* Once a stream has everything it needs, its packets are not
+     * decoded any more. */
+    if (!probe_batch_has_stream(b, st->index) && probe_decode_done(st))
+        return 0;
+
+    if (b->nb_pkts == b->max_pkts) {
+        int max = FFMAX(2 * b->max_pkts, 4 * b->nb_threads);
+        void *tmp;
+
+        if ((tmp = av_realloc_array(b->pkts, max, sizeof(*b->pkts))))
+            b->pkts = tmp;
+        if (tmp && (tmp = av_realloc_array(b->streams, max, sizeof(*b->streams))))
+            b->streams = tmp;
+        if (!tmp) {
+            /* The queued packets still hold references, drop them with
+             * the arrays. */
+            for (i = 0; i < b->nb_pkts; i++)
+                av_packet_unref(&b->pkts[i].pkt);
+            av_freep(&b->pkts);
+            av_freep(&b->streams);
+            b->nb_pkts = b->nb_streams = b->max_pkts = 0;
+            return AVERROR(ENOMEM);
+        }
+        b->max_pkts = max;
+    }
+    av_init_packet(&b->pkts[b->nb_pkts].pkt);
+    if ((ret = av_packet_ref(&b->pkts[b->nb_pkts].pkt, pkt)) < 0)
+        return ret;
+    b->pkts[b->nb_pkts].st        = st;
+    b->pkts[b->nb_pkts].options   = options;
+    b->pkts[b->nb_pkts].nb_frames = st->codec_info_nb_frames;
+    b->nb_pkts++;
+    if (!probe_batch_has_stream(b, st->index))
+        b->streams[b->nb_streams++] = st->index;
+
+    /* The batch size only depends on the number of threads, so that the
+     * probing results do not depend on timing. */
+    if (b->nb_pkts >= 4 * b->nb_threads)
+        probe_batch_decode(b);
+    return 0;
+}
+
+static void probe_batch_uninit(ProbeBatch *b)
+{
+    int i;
+
+    for (i = 0; i < b->nb_pkts; i++)
+        av_packet_unref(&b->pkts[i].pkt);
+    av_freep(&b->pkts);
+    av_freep(&b->streams);
+    avpriv_slicethread_free(&b->thread);
+}
+
 unsigned int ff_codec_get_tag(const AVCodecTag *tags, enum AVCodecID id)
 {
     while (tags->id != AV_CODEC_ID_NONE) {
@@ -3577,10 +3800,15 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
     int64_t max_subtitle_analyze_duration;
     int64_t probesize = ic->probesize;
     int eof_reached = 0;
+    ProbeBatch batch = { 0 };
     int *missing_streams = av_opt_ptr(ic->iformat->priv_class, ic->priv_data, "missing_streams");
 
     flush_codecs = probesize > 0;
 
+    ret = ff_index_cache_restore_info(ic);
+    if (ret)
+        return ret < 0 ? ret : update_stream_avctx(ic);
+
     av_opt_set(ic, "skip_clear", "1", AV_OPT_SEARCH_CHILDREN);
 
     max_stream_analyze_duration = max_analyze_duration;
@@ -3684,6 +3912,12 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ic->streams[i]->info->fps_last_dts  = AV_NOPTS_VALUE;
     }
 
+    if (ic->probe_threads > 0) {
+        ret = probe_batch_init(&batch, ic, options, orig_nb_streams);
+        if (ret < 0)
+            goto find_stream_info_err;
+    }
+
     read_size = 0;
     for (;;) {
         int analyzed_all_streams;
@@ -3897,8 +4131,15 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (ic->probe_threads > 0) {
+            ret = probe_batch_add(&batch, st, pkt,
+                                  (options && i < orig_nb_streams) ? &options[i] : NULL);
+            if (ret < 0)
+                goto find_stream_info_err;
+        } else
+            try_decode_frame(ic, st, pkt,
+                             (options && i < orig_nb_streams) ? &options[i] : NULL,
+                             st->codec_info_nb_frames);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref(pkt);
@@ -3907,6 +4148,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
         count++;
     }
 
+    if (ic->probe_threads > 0)
+        probe_batch_decode(&batch);
+
     if (eof_reached) {
         int stream_index;
         for (stream_index = 0; stream_index < ic->nb_streams; stream_index++) {
@@ -3933,7 +4177,9 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
     }
 
-    if (flush_codecs) {
+    if (flush_codecs && ic->probe_threads > 0) {
+        probe_batch_flush(&batch);
+    } else if (flush_codecs) {
         AVPacket empty_pkt = { 0 };
         int err = 0;
         av_init_packet(&empty_pkt);
@@ -3947,7 +4193,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
                 do {
                     err = try_decode_frame(ic, st, &empty_pkt,
                                             (options && i < orig_nb_streams)
-                                            ? &options[i] : NULL);
+                                            ? &options[i] : NULL,
+                                           st->codec_info_nb_frames);
                 } while (err > 0 && !has_codec_parameters(st, NULL));
 
                 if (err < 0) {
@@ -4147,7 +4394,11 @@ FF_ENABLE_DEPRECATION_WARNINGS
         st->internal->avctx_inited = 0;
     }
 
+    if (ret >= 0)
+        ff_index_cache_save(ic);
+
 find_stream_info_err:
+    probe_batch_uninit(&batch);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->info)
@@ -4417,6 +4668,7 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->chapters);
     av_dict_free(&s->metadata);
     av_dict_free(&s->internal->id3v2_meta);
+    ff_index_cache_free(&s->internal->index_cache);
     av_freep(&s->streams);
     flush_packet_queue(s);
     av_freep(&s->internal);
@@ -4441,6 +4693,8 @@ void avformat_close_input(AVFormatContext **ps)
 
     flush_packet_queue(s);
 
+    ff_index_cache_save(s);
+
     if (s->iformat)
         if (s->iformat->read_close)
             s->iformat->read_close(s);
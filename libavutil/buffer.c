@@ -117,8 +117,11 @@ static void buffer_replace(AVBufferRef **dst, AVBufferRef **src)
         av_freep(dst);
 
     if (atomic_fetch_add_explicit(&b->refcount, -1, memory_order_acq_rel) == 1) {
+        /* b->free() may hand b to another thread, so check the flag first */
+        int free_avbuffer = !(b->flags & BUFFER_FLAG_NO_FREE);
         b->free(b->opaque, b->data);
-        av_freep(&b);
+        if (free_avbuffer)
+            av_free(b);
     }
 }
 
@@ -220,6 +223,8 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
                                    void (*pool_free)(void *opaque))
 {
     AVBufferPool *pool = av_mallocz(sizeof(*pool));
+    int i;
+
     if (!pool)
         return NULL;
 
@@ -230,6 +235,8 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
     pool->alloc2    = alloc;
     pool->pool_free = pool_free;
 
+    for (i = 0; i < BUFFER_POOL_CACHE_SIZE; i++)
+        atomic_init(&pool->cache[i], 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -238,6 +245,8 @@ AVBufferPool *av_buffer_pool_init2(int size, void *opaque,
 AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
 {
     AVBufferPool *pool = av_mallocz(sizeof(*pool));
+    int i;
+
     if (!pool)
         return NULL;
 
@@ -246,6 +255,8 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
     pool->size     = size;
     pool->alloc    = alloc ? alloc : av_buffer_alloc;
 
+    for (i = 0; i < BUFFER_POOL_CACHE_SIZE; i++)
+        atomic_init(&pool->cache[i], 0);
     atomic_init(&pool->refcount, 1);
 
     return pool;
@@ -257,6 +268,16 @@ AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
  */
 static void buffer_pool_free(AVBufferPool *pool)
 {
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_CACHE_SIZE; i++) {
+        BufferPoolEntry *buf = (BufferPoolEntry *)atomic_load(&pool->cache[i]);
+        if (buf) {
+            buf->next  = pool->pool;
+            pool->pool = buf;
+        }
+    }
+
     while (pool->pool) {
         BufferPoolEntry *buf = pool->pool;
         pool->pool = buf->next;
@@ -285,6 +306,42 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
+/* park an entry in the first empty cache slot, or in the locked list if
+ * there is none */
+static void pool_put_entry(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_CACHE_SIZE; i++) {
+        intptr_t empty = 0;
+        if (atomic_compare_exchange_strong_explicit(&pool->cache[i], &empty, (intptr_t)buf,
+                                                    memory_order_release,
+                                                    memory_order_relaxed))
+            return;
+    }
+
+    ff_mutex_lock(&pool->mutex);
+    buf->next = pool->pool;
+    pool->pool = buf;
+    ff_mutex_unlock(&pool->mutex);
+}
+
+static BufferPoolEntry *pool_get_entry(AVBufferPool *pool)
+{
+    BufferPoolEntry *buf;
+    int i;
+
+    for (i = 0; i < BUFFER_POOL_CACHE_SIZE; i++) {
+        if (!atomic_load_explicit(&pool->cache[i], memory_order_relaxed))
+            continue;
+        buf = (BufferPoolEntry *)atomic_exchange_explicit(&pool->cache[i], 0,
+                                                          memory_order_acquire);
+        if (buf)
+            return buf;
+    }
+    return NULL;
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
@@ -293,10 +350,7 @@ static void pool_release_buffer(void *opaque, uint8_t *data)
     if(CONFIG_MEMORY_POISONING)
         memset(buf->data, FF_MEMORY_POISON, pool->size);
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_put_entry(pool, buf);
 
     if (atomic_fetch_add_explicit(&pool->refcount, -1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -333,22 +387,40 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
-    AVBufferRef *ret;
-    BufferPoolEntry *buf;
+    AVBufferRef *ret = NULL;
+    BufferPoolEntry *buf = pool_get_entry(pool);
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
-    if (buf) {
-        ret = av_buffer_create(buf->data, pool->size, pool_release_buffer,
-                               buf, 0);
-        if (ret) {
+    if (!buf) {
+        ff_mutex_lock(&pool->mutex);
+        buf = pool->pool;
+        if (buf) {
             pool->pool = buf->next;
             buf->next = NULL;
+        } else {
+            ret = pool_alloc_buffer(pool);
         }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        ff_mutex_unlock(&pool->mutex);
+    }
+
+    if (buf) {
+        ret = av_mallocz(sizeof(*ret));
+        if (!ret) {
+            pool_put_entry(pool, buf);
+            return NULL;
+        }
+
+        memset(&buf->buffer, 0, sizeof(buf->buffer));
+        buf->buffer.data   = buf->data;
+        buf->buffer.size   = pool->size;
+        buf->buffer.free   = pool_release_buffer;
+        buf->buffer.opaque = buf;
+        buf->buffer.flags  = BUFFER_FLAG_NO_FREE;
+        atomic_init(&buf->buffer.refcount, 1);
+
+        ret->buffer = &buf->buffer;
+        ret->data   = buf->data;
+        ret->size   = pool->size;
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
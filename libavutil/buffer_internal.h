@@ -33,6 +33,16 @@
  * The buffer was av_realloc()ed, so it is reallocatable.
  */
 #define BUFFER_FLAG_REALLOCATABLE (1 << 1)
+/**
+ * The AVBuffer structure is part of a larger structure owned by the free()
+ * callback and must not be freed by av_buffer_unref().
+ */
+#define BUFFER_FLAG_NO_FREE       (1 << 2)
+
+/**
+ * Number of lock-free slots in front of the locked list of free pool entries.
+ */
+#define BUFFER_POOL_CACHE_SIZE 16
 
 struct AVBuffer {
     uint8_t *data; /**< data described by this buffer */
@@ -71,9 +81,24 @@ typedef struct BufferPoolEntry {
 
     AVBufferPool *pool;
     struct BufferPoolEntry *next;
+
+    /*
+     * An AVBuffer structure to (re)use as AVBuffer for subsequent uses
+     * of this BufferPoolEntry, so that getting a buffer from the pool
+     * does not need to allocate one.
+     */
+    AVBuffer buffer;
 } BufferPoolEntry;
 
 struct AVBufferPool {
+    /*
+     * Returned entries are parked in the first empty slot of cache and
+     * taken back with an atomic exchange, so most gets and releases never
+     * touch the mutex. Entries only go to the locked list when all slots
+     * are full.
+     */
+    atomic_intptr_t cache[BUFFER_POOL_CACHE_SIZE];
+
     AVMutex mutex;
     BufferPoolEntry *pool;
 
@@ -0,0 +1,158 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * AVBufferPool stress test and benchmark.
+ *
+ * 1 to N threads get buffers from one shared pool, each keeping a few of
+ * them alive at once, and stamp every buffer they get with their own id.
+ * The stamp is checked again before the buffer is returned, so that an
+ * entry handed to two threads at the same time is caught. The time per
+ * get/unref pair is printed next to that of av_buffer_alloc(), and so is
+ * the number of buffers the pool had to allocate.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#undef printf
+
+#define MAX_THREADS 64
+#define ITERATIONS  200000
+#define HELD        4
+#define BUF_SIZE    4096
+
+typedef struct ThreadArg {
+    AVBufferPool *pool;
+    int id;
+    int errors;
+} ThreadArg;
+
+static atomic_int nb_allocs;
+
+static AVBufferRef *counting_alloc(void *opaque, int size)
+{
+    atomic_fetch_add(&nb_allocs, 1);
+    return av_buffer_alloc(size);
+}
+
+static int check_stamp(const AVBufferRef *buf, int id, int seq)
+{
+    const int *stamp = (const int *)buf->data;
+    return stamp[0] != id || stamp[1] != seq;
+}
+
+static void *worker(void *opaque)
+{
+    ThreadArg *arg = opaque;
+    AVBufferRef *held[HELD] = { NULL };
+    int seq[HELD] = { 0 };
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++) {
+        int slot = i % HELD;
+
+        if (held[slot]) {
+            arg->errors += check_stamp(held[slot], arg->id, seq[slot]);
+            av_buffer_unref(&held[slot]);
+        }
+
+        held[slot] = arg->pool ? av_buffer_pool_get(arg->pool) : av_buffer_alloc(BUF_SIZE);
+        if (!held[slot]) {
+            arg->errors++;
+            break;
+        }
+        ((int *)held[slot]->data)[0] = arg->id;
+        ((int *)held[slot]->data)[1] = seq[slot] = i;
+    }
+
+    for (i = 0; i < HELD; i++) {
+        if (held[i])
+            arg->errors += check_stamp(held[i], arg->id, seq[i]);
+        av_buffer_unref(&held[i]);
+    }
+    return NULL;
+}
+
+static int run(int threads, int use_pool, int64_t *time)
+{
+    pthread_t tid[MAX_THREADS];
+    ThreadArg arg[MAX_THREADS];
+    AVBufferPool *pool = NULL;
+    int i, ret, errors = 0;
+    int64_t t;
+
+    if (use_pool && !(pool = av_buffer_pool_init2(BUF_SIZE, NULL, counting_alloc, NULL)))
+        return AVERROR(ENOMEM);
+    atomic_store(&nb_allocs, 0);
+
+    t = av_gettime_relative();
+    for (i = 0; i < threads; i++) {
+        arg[i] = (ThreadArg){ .pool = pool, .id = i };
+        if ((ret = pthread_create(&tid[i], NULL, worker, &arg[i]))) {
+            fprintf(stderr, "pthread_create failed: %s.\n", strerror(ret));
+            threads = i;
+            errors++;
+            break;
+        }
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(tid[i], NULL);
+        errors += arg[i].errors;
+    }
+    *time = av_gettime_relative() - t;
+
+    av_buffer_pool_uninit(&pool);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : FFMAX(av_cpu_count(), 4);
+    int threads;
+
+    max_threads = av_clip(max_threads, 1, MAX_THREADS);
+
+    for (threads = 1; threads <= max_threads; threads++) {
+        int64_t pool_time, alloc_time;
+        int errors;
+
+        errors = run(threads, 1, &pool_time);
+        if (errors) {
+            fprintf(stderr, "%d errors with %d threads\n", errors, threads);
+            return 1;
+        }
+        printf("threads %2d: pool %7.1f ns", threads,
+               pool_time * 1000.0 / (threads * ITERATIONS));
+        printf(" (%3d buffers, %3d live at most)", atomic_load(&nb_allocs), threads * HELD);
+
+        if (run(threads, 0, &alloc_time))
+            return 1;
+        printf("  av_buffer_alloc %7.1f ns\n", alloc_time * 1000.0 / (threads * ITERATIONS));
+    }
+    return 0;
+}
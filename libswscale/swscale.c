@@ -31,6 +31,7 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "config.h"
 #include "rgb2rgb.h"
 #include "swscale_internal.h"
@@ -242,6 +243,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
      * and faster */
     const int dstW                   = c->dstW;
     const int dstH                   = c->dstH;
+    const int dstEnd                 = c->dstSliceH ? c->dstSliceY + c->dstSliceH : dstH;
 
     const enum AVPixelFormat dstFormat = c->dstFormat;
     const int flags                  = c->flags;
@@ -343,7 +345,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     if (srcSliceY == 0) {
         lumBufIndex  = -1;
         chrBufIndex  = -1;
-        dstY         = 0;
+        dstY         = c->dstSliceY;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -375,7 +377,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstEnd; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -756,6 +758,79 @@ static void rgb48Toxyz12(struct SwsContext *c, uint16_t *dst,
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
  */
+/* bands start on a multiple of 16 lines, so chroma lines are never split */
+static int band_start(SwsContext *c, int jobnr, int nb_jobs)
+{
+    return jobnr == nb_jobs ? c->dstH : (int)((int64_t)c->dstH * jobnr / nb_jobs) & ~15;
+}
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
+                         int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext *c      = parent->slice_ctx[jobnr];
+    int y0 = band_start(parent, jobnr,     nb_jobs);
+    int y1 = band_start(parent, jobnr + 1, nb_jobs);
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int srcStride[4], dstStride[4], i;
+
+    memcpy(src,       parent->slice_src,       sizeof(src));
+    memcpy(srcStride, parent->slice_srcStride, sizeof(srcStride));
+    memcpy(dst,       parent->slice_dst,       sizeof(dst));
+    memcpy(dstStride, parent->slice_dstStride, sizeof(dstStride));
+
+    if (c->swscale == swscale) {
+        /* the band is computed from the whole source with its own ring buffers */
+        c->dstSliceY = y0;
+        c->dstSliceH = y1 - y0;
+        parent->slice_err[jobnr] = swscale(c, src, srcStride, 0, c->srcH, dst, dstStride);
+    } else {
+        /* unscaled converters write the lines of the source slice they get */
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(c->srcFormat);
+        int planes = 0;
+
+        for (i = 0; i < desc->nb_components; i++)
+            planes |= 1 << desc->comp[i].plane;
+        for (i = 0; i < 4; i++)
+            if (planes & (1 << i))
+                src[i] += (y0 >> (i == 1 || i == 2 ? desc->log2_chroma_h : 0)) * srcStride[i];
+        parent->slice_err[jobnr] = c->swscale(c, src, srcStride, y0, y1 - y0, dst, dstStride);
+    }
+}
+
+static int scale_bands(SwsContext *c, const uint8_t *src[], int srcStride[],
+                       uint8_t *dst[], int dstStride[])
+{
+    int nb_jobs = FFMIN(c->nb_slice_ctx, c->dstH / 16);
+    int i, ret = 0;
+
+    if (nb_jobs < 2)
+        return c->swscale(c, src, srcStride, 0, c->srcH, dst, dstStride);
+
+    memcpy(c->slice_src,       src,       sizeof(c->slice_src));
+    memcpy(c->slice_srcStride, srcStride, sizeof(c->slice_srcStride));
+    memcpy(c->slice_dst,       dst,       sizeof(c->slice_dst));
+    memcpy(c->slice_dstStride, dstStride, sizeof(c->slice_dstStride));
+    if (usePal(c->srcFormat)) {
+        for (i = 0; i < nb_jobs; i++) {
+            memcpy(c->slice_ctx[i]->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+            memcpy(c->slice_ctx[i]->pal_rgb, c->pal_rgb, sizeof(c->pal_rgb));
+        }
+    }
+
+    avpriv_slicethread_execute(c->slicethread, nb_jobs, 0);
+
+    for (i = 0; i < nb_jobs; i++) {
+        if (c->slice_err[i] < 0)
+            return c->slice_err[i];
+        ret += c->slice_err[i];
+    }
+    if (c->swscale == swscale)
+        c->dstY = c->dstH;
+    return ret;
+}
+
 int attribute_align_arg sws_scale(struct SwsContext *c,
                                   const uint8_t * const srcSlice[],
                                   const int srcStride[], int srcSliceY,
@@ -983,7 +1058,10 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+    if (c->nb_slice_ctx && !srcSliceY_internal && srcSliceH == c->srcH)
+        ret = scale_bands(c, src2, srcStride2, dst2, dstStride2);
+    else
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
 
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
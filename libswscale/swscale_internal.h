@@ -26,6 +26,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
+#include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
@@ -275,6 +276,7 @@ typedef void (*yuv2anyX_fn)(struct SwsContext *c, const int16_t *lumFilter,
 
 struct SwsSlice;
 struct SwsFilterDescriptor;
+struct AVSliceThread;
 
 /* This struct should be aligned on at least a 32-byte boundary. */
 typedef struct SwsContext {
@@ -321,6 +323,23 @@ typedef struct SwsContext {
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
 
+    /* Slice threading splits the destination into horizontal bands, each
+     * scaled by its own context with its own filter ring buffers, so the
+     * output does not depend on the number of threads.
+     */
+    int nb_threads;               ///< Number of threads to scale with, 0 for one per CPU.
+    struct SwsContext **slice_ctx;///< Contexts scaling one band each, nb_slice_ctx of them.
+    int nb_slice_ctx;
+    struct AVSliceThread *slicethread;
+    int *slice_err;               ///< Return value of each band job.
+    int dstSliceY;                ///< First destination line scaled by a band context.
+    int dstSliceH;                ///< Number of destination lines scaled by a band context, 0 for all.
+    int log_level_offset;         ///< Demotes the messages of band contexts, which repeat those of the main one.
+    const uint8_t *slice_src[4];  ///< Source and destination of the bands being scaled.
+    int slice_srcStride[4];
+    uint8_t *slice_dst[4];
+    int slice_dstStride[4];
+
     double gamma_value;
     int gamma_flag;
     int is_internal_gamma;
@@ -383,6 +402,12 @@ typedef struct SwsContext {
     int hChrFilterSize;           ///< Horizontal filter size for chroma     pixels.
     int vLumFilterSize;           ///< Vertical   filter size for luma/alpha pixels.
     int vChrFilterSize;           ///< Vertical   filter size for chroma     pixels.
+    /**
+     * Shared buffers holding the hLum, hChr, vLum and vChr filters and their
+     * positions, in that order, when they were taken from the process wide
+     * filter cache. Such filters are read-only and must not be av_free()d.
+     */
+    AVBufferRef *filter_buf[4];
     //@}
 
     int lumMmxextFilterCodeSize;  ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code size for luma/alpha planes.
@@ -858,6 +883,13 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Scale one horizontal band of the destination with the matching band
+ * context, run on the slice threads of the main context.
+ */
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
+                         int nb_threads);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
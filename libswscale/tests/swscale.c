@@ -32,6 +32,7 @@
 #include "libavutil/crc.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/lfg.h"
+#include "libavutil/time.h"
 
 #include "libswscale/swscale.h"
 
@@ -355,6 +356,84 @@ static int fileTest(const uint8_t * const ref[4], int refStride[4],
     return 0;
 }
 
+/* Times the high bit depth conversions used in HDR pipelines, at the same
+ * size and downscaled, so that the C paths can be compared with the SIMD
+ * ones by running once more with -cpuflags 0. */
+static int benchTest(int runs, enum AVPixelFormat srcFormat_in,
+                     enum AVPixelFormat dstFormat_in)
+{
+    static const enum AVPixelFormat formats[][2] = {
+        { AV_PIX_FMT_GBRP10,    AV_PIX_FMT_YUV420P10 },
+        { AV_PIX_FMT_GBRP12,    AV_PIX_FMT_YUV420P12 },
+        { AV_PIX_FMT_GBRP10,    AV_PIX_FMT_P010      },
+        { AV_PIX_FMT_YUV420P10, AV_PIX_FMT_GBRP10    },
+        { AV_PIX_FMT_YUV420P10, AV_PIX_FMT_P010      },
+        { AV_PIX_FMT_P010,      AV_PIX_FMT_YUV420P10 },
+        { AV_PIX_FMT_P010,      AV_PIX_FMT_GBRP10    },
+        { AV_PIX_FMT_YUV420P10, AV_PIX_FMT_RGB48     },
+        { AV_PIX_FMT_RGB48,     AV_PIX_FMT_YUV420P10 },
+    };
+    static const int sizes[][2] = { { 1920, 1080 }, { 1280, 720 } };
+    const int srcW = sizes[0][0], srcH = sizes[0][1];
+    uint8_t *src[4] = { NULL }, *dst[4] = { NULL };
+    int srcStride[4], dstStride[4];
+    int i, j, k, size, ret = 0;
+    AVLFG rand;
+
+    av_lfg_init(&rand, 1);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(formats); i++) {
+        enum AVPixelFormat srcFormat = formats[i][0];
+        enum AVPixelFormat dstFormat = formats[i][1];
+
+        if ((srcFormat_in != AV_PIX_FMT_NONE && srcFormat_in != srcFormat) ||
+            (dstFormat_in != AV_PIX_FMT_NONE && dstFormat_in != dstFormat))
+            continue;
+
+        if ((size = av_image_alloc(src, srcStride, srcW, srcH, srcFormat, 64)) < 0) {
+            ret = size;
+            goto end;
+        }
+        for (k = 0; k < size; k++)
+            src[0][k] = av_lfg_get(&rand);
+
+        for (j = 0; j < FF_ARRAY_ELEMS(sizes); j++) {
+            const int dstW = sizes[j][0], dstH = sizes[j][1];
+            struct SwsContext *sws;
+            int64_t t;
+
+            if ((ret = av_image_alloc(dst, dstStride, dstW, dstH, dstFormat, 64)) < 0)
+                goto end;
+            sws = sws_getContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat,
+                                 SWS_BILINEAR, NULL, NULL, NULL);
+            if (!sws) {
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+
+            t = av_gettime_relative();
+            for (k = 0; k < runs; k++)
+                sws_scale(sws, (const uint8_t * const *)src, srcStride, 0, srcH,
+                          dst, dstStride);
+            t = av_gettime_relative() - t;
+            sws_freeContext(sws);
+            av_freep(&dst[0]);
+
+            printf("%-11s %dx%d -> %-11s %dx%d %8.3f ms\n",
+                   av_get_pix_fmt_name(srcFormat), srcW, srcH,
+                   av_get_pix_fmt_name(dstFormat), dstW, dstH,
+                   t / (1000.0 * runs));
+            fflush(stdout);
+        }
+        av_freep(&src[0]);
+    }
+    ret = 0;
+end:
+    av_freep(&src[0]);
+    av_freep(&dst[0]);
+    return ret;
+}
+
 #define W 96
 #define H 96
 
@@ -374,6 +453,7 @@ int main(int argc, char **argv)
     int res = -1;
     int i;
     FILE *fp = NULL;
+    int bench = 0;
 
     if (!rgb_data || !data)
         return -1;
@@ -387,6 +467,12 @@ int main(int argc, char **argv)
                 fprintf(stderr, "could not open '%s'\n", argv[i + 1]);
                 goto error;
             }
+        } else if (!strcmp(argv[i], "-bench")) {
+            bench = atoi(argv[i + 1]);
+            if (bench <= 0) {
+                fprintf(stderr, "invalid number of runs %s\n", argv[i + 1]);
+                goto error;
+            }
         } else if (!strcmp(argv[i], "-cpuflags")) {
             unsigned flags = av_get_cpu_flags();
             int ret = av_parse_cpu_caps(&flags, argv[i + 1]);
@@ -426,9 +512,11 @@ bad_option:
     sws_freeContext(sws);
     av_free(rgb_data);
 
-    if(fp) {
+    if (fp) {
         res = fileTest(src, stride, W, H, fp, srcFormat, dstFormat);
         fclose(fp);
+    } else if (bench) {
+        res = benchTest(bench, srcFormat, dstFormat);
     } else {
         selfTest(src, stride, W, H, srcFormat, dstFormat);
         res = 0;
@@ -0,0 +1,223 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Slice threaded scaling check and benchmark.
+ *
+ * Scales random pictures between a range of formats and sizes with one and
+ * with several threads and checks that the output is identical. Then times
+ * downscaling a 4K picture to a ladder of smaller sizes with 1 to N threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/cpu.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+#include "libswscale/swscale.h"
+
+#undef printf
+
+#define RUNS 4
+
+static const enum AVPixelFormat formats[][2] = {
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_YUV420P     },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_NV12        },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_RGB24       },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_BGRA        },
+    { AV_PIX_FMT_YUV422P10LE, AV_PIX_FMT_YUV420P     },
+    { AV_PIX_FMT_YUV444P,     AV_PIX_FMT_GBRP        },
+    { AV_PIX_FMT_YUV410P,     AV_PIX_FMT_YUV420P16LE },
+    { AV_PIX_FMT_RGB24,       AV_PIX_FMT_YUV420P     },
+    { AV_PIX_FMT_RGBA,        AV_PIX_FMT_YUVA420P    },
+    { AV_PIX_FMT_PAL8,        AV_PIX_FMT_YUV420P     },
+    { AV_PIX_FMT_GRAY8,       AV_PIX_FMT_MONOWHITE   },
+    { AV_PIX_FMT_YUV420P,     AV_PIX_FMT_RGB8        },
+    { AV_PIX_FMT_NV12,        AV_PIX_FMT_YUV444P     },
+};
+
+static const int sizes[][4] = {
+    { 640, 480,  640, 480 },
+    { 640, 480,  320, 240 },
+    { 352, 288,  720, 577 },
+    { 1920, 1080, 1280, 720 },
+};
+
+static const int flags[] = { SWS_FAST_BILINEAR, SWS_BICUBIC, SWS_LANCZOS | SWS_ACCURATE_RND };
+
+static struct SwsContext *alloc_context(int srcw, int srch, enum AVPixelFormat src_fmt,
+                                        int dstw, int dsth, enum AVPixelFormat dst_fmt,
+                                        int flags, int threads)
+{
+    struct SwsContext *sws = sws_alloc_context();
+
+    if (!sws)
+        return NULL;
+    av_opt_set_int(sws, "srcw",       srcw,    0);
+    av_opt_set_int(sws, "srch",       srch,    0);
+    av_opt_set_int(sws, "src_format", src_fmt, 0);
+    av_opt_set_int(sws, "dstw",       dstw,    0);
+    av_opt_set_int(sws, "dsth",       dsth,    0);
+    av_opt_set_int(sws, "dst_format", dst_fmt, 0);
+    av_opt_set_int(sws, "sws_flags",  flags,   0);
+    av_opt_set_int(sws, "threads",    threads, 0);
+    if (sws_init_context(sws, NULL, NULL) < 0) {
+        sws_freeContext(sws);
+        return NULL;
+    }
+    return sws;
+}
+
+static int alloc_picture(uint8_t *data[4], int linesize[4], int w, int h,
+                         enum AVPixelFormat fmt, AVLFG *lfg)
+{
+    int i, size = av_image_alloc(data, linesize, w, h, fmt, 64);
+
+    if (size < 0)
+        return size;
+    for (i = 0; i < size; i++)
+        data[0][i] = lfg ? av_lfg_get(lfg) : 0;
+    return size;
+}
+
+static int scale(struct SwsContext *sws, uint8_t *src[4], int src_linesize[4],
+                 int srch, uint8_t *dst[4], int dst_linesize[4])
+{
+    return sws_scale(sws, (const uint8_t * const *)src, src_linesize, 0, srch,
+                     dst, dst_linesize);
+}
+
+static int check(const enum AVPixelFormat fmt[2], const int size[4], int flags,
+                 int threads, AVLFG *lfg)
+{
+    struct SwsContext *ref = alloc_context(size[0], size[1], fmt[0], size[2], size[3],
+                                           fmt[1], flags, 1);
+    struct SwsContext *sws = alloc_context(size[0], size[1], fmt[0], size[2], size[3],
+                                           fmt[1], flags, threads);
+    uint8_t *src[4] = { NULL }, *dst_ref[4] = { NULL }, *dst[4] = { NULL };
+    int src_linesize[4], dst_linesize[4];
+    int dst_size, ret = AVERROR(ENOMEM);
+
+    if (!ref || !sws)
+        goto end;
+    if ((ret = alloc_picture(src, src_linesize, size[0], size[1], fmt[0], lfg)) < 0 ||
+        (ret = alloc_picture(dst_ref, dst_linesize, size[2], size[3], fmt[1], NULL)) < 0 ||
+        (ret = alloc_picture(dst, dst_linesize, size[2], size[3], fmt[1], NULL)) < 0)
+        goto end;
+    dst_size = ret;
+
+    /* twice, so that state left over from the previous picture is covered */
+    if ((ret = scale(ref, src, src_linesize, size[1], dst_ref, dst_linesize)) < 0 ||
+        (ret = scale(sws, src, src_linesize, size[1], dst,     dst_linesize)) < 0 ||
+        (ret = scale(ref, src, src_linesize, size[1], dst_ref, dst_linesize)) < 0 ||
+        (ret = scale(sws, src, src_linesize, size[1], dst,     dst_linesize)) < 0)
+        goto end;
+
+    ret = 0;
+    if (memcmp(dst_ref[0], dst[0], dst_size)) {
+        fprintf(stderr, "%s %dx%d -> %s %dx%d flags 0x%x: output differs with %d threads\n",
+                av_get_pix_fmt_name(fmt[0]), size[0], size[1],
+                av_get_pix_fmt_name(fmt[1]), size[2], size[3], flags, threads);
+        ret = 1;
+    }
+end:
+    av_freep(&src[0]);
+    av_freep(&dst_ref[0]);
+    av_freep(&dst[0]);
+    sws_freeContext(ref);
+    sws_freeContext(sws);
+    return ret;
+}
+
+static int bench(int threads, AVLFG *lfg)
+{
+    static const int ladder[][2] = { { 1920, 1080 }, { 1280, 720 }, { 640, 360 } };
+    struct SwsContext *sws[FF_ARRAY_ELEMS(ladder)] = { NULL };
+    uint8_t *src[4] = { NULL }, *dst[FF_ARRAY_ELEMS(ladder)][4] = { { NULL } };
+    int src_linesize[4], dst_linesize[FF_ARRAY_ELEMS(ladder)][4];
+    int64_t t;
+    int i, j, ret;
+
+    if ((ret = alloc_picture(src, src_linesize, 3840, 2160, AV_PIX_FMT_YUV420P, lfg)) < 0)
+        goto end;
+    for (i = 0; i < FF_ARRAY_ELEMS(ladder); i++) {
+        sws[i] = alloc_context(3840, 2160, AV_PIX_FMT_YUV420P, ladder[i][0], ladder[i][1],
+                               AV_PIX_FMT_YUV420P, SWS_BICUBIC, threads);
+        if (!sws[i]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = alloc_picture(dst[i], dst_linesize[i], ladder[i][0], ladder[i][1],
+                                 AV_PIX_FMT_YUV420P, NULL)) < 0)
+            goto end;
+    }
+
+    t = av_gettime_relative();
+    for (j = 0; j < RUNS; j++)
+        for (i = 0; i < FF_ARRAY_ELEMS(ladder); i++)
+            if ((ret = scale(sws[i], src, src_linesize, 2160, dst[i], dst_linesize[i])) < 0)
+                goto end;
+    t = av_gettime_relative() - t;
+
+    printf("threads %2d: 2160p -> 1080p/720p/360p ladder %8.3f ms\n",
+           threads, t / (1000.0 * RUNS));
+    ret = 0;
+end:
+    av_freep(&src[0]);
+    for (i = 0; i < FF_ARRAY_ELEMS(ladder); i++) {
+        av_freep(&dst[i][0]);
+        sws_freeContext(sws[i]);
+    }
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : av_cpu_count();
+    int i, j, k, threads, ret = 0;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 0xC001);
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+        for (j = 0; j < FF_ARRAY_ELEMS(sizes); j++)
+            for (k = 0; k < FF_ARRAY_ELEMS(flags); k++) {
+                int err = check(formats[i], sizes[j], flags[k], FFMAX(max_threads, 3), &lfg);
+                if (err < 0) {
+                    fprintf(stderr, "scaling %s -> %s failed\n",
+                            av_get_pix_fmt_name(formats[i][0]),
+                            av_get_pix_fmt_name(formats[i][1]));
+                    return 1;
+                }
+                ret |= err;
+            }
+    if (ret)
+        return 1;
+
+    for (threads = 1; threads <= FFMAX(max_threads, 1); threads++)
+        if (bench(threads, &lfg) < 0)
+            return 1;
+    return 0;
+}
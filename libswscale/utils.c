@@ -49,6 +49,8 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 #include "libavutil/aarch64/cpu.h"
 #include "libavutil/ppc/cpu.h"
 #include "libavutil/x86/asm.h"
@@ -723,6 +725,130 @@ fail:
     return ret;
 }
 
+#define FILTER_CACHE_SIZE 64
+
+/**
+ * Everything the output of initFilter() depends on when no filter vectors
+ * are given. Zeroed before being filled, so that it can be memcmp()ed.
+ */
+typedef struct FilterKey {
+    int xInc, srcW, dstW;
+    int filterAlign, one;
+    int flags, cpu_flags;
+    double param[2];
+    int srcPos, dstPos;
+} FilterKey;
+
+typedef struct CachedFilter {
+    FilterKey key;
+    AVBufferRef *buf;           ///< coefficients, then the positions at pos_offset
+    int pos_offset;
+    int filterSize;
+} CachedFilter;
+
+static AVMutex filter_cache_mutex = AV_MUTEX_INITIALIZER;
+static CachedFilter filter_cache[FILTER_CACHE_SIZE]; ///< most recently used first
+static int filter_cache_nb;
+
+/**
+ * Same as initFilter(), but shares the tables between all the contexts of
+ * the process that use the same geometry. *buf is set to the reference
+ * the tables belong to, or left untouched when they were computed for this
+ * context only.
+ */
+static av_cold int initFilterCached(AVBufferRef **buf, int16_t **outFilter,
+                                    int32_t **filterPos, int *outFilterSize,
+                                    int xInc, int srcW, int dstW,
+                                    int filterAlign, int one,
+                                    int flags, int cpu_flags,
+                                    SwsVector *srcFilter, SwsVector *dstFilter,
+                                    double param[2], int srcPos, int dstPos)
+{
+    CachedFilter entry;
+    AVBufferRef *ref;
+    int i, ret, filter_size;
+
+    if (srcFilter || dstFilter)
+        return initFilter(outFilter, filterPos, outFilterSize, xInc, srcW, dstW,
+                          filterAlign, one, flags, cpu_flags, srcFilter,
+                          dstFilter, param, srcPos, dstPos);
+
+    memset(&entry, 0, sizeof(entry));
+    entry.key.xInc        = xInc;
+    entry.key.srcW        = srcW;
+    entry.key.dstW        = dstW;
+    entry.key.filterAlign = filterAlign;
+    entry.key.one         = one;
+    entry.key.flags       = flags;
+    entry.key.cpu_flags   = cpu_flags;
+    entry.key.param[0]    = param[0];
+    entry.key.param[1]    = param[1];
+    entry.key.srcPos      = srcPos;
+    entry.key.dstPos      = dstPos;
+
+    ff_mutex_lock(&filter_cache_mutex);
+    for (i = 0; i < filter_cache_nb; i++) {
+        if (!memcmp(&filter_cache[i].key, &entry.key, sizeof(entry.key))) {
+            CachedFilter hit = filter_cache[i];
+            if ((entry.buf = av_buffer_ref(hit.buf))) {
+                memmove(filter_cache + 1, filter_cache, i * sizeof(*filter_cache));
+                filter_cache[0] = hit;
+                entry.pos_offset = hit.pos_offset;
+                entry.filterSize = hit.filterSize;
+            }
+            break;
+        }
+    }
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    if (!entry.buf) {
+        if ((ret = initFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                              dstW, filterAlign, one, flags, cpu_flags, NULL,
+                              NULL, param, srcPos, dstPos)) < 0)
+            return ret;
+
+        filter_size      = (dstW + 3) * *outFilterSize * sizeof(**outFilter);
+        entry.pos_offset = FFALIGN(filter_size, 64);
+        entry.filterSize = *outFilterSize;
+        entry.buf = av_buffer_alloc(entry.pos_offset + (dstW + 3) * sizeof(**filterPos));
+        if (!entry.buf)
+            return 0;
+        memcpy(entry.buf->data, *outFilter, filter_size);
+        memcpy(entry.buf->data + entry.pos_offset, *filterPos,
+               (dstW + 3) * sizeof(**filterPos));
+        av_freep(outFilter);
+        av_freep(filterPos);
+
+        if ((ref = av_buffer_ref(entry.buf))) {
+            ff_mutex_lock(&filter_cache_mutex);
+            if (filter_cache_nb == FILTER_CACHE_SIZE)
+                av_buffer_unref(&filter_cache[--filter_cache_nb].buf);
+            memmove(filter_cache + 1, filter_cache, filter_cache_nb * sizeof(*filter_cache));
+            filter_cache[0]     = entry;
+            filter_cache[0].buf = ref;
+            filter_cache_nb++;
+            ff_mutex_unlock(&filter_cache_mutex);
+        }
+    }
+
+    *buf           = entry.buf;
+    *outFilter     = (int16_t *)entry.buf->data;
+    *filterPos     = (int32_t *)(entry.buf->data + entry.pos_offset);
+    *outFilterSize = entry.filterSize;
+    return 0;
+}
+
+static void free_filter(AVBufferRef **buf, int16_t **filter, int32_t **filterPos)
+{
+    if (*buf) {
+        *filter    = NULL;
+        *filterPos = NULL;
+        av_buffer_unref(buf);
+    }
+    av_freep(filter);
+    av_freep(filterPos);
+}
+
 static void fill_rgb2yuv_table(SwsContext *c, const int table[4], int dstRange)
 {
     int64_t W, V, Z, Cy, Cu, Cv;
@@ -859,7 +985,7 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
 {
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
-    int need_reinit = 0;
+    int need_reinit = 0, i;
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -985,6 +1111,11 @@ int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4],
 
     fill_rgb2yuv_table(c, table, dstRange);
 
+    /* only once the band contexts have been initialized */
+    for (i = 0; c->slicethread && i < c->nb_slice_ctx; i++)
+        sws_setColorspaceDetails(c->slice_ctx[i], inv_table, srcRange, table,
+                                 dstRange, brightness, contrast, saturation);
+
     return 0;
 }
 
@@ -1160,8 +1291,8 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
-av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
-                             SwsFilter *dstFilter)
+static av_cold int context_init(SwsContext *c, SwsFilter *srcFilter,
+                               SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -1671,8 +1802,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                                     PPC_ALTIVEC(cpu_flags) ? 8 :
                                     have_neon(cpu_flags)   ? 8 : 1;
 
-            if ((ret = initFilter(&c->hLumFilter, &c->hLumFilterPos,
-                           &c->hLumFilterSize, c->lumXInc,
+            if ((ret = initFilterCached(&c->filter_buf[0],
+                           &c->hLumFilter, &c->hLumFilterPos, &c->hLumFilterSize, c->lumXInc,
                            srcW, dstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
                            cpu_flags, srcFilter->lumH, dstFilter->lumH,
@@ -1680,8 +1811,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                            get_local_pos(c, 0, 0, 0),
                            get_local_pos(c, 0, 0, 0))) < 0)
                 goto fail;
-            if ((ret = initFilter(&c->hChrFilter, &c->hChrFilterPos,
-                           &c->hChrFilterSize, c->chrXInc,
+            if ((ret = initFilterCached(&c->filter_buf[1],
+                           &c->hChrFilter, &c->hChrFilterPos, &c->hChrFilterSize, c->chrXInc,
                            c->chrSrcW, c->chrDstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
                            cpu_flags, srcFilter->chrH, dstFilter->chrH,
@@ -1698,7 +1829,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                                 PPC_ALTIVEC(cpu_flags) ? 8 :
                                 have_neon(cpu_flags)   ? 2 : 1;
 
-        if ((ret = initFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
+        if ((ret = initFilterCached(&c->filter_buf[2],
+                       &c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
                        c->lumYInc, srcH, dstH, filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
                        cpu_flags, srcFilter->lumV, dstFilter->lumV,
@@ -1706,7 +1838,8 @@ av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
                        get_local_pos(c, 0, 0, 1),
                        get_local_pos(c, 0, 0, 1))) < 0)
             goto fail;
-        if ((ret = initFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
+        if ((ret = initFilterCached(&c->filter_buf[3],
+                       &c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
                        c->chrYInc, c->chrSrcH, c->chrDstH,
                        filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -1861,6 +1994,93 @@ fail: // FIXME replace things by appropriate error codes
     return -1;
 }
 
+static void free_slice_contexts(SwsContext *c)
+{
+    int i;
+
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    av_freep(&c->slice_err);
+    c->nb_slice_ctx = 0;
+}
+
+/**
+ * Allocate the band contexts with a copy of the options of the main
+ * context, before initializing it alters some of them.
+ */
+static av_cold int alloc_slice_contexts(SwsContext *c)
+{
+    int i, ret, nb_threads = c->nb_threads ? c->nb_threads : av_cpu_count();
+
+    if (nb_threads <= 1)
+        return 0;
+
+    c->slice_ctx = av_mallocz_array(nb_threads, sizeof(*c->slice_ctx));
+    c->slice_err = av_mallocz_array(nb_threads, sizeof(*c->slice_err));
+    if (!c->slice_ctx || !c->slice_err)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < nb_threads; i++) {
+        SwsContext *s = c->slice_ctx[i] = sws_alloc_context();
+        if (!s)
+            return AVERROR(ENOMEM);
+        c->nb_slice_ctx++;
+        if ((ret = av_opt_copy(s, c)) < 0)
+            return ret;
+        s->nb_threads       = 1;
+        s->flags           &= ~SWS_PRINT_INFO;
+        s->log_level_offset = AV_LOG_VERBOSE - AV_LOG_WARNING;
+    }
+    return 0;
+}
+
+static av_cold int init_slice_contexts(SwsContext *c, SwsFilter *srcFilter,
+                                       SwsFilter *dstFilter)
+{
+    int i, ret;
+
+    /* Error diffusion carries state from one line to the next and bayer
+     * input is demosaiced differently at slice edges, so bands would not
+     * match the output of a single context. */
+    if (c->cascaded_context[0] || c->dither == SWS_DITHER_ED ||
+        isBayer(c->srcFormat)) {
+        free_slice_contexts(c);
+        return 0;
+    }
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        if ((ret = sws_init_context(c->slice_ctx[i], srcFilter, dstFilter)) < 0)
+            return ret;
+
+    ret = avpriv_slicethread_create(&c->slicethread, c, ff_sws_slice_worker,
+                                    NULL, c->nb_slice_ctx);
+    if (ret < 0) {
+        /* no threading support, scale with the main context */
+        free_slice_contexts(c);
+        return ret == AVERROR(ENOMEM) ? ret : 0;
+    }
+    c->nb_slice_ctx = FFMIN(c->nb_slice_ctx, ret);
+    return 0;
+}
+
+av_cold int sws_init_context(SwsContext *c, SwsFilter *srcFilter,
+                             SwsFilter *dstFilter)
+{
+    int ret;
+
+    if (c->nb_threads != 1 && (ret = alloc_slice_contexts(c)) < 0)
+        return ret;
+
+    if ((ret = context_init(c, srcFilter, dstFilter)) < 0)
+        return ret;
+
+    if (c->nb_slice_ctx)
+        return init_slice_contexts(c, srcFilter, dstFilter);
+    return 0;
+}
+
 SwsContext *sws_alloc_set_opts(int srcW, int srcH, enum AVPixelFormat srcFormat,
                                int dstW, int dstH, enum AVPixelFormat dstFormat,
                                int flags, const double *param)
@@ -2312,23 +2532,20 @@ void sws_freeContext(SwsContext *c)
     if (!c)
         return;
 
+    free_slice_contexts(c);
+
     for (i = 0; i < 4; i++)
         av_freep(&c->dither_error[i]);
 
-    av_freep(&c->vLumFilter);
-    av_freep(&c->vChrFilter);
-    av_freep(&c->hLumFilter);
-    av_freep(&c->hChrFilter);
+    free_filter(&c->filter_buf[0], &c->hLumFilter, &c->hLumFilterPos);
+    free_filter(&c->filter_buf[1], &c->hChrFilter, &c->hChrFilterPos);
+    free_filter(&c->filter_buf[2], &c->vLumFilter, &c->vLumFilterPos);
+    free_filter(&c->filter_buf[3], &c->vChrFilter, &c->vChrFilterPos);
 #if HAVE_ALTIVEC
     av_freep(&c->vYCoeffsBank);
     av_freep(&c->vCCoeffsBank);
 #endif
 
-    av_freep(&c->vLumFilterPos);
-    av_freep(&c->vChrFilterPos);
-    av_freep(&c->hLumFilterPos);
-    av_freep(&c->hChrFilterPos);
-
 #if HAVE_MMX_INLINE
 #if USE_MMAP
     if (c->lumMmxextFilterCode)
@@ -76,6 +76,17 @@ rgb_UVrnd:       times 4 dd 0x400100       ; 128.5 << 15
 ; rgb_Vcoeff_12x4: times 2 dw RV, GV, 0, RV
 ; rgb_Vcoeff_3x56: times 2 dw BV, 0, GV, BV
 
+; the C coefficients at the start of the table, one dword each
+%define ry_coeff 4*0 + tableq
+%define gy_coeff 4*1 + tableq
+%define by_coeff 4*2 + tableq
+%define ru_coeff 4*3 + tableq
+%define gu_coeff 4*4 + tableq
+%define bu_coeff 4*5 + tableq
+%define rv_coeff 4*6 + tableq
+%define gv_coeff 4*7 + tableq
+%define bv_coeff 4*8 + tableq
+
 ; rgba_Ycoeff_rb:  times 4 dw RY, BY
 ; rgba_Ycoeff_br:  times 4 dw BY, RY
 ; rgba_Ycoeff_ga:  times 4 dw GY, 0
@@ -738,3 +749,158 @@ YUYV_TO_UV_FN 3, uyvy, 1
 NVXX_TO_UV_FN 5, nv12
 NVXX_TO_UV_FN 5, nv21
 %endif
+
+;-----------------------------------------------------------------------------
+; Planar GBR with 9 to 14 bits per component to Y/UV/A.
+;
+; void planar_rgb<bpc>le_to_y_<opt>(uint8_t *dst, const uint8_t *src[4],
+;                                   int w, int32_t *table);
+; void planar_rgb<bpc>le_to_uv_<opt>(uint8_t *dstU, uint8_t *dstV,
+;                                    const uint8_t *src[4], int w,
+;                                    int32_t *table);
+; void planar_rgb<bpc>le_to_a_<opt>(uint8_t *dst, const uint8_t *src[4],
+;                                   int w, int32_t *table);
+;
+; Components fit in a signed word, so R and G are interleaved and multiplied
+; by { RY, GY } pairs with pmaddwd. B is zero-extended to dwords, so loading
+; BY as a dword multiplies it by BY and its zero high half by the sign word.
+;-----------------------------------------------------------------------------
+
+; %1 = dst register, %2 = r coefficient, %3 = g coefficient, %4 = tmp register
+%macro LOAD_RG_COEFF 4
+    vpbroadcastw   %1, [%2]
+    vpbroadcastw   %4, [%3]
+    vpblendw       %1, %1, %4, 0xaa       ; (word) { RC, GC } x 8
+%endmacro
+
+; %1 = bits per component
+%macro PLANAR_RGB_TO_Y_FN 1
+cglobal planar_rgb%1le_to_y, 4, 8, 8, dst, src, w, table, g, b, r, tmp
+    mov            gq, [srcq+0*gprsize]
+    mov            bq, [srcq+1*gprsize]
+    mov            rq, [srcq+2*gprsize]
+    LOAD_RG_COEFF  m5, ry_coeff, gy_coeff, m0
+    vpbroadcastd   m6, [by_coeff]
+    mov          tmpd, 33 << (%1 + 6)
+    movd          xm7, tmpd
+    vpbroadcastd   m7, xm7                ; 33 << (RGB2YUV_SHIFT + %1 - 9)
+    pxor           m4, m4
+    movsxd         wq, wd
+    lea            gq, [gq+wq*2]
+    lea            bq, [bq+wq*2]
+    lea            rq, [rq+wq*2]
+    lea          dstq, [dstq+wq*2]
+    neg            wq
+.loop:
+    movu           m0, [rq+wq*2]          ; (word) { R0, ..., R15 }
+    movu           m1, [gq+wq*2]          ; (word) { G0, ..., G15 }
+    movu           m2, [bq+wq*2]          ; (word) { B0, ..., B15 }
+    punpcklwd      m3, m0, m1             ; (word) { R0, G0, ..., R3, G3 | R8, G8, ... }
+    punpckhwd      m0, m1                 ; (word) { R4, G4, ..., R7, G7 | R12, G12, ... }
+    punpcklwd      m1, m2, m4             ; (dword) { B0, ..., B3 | B8, ..., B11 }
+    punpckhwd      m2, m4                 ; (dword) { B4, ..., B7 | B12, ..., B15 }
+    pmaddwd        m3, m5
+    pmaddwd        m0, m5
+    pmaddwd        m1, m6
+    pmaddwd        m2, m6
+    paddd          m3, m1
+    paddd          m0, m2
+    paddd          m3, m7
+    paddd          m0, m7
+    psrad          m3, %1 + 1
+    psrad          m0, %1 + 1
+    packusdw       m3, m0                 ; (word) { Y0, ..., Y15 }
+    movu [dstq+wq*2], m3
+    add            wq, mmsize / 2
+    jl .loop
+    RET
+%endmacro
+
+; %1 = bits per component
+%macro PLANAR_RGB_TO_UV_FN 1
+cglobal planar_rgb%1le_to_uv, 5, 9, 13, dstU, dstV, src, w, table, g, b, r, tmp
+    mov            gq, [srcq+0*gprsize]
+    mov            bq, [srcq+1*gprsize]
+    mov            rq, [srcq+2*gprsize]
+    LOAD_RG_COEFF  m7, ru_coeff, gu_coeff, m0
+    LOAD_RG_COEFF  m9, rv_coeff, gv_coeff, m0
+    vpbroadcastd   m8, [bu_coeff]
+    vpbroadcastd  m10, [bv_coeff]
+    mov          tmpd, 257 << (%1 + 6)
+    movd         xm11, tmpd
+    vpbroadcastd  m11, xm11               ; 257 << (RGB2YUV_SHIFT + %1 - 9)
+    pxor          m12, m12
+    movsxd         wq, wd
+    lea            gq, [gq+wq*2]
+    lea            bq, [bq+wq*2]
+    lea            rq, [rq+wq*2]
+    lea         dstUq, [dstUq+wq*2]
+    lea         dstVq, [dstVq+wq*2]
+    neg            wq
+.loop:
+    movu           m0, [rq+wq*2]
+    movu           m1, [gq+wq*2]
+    movu           m2, [bq+wq*2]
+    punpcklwd      m3, m0, m1             ; (word) { R0, G0, ..., R3, G3 | R8, G8, ... }
+    punpckhwd      m0, m1                 ; (word) { R4, G4, ..., R7, G7 | R12, G12, ... }
+    punpcklwd      m1, m2, m12            ; (dword) { B0, ..., B3 | B8, ..., B11 }
+    punpckhwd      m2, m12                ; (dword) { B4, ..., B7 | B12, ..., B15 }
+    pmaddwd        m4, m3, m7
+    pmaddwd        m5, m0, m7
+    pmaddwd        m3, m9
+    pmaddwd        m0, m9
+    pmaddwd        m6, m1, m8
+    pmaddwd        m1, m10
+    paddd          m4, m6
+    paddd          m3, m1
+    pmaddwd        m6, m2, m8
+    pmaddwd        m2, m10
+    paddd          m5, m6
+    paddd          m0, m2
+    paddd          m4, m11
+    paddd          m5, m11
+    paddd          m3, m11
+    paddd          m0, m11
+    psrad          m4, %1 + 1
+    psrad          m5, %1 + 1
+    psrad          m3, %1 + 1
+    psrad          m0, %1 + 1
+    packusdw       m4, m5                 ; (word) { U0, ..., U15 }
+    packusdw       m3, m0                 ; (word) { V0, ..., V15 }
+    movu [dstUq+wq*2], m4
+    movu [dstVq+wq*2], m3
+    add            wq, mmsize / 2
+    jl .loop
+    RET
+%endmacro
+
+; %1 = bits per component
+%macro PLANAR_RGB_TO_A_FN 1
+cglobal planar_rgb%1le_to_a, 3, 4, 1, dst, src, w, a
+    mov            aq, [srcq+3*gprsize]
+    movsxd         wq, wd
+    lea            aq, [aq+wq*2]
+    lea          dstq, [dstq+wq*2]
+    neg            wq
+.loop:
+    movu           m0, [aq+wq*2]
+    psllw          m0, 14 - %1
+    movu [dstq+wq*2], m0
+    add            wq, mmsize / 2
+    jl .loop
+    RET
+%endmacro
+
+%if ARCH_X86_64 && HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+PLANAR_RGB_TO_Y_FN   9
+PLANAR_RGB_TO_Y_FN  10
+PLANAR_RGB_TO_Y_FN  12
+PLANAR_RGB_TO_Y_FN  14
+PLANAR_RGB_TO_UV_FN  9
+PLANAR_RGB_TO_UV_FN 10
+PLANAR_RGB_TO_UV_FN 12
+PLANAR_RGB_TO_UV_FN 14
+PLANAR_RGB_TO_A_FN  10
+PLANAR_RGB_TO_A_FN  12
+%endif
@@ -22,20 +22,24 @@
 
 %include "libavutil/x86/x86util.asm"
 
-SECTION_RODATA
-
-minshort:      times 8 dw 0x8000
-yuv2yuvX_16_start:  times 4 dd 0x4000 - 0x40000000
-yuv2yuvX_10_start:  times 4 dd 0x10000
-yuv2yuvX_9_start:   times 4 dd 0x20000
-yuv2yuvX_10_upper:  times 8 dw 0x3ff
-yuv2yuvX_9_upper:   times 8 dw 0x1ff
-pd_4:          times 4 dd 4
-pd_4min0x40000:times 4 dd 4 - (0x40000)
-pw_16:         times 8 dw 16
-pw_32:         times 8 dw 32
-pw_512:        times 8 dw 512
-pw_1024:       times 8 dw 1024
+SECTION_RODATA 32
+
+minshort:      times 16 dw 0x8000
+yuv2yuvX_16_start:  times 8 dd 0x4000 - 0x40000000
+yuv2yuvX_12_start:  times 8 dd 0x4000
+yuv2yuvX_10_start:  times 8 dd 0x10000
+yuv2yuvX_9_start:   times 8 dd 0x20000
+yuv2yuvX_12_upper:  times 16 dw 0xfff
+yuv2yuvX_10_upper:  times 16 dw 0x3ff
+yuv2yuvX_9_upper:   times 16 dw 0x1ff
+pd_4:          times 8 dd 4
+pd_4min0x40000:times 8 dd 4 - (0x40000)
+pw_4:          times 16 dw 4
+pw_16:         times 16 dw 16
+pw_32:         times 16 dw 32
+pw_512:        times 16 dw 512
+pw_1024:       times 16 dw 1024
+pw_4096:       times 16 dw 4096
 
 SECTION .text
 
@@ -50,7 +54,7 @@ SECTION .text
 ;                                     const uint8_t *dither, int offset)
 ;
 ; Scale one or $filterSize lines of source data to generate one line of output
-; data. The input is 15 bits in int16_t if $output_size is [8,10] and 19 bits in
+; data. The input is 15 bits in int16_t if $output_size is [8,12] and 19 bits in
 ; int32_t if $output_size is 16. $filter is 12 bits. $filterSize is a multiple
 ; of 2. $offset is either 0 or 3. $dither holds 8 values.
 ;-----------------------------------------------------------------------------
@@ -77,10 +81,10 @@ SECTION .text
     mova            m2,  m8
     mova            m1,  m_dith
 %endif ; x86-32/64
-%else ; %1 == 9/10/16
+%else ; %1 == 9/10/12/16
     mova            m1, [yuv2yuvX_%1_start]
     mova            m2,  m1
-%endif ; %1 == 8/9/10/16
+%endif ; %1 == 8/9/10/12/16
     movsx     cntr_reg,  fltsizem
 .filterloop_%2_ %+ %%i:
     ; input pixels
@@ -88,19 +92,27 @@ SECTION .text
 %if %1 == 16
     mova            m3, [r6+r5*4]
     mova            m5, [r6+r5*4+mmsize]
-%else ; %1 == 8/9/10
+%elif mmsize == 32 ; V lines are only 16-byte aligned
+    movu            m3, [r6+r5*2]
+%else ; %1 == 8/9/10/12
     mova            m3, [r6+r5*2]
-%endif ; %1 == 8/9/10/16
+%endif ; %1 == 8/9/10/12/16
     mov             r6, [srcq+gprsize*cntr_reg-gprsize]
 %if %1 == 16
     mova            m4, [r6+r5*4]
     mova            m6, [r6+r5*4+mmsize]
-%else ; %1 == 8/9/10
+%elif mmsize == 32
+    movu            m4, [r6+r5*2]
+%else ; %1 == 8/9/10/12
     mova            m4, [r6+r5*2]
-%endif ; %1 == 8/9/10/16
+%endif ; %1 == 8/9/10/12/16
 
     ; coefficients
+%if cpuflag(avx2)
+    vpbroadcastd    m0, [filterq+2*cntr_reg-4] ; coeff[0], coeff[1]
+%else
     movd            m0, [filterq+2*cntr_reg-4] ; coeff[0], coeff[1]
+%endif
 %if %1 == 16
     pshuflw         m7,  m0,  0          ; coeff[0]
     pshuflw         m0,  m0,  0x55       ; coeff[1]
@@ -116,10 +128,12 @@ SECTION .text
     paddd           m1,  m5
     paddd           m2,  m4
     paddd           m1,  m6
-%else ; %1 == 10/9/8
+%else ; %1 == 12/10/9/8
     punpcklwd       m5,  m3,  m4
     punpckhwd       m3,  m4
+%if notcpuflag(avx2)
     SPLATD          m0
+%endif
 
     pmaddwd         m5,  m0
     pmaddwd         m3,  m0
@@ -134,30 +148,32 @@ SECTION .text
 %if %1 == 16
     psrad           m2,  31 - %1
     psrad           m1,  31 - %1
-%else ; %1 == 10/9/8
+%else ; %1 == 12/10/9/8
     psrad           m2,  27 - %1
     psrad           m1,  27 - %1
-%endif ; %1 == 8/9/10/16
+%endif ; %1 == 8/9/10/12/16
 
 %if %1 == 8
     packssdw        m2,  m1
     packuswb        m2,  m2
     movh   [dstq+r5*1],  m2
-%else ; %1 == 9/10/16
+%else ; %1 == 9/10/12/16
 %if %1 == 16
     packssdw        m2,  m1
     paddw           m2, [minshort]
-%else ; %1 == 9/10
+%else ; %1 == 9/10/12
 %if cpuflag(sse4)
+    ; 12-bit sums can exceed 0x7fff, so clip them as unsigned
     packusdw        m2,  m1
+    pminuw          m2, [yuv2yuvX_%1_upper]
 %else ; mmxext/sse2
     packssdw        m2,  m1
     pmaxsw          m2,  m6
-%endif ; mmxext/sse2/sse4/avx
     pminsw          m2, [yuv2yuvX_%1_upper]
-%endif ; %1 == 9/10/16
+%endif ; mmxext/sse2/sse4/avx/avx2
+%endif ; %1 == 9/10/12/16
     mov%2   [dstq+r5*2],  m2
-%endif ; %1 == 8/9/10/16
+%endif ; %1 == 8/9/10/12/16
 
     add             r5,  mmsize/2
     sub             wd,  mmsize/2
@@ -178,9 +194,9 @@ SECTION .text
 %endif
 
 cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
-%if %1 == 8 || %1 == 9 || %1 == 10
+%if %1 == 8 || %1 == 9 || %1 == 10 || %1 == 12
     pxor            m6,  m6
-%endif ; %1 == 8/9/10
+%endif ; %1 == 8/9/10/12
 
 %if %1 == 8
 %if ARCH_X86_32
@@ -237,14 +253,14 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 
 %if mmsize == 8 || %1 == 8
     yuv2planeX_mainloop %1, a
-%else ; mmsize == 16
-    test          dstq, 15
+%else ; mmsize == 16/32
+    test          dstq, mmsize - 1
     jnz .unaligned
     yuv2planeX_mainloop %1, a
     REP_RET
 .unaligned:
     yuv2planeX_mainloop %1, u
-%endif ; mmsize == 8/16
+%endif ; mmsize == 8/16/32
 
 %if %1 == 8
 %if ARCH_X86_32
@@ -253,9 +269,9 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 %else ; x86-64
     REP_RET
 %endif ; x86-32/64
-%else ; %1 == 9/10/16
+%else ; %1 == 9/10/12/16
     REP_RET
-%endif ; %1 == 8/9/10/16
+%endif ; %1 == 8/9/10/12/16
 %endmacro
 
 %if ARCH_X86_32
@@ -263,17 +279,20 @@ INIT_MMX mmxext
 yuv2planeX_fn  8,  0, 7
 yuv2planeX_fn  9,  0, 5
 yuv2planeX_fn 10,  0, 5
+yuv2planeX_fn 12,  0, 5
 %endif
 
 INIT_XMM sse2
 yuv2planeX_fn  8, 10, 7
 yuv2planeX_fn  9,  7, 5
 yuv2planeX_fn 10,  7, 5
+yuv2planeX_fn 12,  7, 5
 
 INIT_XMM sse4
 yuv2planeX_fn  8, 10, 7
 yuv2planeX_fn  9,  7, 5
 yuv2planeX_fn 10,  7, 5
+yuv2planeX_fn 12,  7, 5
 yuv2planeX_fn 16,  8, 5
 
 %if HAVE_AVX_EXTERNAL
@@ -281,6 +300,15 @@ INIT_XMM avx
 yuv2planeX_fn  8, 10, 7
 yuv2planeX_fn  9,  7, 5
 yuv2planeX_fn 10,  7, 5
+yuv2planeX_fn 12,  7, 5
+%endif
+
+; 8 and 16 bit outputs would need their packs fixed up across lanes
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+yuv2planeX_fn  9,  7, 5
+yuv2planeX_fn 10,  7, 5
+yuv2planeX_fn 12,  7, 5
 %endif
 
 ; %1=outout-bpc, %2=alignment (u/a)
@@ -313,7 +341,13 @@ yuv2planeX_fn 10,  7, 5
 %endif ; mmx/sse2/sse4/avx
     mov%2    [dstq+wq*2+mmsize*0], m0
     mov%2    [dstq+wq*2+mmsize*1], m2
-%else ; %1 == 9/10
+%elif mmsize == 32 ; %1 == 9/10/12, one ymm of 16 pixels per iteration
+    paddsw          m0, m2, [srcq+wq*2]
+    psraw           m0, 15 - %1
+    pmaxsw          m0, m4
+    pminsw          m0, m3
+    mov%2    [dstq+wq*2], m0
+%else ; %1 == 9/10/12
     paddsw          m0, m2, [srcq+wq*2+mmsize*0]
     paddsw          m1, m2, [srcq+wq*2+mmsize*1]
     psraw           m0, 15 - %1
@@ -325,15 +359,22 @@ yuv2planeX_fn 10,  7, 5
     mov%2    [dstq+wq*2+mmsize*0], m0
     mov%2    [dstq+wq*2+mmsize*1], m1
 %endif
-    add             wq, mmsize
+    add             wq, PLANE1_STEP
     jl .loop_%2
 %endmacro
 
 %macro yuv2plane1_fn 3
+; the ymm versions only store 16 pixels per iteration, so that they do not
+; write further past the width than the xmm ones
+%if mmsize == 32
+%define PLANE1_STEP 16
+%else
+%define PLANE1_STEP mmsize
+%endif
 cglobal yuv2plane1_%1, %3, %3, %2, src, dst, w, dither, offset
     movsxdifnidn    wq, wd
-    add             wq, mmsize - 1
-    and             wq, ~(mmsize - 1)
+    add             wq, PLANE1_STEP - 1
+    and             wq, ~(PLANE1_STEP - 1)
 %if %1 == 8
     add           dstq, wq
 %else ; %1 != 8
@@ -374,6 +415,10 @@ cglobal yuv2plane1_%1, %3, %3, %2, src, dst, w, dither, offset
     pxor            m4, m4
     mova            m3, [pw_1024]
     mova            m2, [pw_16]
+%elif %1 == 12
+    pxor            m4, m4
+    mova            m3, [pw_4096]
+    mova            m2, [pw_4]
 %else ; %1 == 16
 %if cpuflag(sse4) ; sse4/avx
     mova            m4, [pd_4]
@@ -386,14 +431,14 @@ cglobal yuv2plane1_%1, %3, %3, %2, src, dst, w, dither, offset
     ; actual pixel scaling
 %if mmsize == 8
     yuv2plane1_mainloop %1, a
-%else ; mmsize == 16
-    test          dstq, 15
+%else ; mmsize == 16/32
+    test          dstq, mmsize - 1
     jnz .unaligned
     yuv2plane1_mainloop %1, a
     REP_RET
 .unaligned:
     yuv2plane1_mainloop %1, u
-%endif ; mmsize == 8/16
+%endif ; mmsize == 8/16/32
     REP_RET
 %endmacro
 
@@ -405,12 +450,14 @@ yuv2plane1_fn 16, 0, 3
 INIT_MMX mmxext
 yuv2plane1_fn  9, 0, 3
 yuv2plane1_fn 10, 0, 3
+yuv2plane1_fn 12, 0, 3
 %endif
 
 INIT_XMM sse2
 yuv2plane1_fn  8, 5, 5
 yuv2plane1_fn  9, 5, 3
 yuv2plane1_fn 10, 5, 3
+yuv2plane1_fn 12, 5, 3
 yuv2plane1_fn 16, 6, 3
 
 INIT_XMM sse4
@@ -421,5 +468,13 @@ INIT_XMM avx
 yuv2plane1_fn  8, 5, 5
 yuv2plane1_fn  9, 5, 3
 yuv2plane1_fn 10, 5, 3
+yuv2plane1_fn 12, 5, 3
 yuv2plane1_fn 16, 5, 3
 %endif
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+yuv2plane1_fn  9, 5, 3
+yuv2plane1_fn 10, 5, 3
+yuv2plane1_fn 12, 5, 3
+%endif
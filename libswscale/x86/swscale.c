@@ -323,7 +323,8 @@ void ff_yuv2planeX_ ## size ## _ ## opt(const int16_t *filter, int filterSize, \
 #define VSCALEX_FUNCS(opt) \
     VSCALEX_FUNC(8,  opt); \
     VSCALEX_FUNC(9,  opt); \
-    VSCALEX_FUNC(10, opt)
+    VSCALEX_FUNC(10, opt); \
+    VSCALEX_FUNC(12, opt)
 
 #if ARCH_X86_32
 VSCALEX_FUNCS(mmxext);
@@ -332,6 +333,9 @@ VSCALEX_FUNCS(sse2);
 VSCALEX_FUNCS(sse4);
 VSCALEX_FUNC(16, sse4);
 VSCALEX_FUNCS(avx);
+VSCALEX_FUNC(9,  avx2);
+VSCALEX_FUNC(10, avx2);
+VSCALEX_FUNC(12, avx2);
 
 #define VSCALE_FUNC(size, opt) \
 void ff_yuv2plane1_ ## size ## _ ## opt(const int16_t *src, uint8_t *dst, int dstW, \
@@ -340,6 +344,7 @@ void ff_yuv2plane1_ ## size ## _ ## opt(const int16_t *src, uint8_t *dst, int ds
     VSCALE_FUNC(8,  opt1); \
     VSCALE_FUNC(9,  opt2); \
     VSCALE_FUNC(10, opt2); \
+    VSCALE_FUNC(12, opt2); \
     VSCALE_FUNC(16, opt1)
 
 #if ARCH_X86_32
@@ -348,6 +353,9 @@ VSCALE_FUNCS(mmx, mmxext);
 VSCALE_FUNCS(sse2, sse2);
 VSCALE_FUNC(16, sse4);
 VSCALE_FUNCS(avx, avx);
+VSCALE_FUNC(9,  avx2);
+VSCALE_FUNC(10, avx2);
+VSCALE_FUNC(12, avx2);
 
 #define INPUT_Y_FUNC(fmt, opt) \
 void ff_ ## fmt ## ToY_  ## opt(uint8_t *dst, const uint8_t *src, \
@@ -381,6 +389,22 @@ INPUT_FUNCS(sse2);
 INPUT_FUNCS(ssse3);
 INPUT_FUNCS(avx);
 
+#define INPUT_PLANAR_RGB_FUNCS(bpc, opt) \
+void ff_planar_rgb ## bpc ## le_to_y_ ## opt(uint8_t *dst, const uint8_t *src[4], \
+                                             int w, int32_t *rgb2yuv); \
+void ff_planar_rgb ## bpc ## le_to_uv_ ## opt(uint8_t *dstU, uint8_t *dstV, \
+                                              const uint8_t *src[4], int w, \
+                                              int32_t *rgb2yuv)
+#define INPUT_PLANAR_RGBA_FUNCS(bpc, opt) \
+    INPUT_PLANAR_RGB_FUNCS(bpc, opt); \
+void ff_planar_rgb ## bpc ## le_to_a_ ## opt(uint8_t *dst, const uint8_t *src[4], \
+                                             int w, int32_t *rgb2yuv)
+
+INPUT_PLANAR_RGB_FUNCS(9,   avx2);
+INPUT_PLANAR_RGBA_FUNCS(10, avx2);
+INPUT_PLANAR_RGBA_FUNCS(12, avx2);
+INPUT_PLANAR_RGB_FUNCS(14,  avx2);
+
 av_cold void ff_sws_init_swscale_x86(SwsContext *c)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -429,6 +453,7 @@ av_cold void ff_sws_init_swscale_x86(SwsContext *c)
 #define ASSIGN_VSCALEX_FUNC(vscalefn, opt, do_16_case, condition_8bit) \
 switch(c->dstBpc){ \
     case 16:                          do_16_case;                          break; \
+    case 12: if (!isBE(c->dstFormat)) vscalefn = ff_yuv2planeX_12_ ## opt; break; \
     case 10: if (!isBE(c->dstFormat) && c->dstFormat != AV_PIX_FMT_P010LE) vscalefn = ff_yuv2planeX_10_ ## opt; break; \
     case 9:  if (!isBE(c->dstFormat)) vscalefn = ff_yuv2planeX_9_  ## opt; break; \
     case 8: if ((condition_8bit) && !c->use_mmx_vfilter) vscalefn = ff_yuv2planeX_8_  ## opt; break; \
@@ -436,6 +461,7 @@ switch(c->dstBpc){ \
 #define ASSIGN_VSCALE_FUNC(vscalefn, opt1, opt2, opt2chk) \
     switch(c->dstBpc){ \
     case 16: if (!isBE(c->dstFormat))            vscalefn = ff_yuv2plane1_16_ ## opt1; break; \
+    case 12: if (!isBE(c->dstFormat) && opt2chk) vscalefn = ff_yuv2plane1_12_ ## opt2; break; \
     case 10: if (!isBE(c->dstFormat) && c->dstFormat != AV_PIX_FMT_P010LE && opt2chk) vscalefn = ff_yuv2plane1_10_ ## opt2; break; \
     case 9:  if (!isBE(c->dstFormat) && opt2chk) vscalefn = ff_yuv2plane1_9_  ## opt2;  break; \
     case 8:                                      vscalefn = ff_yuv2plane1_8_  ## opt1;  break; \
@@ -581,4 +607,44 @@ switch(c->dstBpc){ \
             break;
         }
     }
+
+#define case_planar_rgb(bpc, opt) \
+        case AV_PIX_FMT_GBRP ## bpc ## LE: \
+            c->readLumPlanar = ff_planar_rgb ## bpc ## le_to_y_ ## opt; \
+            c->readChrPlanar = ff_planar_rgb ## bpc ## le_to_uv_ ## opt; \
+            break
+#define case_planar_rgba(bpc, opt) \
+        case AV_PIX_FMT_GBRAP ## bpc ## LE: \
+            c->readAlpPlanar = ff_planar_rgb ## bpc ## le_to_a_ ## opt; \
+        case_planar_rgb(bpc, opt)
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        if (!isBE(c->dstFormat)) {
+            switch (c->dstBpc) {
+            case 12:
+                c->yuv2planeX = ff_yuv2planeX_12_avx2;
+                c->yuv2plane1 = ff_yuv2plane1_12_avx2;
+                break;
+            case 10:
+                if (c->dstFormat == AV_PIX_FMT_P010LE)
+                    break;
+                c->yuv2planeX = ff_yuv2planeX_10_avx2;
+                c->yuv2plane1 = ff_yuv2plane1_10_avx2;
+                break;
+            case 9:
+                c->yuv2planeX = ff_yuv2planeX_9_avx2;
+                c->yuv2plane1 = ff_yuv2plane1_9_avx2;
+                break;
+            }
+        }
+#if ARCH_X86_64
+        switch (c->srcFormat) {
+        case_planar_rgb(9,   avx2);
+        case_planar_rgba(10, avx2);
+        case_planar_rgba(12, avx2);
+        case_planar_rgb(14,  avx2);
+        default:
+            break;
+        }
+#endif
+    }
 }
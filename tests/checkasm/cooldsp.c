@@ -0,0 +1,137 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#include "libavcodec/cooldsp.h"
+
+#include "checkasm.h"
+
+#define WIDTH 256
+
+#define randomize_buffers(buf, size)     \
+    do {                                 \
+        int j;                           \
+        for (j = 0; j < size; j++)       \
+            buf[j] = rnd();              \
+    } while (0)
+
+static void check_planar_to_rgb8(const CoolDSPContext *c, const CoolDither *d)
+{
+    LOCAL_ALIGNED_32(uint8_t, r,    [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, g,    [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, b,    [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [WIDTH]);
+    declare_func(void, uint8_t *dst, const uint8_t *r, const uint8_t *g,
+                 const uint8_t *b, const CoolDither *dither, ptrdiff_t width);
+
+    randomize_buffers(r, WIDTH);
+    randomize_buffers(g, WIDTH);
+    randomize_buffers(b, WIDTH);
+
+    if (check_func(c->planar_to_rgb8, "cool_planar_to_rgb8")) {
+        int w;
+
+        for (w = COOL_DSP_ALIGN; w <= WIDTH; w += COOL_DSP_ALIGN) {
+            memset(dst0, 0, WIDTH);
+            memset(dst1, 0, WIDTH);
+            call_ref(dst0, r, g, b, d, w);
+            call_new(dst1, r, g, b, d, w);
+            if (memcmp(dst0, dst1, WIDTH))
+                fail();
+        }
+        bench_new(dst1, r, g, b, d, WIDTH);
+    }
+}
+
+static void check_rgba_to_rgb8(const CoolDSPContext *c, const CoolDither *d)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [WIDTH * 4]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [WIDTH]);
+    declare_func(void, uint8_t *dst, const uint8_t *src,
+                 const CoolDither *dither, ptrdiff_t width);
+
+    randomize_buffers(src, WIDTH * 4);
+
+    if (check_func(c->rgba_to_rgb8, "cool_rgba_to_rgb8")) {
+        int w;
+
+        for (w = COOL_DSP_ALIGN; w <= WIDTH; w += COOL_DSP_ALIGN) {
+            memset(dst0, 0, WIDTH);
+            memset(dst1, 0, WIDTH);
+            call_ref(dst0, src, d, w);
+            call_new(dst1, src, d, w);
+            if (memcmp(dst0, dst1, WIDTH))
+                fail();
+        }
+        bench_new(dst1, src, d, WIDTH);
+    }
+}
+
+static void check_packed24_to_rgb8(void (*func)(uint8_t *dst, const uint8_t *src,
+                                                const CoolDither *dither, ptrdiff_t width),
+                                   const char *name, const CoolDither *d)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [WIDTH * 3]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [WIDTH]);
+    declare_func(void, uint8_t *dst, const uint8_t *src,
+                 const CoolDither *dither, ptrdiff_t width);
+
+    randomize_buffers(src, WIDTH * 3);
+
+    if (check_func(func, "%s", name)) {
+        int w;
+
+        for (w = COOL_DSP_ALIGN; w <= WIDTH; w += COOL_DSP_ALIGN) {
+            memset(dst0, 0, WIDTH);
+            memset(dst1, 0, WIDTH);
+            call_ref(dst0, src, d, w);
+            call_new(dst1, src, d, w);
+            if (memcmp(dst0, dst1, WIDTH))
+                fail();
+        }
+        bench_new(dst1, src, d, WIDTH);
+    }
+}
+
+void checkasm_check_cooldsp(void)
+{
+    LOCAL_ALIGNED_32(CoolDither, d, [1]);
+    CoolDSPContext c;
+
+    ff_cooldsp_init(&c);
+    ff_cool_init_dither(d, rnd() & 7, 1);
+
+    check_planar_to_rgb8(&c, d);
+    report("planar_to_rgb8");
+
+    check_rgba_to_rgb8(&c, d);
+    report("rgba_to_rgb8");
+
+    check_packed24_to_rgb8(c.rgb24_to_rgb8, "cool_rgb24_to_rgb8", d);
+    report("rgb24_to_rgb8");
+
+    check_packed24_to_rgb8(c.bgr24_to_rgb8, "cool_bgr24_to_rgb8", d);
+    report("bgr24_to_rgb8");
+}
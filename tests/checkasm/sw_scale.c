@@ -0,0 +1,286 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+#include "checkasm.h"
+
+#define MAX_WIDTH   512
+/* the SIMD functions read and write whole registers past the width */
+#define LINE_SIZE   (MAX_WIDTH + 32)
+#define MAX_FILTER  16
+
+static const int widths[] = { 1, 15, 16, 17, 100, 333, MAX_WIDTH };
+
+static const uint8_t dither[8] = { 0 };
+
+/* A different output size keeps sws from picking an unscaled converter. */
+static SwsContext *get_context(enum AVPixelFormat src_fmt,
+                               enum AVPixelFormat dst_fmt)
+{
+    return sws_getContext(MAX_WIDTH, 16, src_fmt, MAX_WIDTH / 2, 8, dst_fmt,
+                          SWS_BILINEAR, NULL, NULL, NULL);
+}
+
+static const enum AVPixelFormat yuv_fmts[] = {
+    AV_PIX_FMT_YUV420P9LE, AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_YUV420P12LE,
+};
+
+static void check_yuv2plane1(void)
+{
+    LOCAL_ALIGNED_32(int16_t,  src,  [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dst0, [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dst1, [LINE_SIZE]);
+    declare_func(void, const int16_t *src, uint8_t *dst, int dstW,
+                 const uint8_t *dither, int offset);
+    int i, j, k;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(yuv_fmts); i++) {
+        int bits = av_pix_fmt_desc_get(yuv_fmts[i])->comp[0].depth;
+        SwsContext *c = get_context(AV_PIX_FMT_YUV420P, yuv_fmts[i]);
+
+        if (!c) {
+            fail();
+            continue;
+        }
+        if (check_func(c->yuv2plane1, "yuv2plane1_%d", bits)) {
+            for (j = 0; j < FF_ARRAY_ELEMS(widths); j++) {
+                /* the full int16_t range also covers both clips */
+                for (k = 0; k < LINE_SIZE; k++)
+                    src[k] = rnd();
+                memset(dst0, 0, LINE_SIZE * sizeof(*dst0));
+                memset(dst1, 0, LINE_SIZE * sizeof(*dst1));
+
+                call_ref(src, (uint8_t *)dst0, widths[j], dither, 0);
+                call_new(src, (uint8_t *)dst1, widths[j], dither, 0);
+                if (memcmp(dst0, dst1, widths[j] * sizeof(*dst0)))
+                    fail();
+                /* the width may only be rounded up to 16 pixels */
+                k = FFALIGN(widths[j], 16);
+                if (memcmp(dst0 + k, dst1 + k, (LINE_SIZE - k) * sizeof(*dst0)))
+                    fail();
+            }
+            bench_new(src, (uint8_t *)dst1, MAX_WIDTH, dither, 0);
+        }
+        sws_freeContext(c);
+    }
+    report("yuv2plane1");
+}
+
+static void check_yuv2planeX(void)
+{
+    LOCAL_ALIGNED_32(int16_t,  pixels, [MAX_FILTER * LINE_SIZE]);
+    LOCAL_ALIGNED_16(int16_t,  filter, [MAX_FILTER]);
+    LOCAL_ALIGNED_32(uint16_t, dst0,   [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dst1,   [LINE_SIZE]);
+    const int16_t *src[MAX_FILTER];
+    declare_func(void, const int16_t *filter, int filterSize,
+                 const int16_t **src, uint8_t *dst, int dstW,
+                 const uint8_t *dither, int offset);
+    int i, j, k, size;
+
+    for (k = 0; k < MAX_FILTER; k++)
+        src[k] = pixels + k * LINE_SIZE;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(yuv_fmts); i++) {
+        int bits = av_pix_fmt_desc_get(yuv_fmts[i])->comp[0].depth;
+        SwsContext *c = get_context(AV_PIX_FMT_YUV420P, yuv_fmts[i]);
+
+        if (!c) {
+            fail();
+            continue;
+        }
+        if (check_func(c->yuv2planeX, "yuv2planeX_%d", bits)) {
+            for (size = 2; size <= MAX_FILTER; size *= 2) {
+                for (j = 0; j < FF_ARRAY_ELEMS(widths); j++) {
+                    /* 15-bit input and 12-bit taps, negative ones included */
+                    for (k = 0; k < MAX_FILTER * LINE_SIZE; k++)
+                        pixels[k] = rnd() & 0x7fff;
+                    for (k = 0; k < size; k++)
+                        filter[k] = (rnd() & 0x1fff) - 0x1000;
+                    memset(dst0, 0, LINE_SIZE * sizeof(*dst0));
+                    memset(dst1, 0, LINE_SIZE * sizeof(*dst1));
+
+                    call_ref(filter, size, src, (uint8_t *)dst0, widths[j], dither, 0);
+                    call_new(filter, size, src, (uint8_t *)dst1, widths[j], dither, 0);
+                    if (memcmp(dst0, dst1, widths[j] * sizeof(*dst0)))
+                        fail();
+                }
+            }
+            bench_new(filter, 8, src, (uint8_t *)dst1, MAX_WIDTH, dither, 0);
+        }
+        sws_freeContext(c);
+    }
+    report("yuv2planeX");
+}
+
+static const enum AVPixelFormat gbr_fmts[] = {
+    AV_PIX_FMT_GBRP9LE,  AV_PIX_FMT_GBRP10LE, AV_PIX_FMT_GBRP12LE,
+    AV_PIX_FMT_GBRP14LE, AV_PIX_FMT_GBRAP10LE, AV_PIX_FMT_GBRAP12LE,
+};
+
+static void randomize_planes(uint16_t *planes, int bits)
+{
+    int k;
+    for (k = 0; k < 4 * LINE_SIZE; k++)
+        planes[k] = rnd() & ((1 << bits) - 1);
+}
+
+static void check_planar_rgb_to_y(void)
+{
+    LOCAL_ALIGNED_32(uint16_t, planes, [4 * LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dst0,   [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dst1,   [LINE_SIZE]);
+    const uint8_t *src[4];
+    declare_func(void, uint8_t *dst, const uint8_t *src[4], int w,
+                 int32_t *rgb2yuv);
+    int i, j, k;
+
+    for (k = 0; k < 4; k++)
+        src[k] = (const uint8_t *)(planes + k * LINE_SIZE);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(gbr_fmts); i++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(gbr_fmts[i]);
+        SwsContext *c = get_context(gbr_fmts[i], AV_PIX_FMT_YUV444P12LE);
+
+        if (!c) {
+            fail();
+            continue;
+        }
+        if (check_func(c->readLumPlanar, "%s_to_y", desc->name)) {
+            for (j = 0; j < FF_ARRAY_ELEMS(widths); j++) {
+                randomize_planes(planes, desc->comp[0].depth);
+                memset(dst0, 0, LINE_SIZE * sizeof(*dst0));
+                memset(dst1, 0, LINE_SIZE * sizeof(*dst1));
+
+                call_ref((uint8_t *)dst0, src, widths[j], c->input_rgb2yuv_table);
+                call_new((uint8_t *)dst1, src, widths[j], c->input_rgb2yuv_table);
+                if (memcmp(dst0, dst1, widths[j] * sizeof(*dst0)))
+                    fail();
+            }
+            bench_new((uint8_t *)dst1, src, MAX_WIDTH, c->input_rgb2yuv_table);
+        }
+        sws_freeContext(c);
+    }
+    report("planar_rgb_to_y");
+}
+
+static void check_planar_rgb_to_uv(void)
+{
+    LOCAL_ALIGNED_32(uint16_t, planes, [4 * LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dstU0,  [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dstV0,  [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dstU1,  [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dstV1,  [LINE_SIZE]);
+    const uint8_t *src[4];
+    declare_func(void, uint8_t *dstU, uint8_t *dstV, const uint8_t *src[4],
+                 int w, int32_t *rgb2yuv);
+    int i, j, k;
+
+    for (k = 0; k < 4; k++)
+        src[k] = (const uint8_t *)(planes + k * LINE_SIZE);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(gbr_fmts); i++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(gbr_fmts[i]);
+        SwsContext *c = get_context(gbr_fmts[i], AV_PIX_FMT_YUV444P12LE);
+
+        if (!c) {
+            fail();
+            continue;
+        }
+        if (check_func(c->readChrPlanar, "%s_to_uv", desc->name)) {
+            for (j = 0; j < FF_ARRAY_ELEMS(widths); j++) {
+                randomize_planes(planes, desc->comp[0].depth);
+                memset(dstU0, 0, LINE_SIZE * sizeof(*dstU0));
+                memset(dstV0, 0, LINE_SIZE * sizeof(*dstV0));
+                memset(dstU1, 0, LINE_SIZE * sizeof(*dstU1));
+                memset(dstV1, 0, LINE_SIZE * sizeof(*dstV1));
+
+                call_ref((uint8_t *)dstU0, (uint8_t *)dstV0, src, widths[j],
+                         c->input_rgb2yuv_table);
+                call_new((uint8_t *)dstU1, (uint8_t *)dstV1, src, widths[j],
+                         c->input_rgb2yuv_table);
+                if (memcmp(dstU0, dstU1, widths[j] * sizeof(*dstU0)) ||
+                    memcmp(dstV0, dstV1, widths[j] * sizeof(*dstV0)))
+                    fail();
+            }
+            bench_new((uint8_t *)dstU1, (uint8_t *)dstV1, src, MAX_WIDTH,
+                      c->input_rgb2yuv_table);
+        }
+        sws_freeContext(c);
+    }
+    report("planar_rgb_to_uv");
+}
+
+static void check_planar_rgb_to_a(void)
+{
+    LOCAL_ALIGNED_32(uint16_t, planes, [4 * LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dst0,   [LINE_SIZE]);
+    LOCAL_ALIGNED_32(uint16_t, dst1,   [LINE_SIZE]);
+    const uint8_t *src[4];
+    declare_func(void, uint8_t *dst, const uint8_t *src[4], int w,
+                 int32_t *rgb2yuv);
+    int i, j, k;
+
+    for (k = 0; k < 4; k++)
+        src[k] = (const uint8_t *)(planes + k * LINE_SIZE);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(gbr_fmts); i++) {
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(gbr_fmts[i]);
+        SwsContext *c;
+
+        if (!(desc->flags & AV_PIX_FMT_FLAG_ALPHA))
+            continue;
+        c = get_context(gbr_fmts[i], AV_PIX_FMT_YUVA444P10LE);
+        if (!c) {
+            fail();
+            continue;
+        }
+        if (check_func(c->readAlpPlanar, "%s_to_a", desc->name)) {
+            for (j = 0; j < FF_ARRAY_ELEMS(widths); j++) {
+                randomize_planes(planes, desc->comp[3].depth);
+                memset(dst0, 0, LINE_SIZE * sizeof(*dst0));
+                memset(dst1, 0, LINE_SIZE * sizeof(*dst1));
+
+                call_ref((uint8_t *)dst0, src, widths[j], c->input_rgb2yuv_table);
+                call_new((uint8_t *)dst1, src, widths[j], c->input_rgb2yuv_table);
+                if (memcmp(dst0, dst1, widths[j] * sizeof(*dst0)))
+                    fail();
+            }
+            bench_new((uint8_t *)dst1, src, MAX_WIDTH, c->input_rgb2yuv_table);
+        }
+        sws_freeContext(c);
+    }
+    report("planar_rgb_to_a");
+}
+
+void checkasm_check_sw_scale(void)
+{
+    check_yuv2plane1();
+    check_yuv2planeX();
+    check_planar_rgb_to_y();
+    check_planar_rgb_to_uv();
+    check_planar_rgb_to_a();
+}
@@ -373,6 +373,24 @@ concat(){
     fi
 }
 
+index_cache(){
+    src=$(target_path $1)
+    shift
+
+    cachedir="${outdir}/${test}.cache"
+    outfile1="${outdir}/${test}.out-1"
+    outfile2="${outdir}/${test}.out-2"
+    cleanfiles="$cleanfiles $outfile1 $outfile2"
+    rm -rf $cachedir && mkdir -p $cachedir || return
+
+    # the first open fills the cache, the second one is served from it
+    ffmpeg -index_cache $(target_path $cachedir) "$@" -i $src -c copy -bitexact -f framecrc -y $(target_path $outfile1) || return
+    echo "cache files: $(set -- $cachedir/*; echo $#)"
+    ffmpeg -index_cache $(target_path $cachedir) "$@" -i $src -c copy -bitexact -f framecrc -y $(target_path $outfile2) || return
+    rm -rf $cachedir
+    cmp $outfile1 $outfile2 && cat $outfile2
+}
+
 null(){
     :
 }
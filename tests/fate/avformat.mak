@@ -7,6 +7,7 @@ FATE_LAVF-$(call ENCDEC,  PCM_S16BE,             AU)                 += au
 FATE_LAVF-$(call ENCDEC2, MPEG4,      MP2,       AVI)                += avi
 FATE_LAVF-$(call ENCDEC,  BMP,                   IMAGE2)             += bmp
 FATE_LAVF-$(call ENCDEC,  PCM_S16BE,             CAF)                += caf
+FATE_LAVF-$(call ENCDEC,  COOL,                  COOLSEQ)            += coolseq
 FATE_LAVF-$(call ENCDEC,  DPX,                   IMAGE2)             += dpx
 FATE_LAVF-$(call ENCDEC2, DVVIDEO,    PCM_S16LE, AVI)                += dv_fmt
 FATE_LAVF-$(call ENCDEC,  FITS,                  FITS)               += fits
@@ -140,3 +141,75 @@ FATE_SEGMENT-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER MATROSK
 FATE_SAMPLES_FFMPEG += $(FATE_SEGMENT-yes)
 
 fate-segment: $(FATE_SEGMENT-yes)
+
+tests/data/index-cache.mkv: TAG = GEN
+tests/data/index-cache.mkv: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i testsrc=d=10:s=160x120 -c:v mpeg4 -g 25 -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+# Opening the same file a second time with the cache filled must give the
+# same packets, also when seeking through the cached index.
+FATE_INDEX_CACHE += fate-index-cache-mkv
+fate-index-cache-mkv: tests/data/index-cache.mkv
+fate-index-cache-mkv: CMD = index_cache tests/data/index-cache.mkv
+
+FATE_INDEX_CACHE += fate-index-cache-mkv-seek
+fate-index-cache-mkv-seek: tests/data/index-cache.mkv
+fate-index-cache-mkv-seek: CMD = index_cache tests/data/index-cache.mkv -ss 6
+
+FATE_INDEX_CACHE-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER MPEG4_ENCODER MATROSKA_MUXER MATROSKA_DEMUXER) += $(FATE_INDEX_CACHE)
+
+FATE_FFMPEG += $(FATE_INDEX_CACHE-yes)
+
+fate-index-cache: $(FATE_INDEX_CACHE-yes)
+
+tests/data/mmap.mov: TAG = GEN
+tests/data/mmap.mov: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i testsrc=d=1:s=320x240 -c:v rawvideo -pix_fmt yuv420p -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+# The 115200 byte frames are large enough to be mapped in zerocopy mode, the
+# packets must be the same as when the file is read.
+FATE_FILE_MMAP += fate-file-mmap-off fate-file-mmap-read fate-file-mmap-zerocopy
+$(FATE_FILE_MMAP): tests/data/mmap.mov
+$(FATE_FILE_MMAP): CMD = framecrc -mmap $(@:fate-file-mmap-%=%) -i $(TARGET_PATH)/tests/data/mmap.mov -c copy
+fate-file-mmap-read fate-file-mmap-zerocopy: REF = $(SRC_PATH)/tests/ref/fate/file-mmap-off
+
+FATE_FILE_MMAP-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER RAWVIDEO_ENCODER MOV_MUXER MOV_DEMUXER FILE_PROTOCOL) += $(FATE_FILE_MMAP)
+
+FATE_FFMPEG += $(FATE_FILE_MMAP-yes)
+
+fate-file-mmap: $(FATE_FILE_MMAP-yes)
+
+tests/data/prefetch.mov: TAG = GEN
+tests/data/prefetch.mov: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i testsrc=d=2:s=160x120 -f lavfi -i sine=d=2 \
+        -c:v mpeg4 -c:a pcm_s16le -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+# Reading ahead with small blocks and several reads in flight must give the
+# same packets as reading synchronously, also when the demuxer jumps between
+# the interleaved audio and video.
+FATE_PREFETCH += fate-prefetch-off
+fate-prefetch-off: CMD = framecrc -i $(TARGET_PATH)/tests/data/prefetch.mov -c copy
+
+FATE_PREFETCH += fate-prefetch-window
+fate-prefetch-window: CMD = framecrc -prefetch_window 65536 -i $(TARGET_PATH)/tests/data/prefetch.mov -c copy
+
+FATE_PREFETCH += fate-prefetch-requests-1
+fate-prefetch-requests-1: CMD = framecrc -prefetch_window 65536 -prefetch_requests 1 -i $(TARGET_PATH)/tests/data/prefetch.mov -c copy
+
+FATE_PREFETCH += fate-prefetch-requests-8
+fate-prefetch-requests-8: CMD = framecrc -prefetch_window 65536 -prefetch_requests 8 -i $(TARGET_PATH)/tests/data/prefetch.mov -c copy
+
+$(FATE_PREFETCH): tests/data/prefetch.mov
+$(filter-out fate-prefetch-off, $(FATE_PREFETCH)): REF = $(SRC_PATH)/tests/ref/fate/prefetch-off
+
+FATE_PREFETCH-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER SINE_FILTER MPEG4_ENCODER PCM_S16LE_ENCODER MOV_MUXER MOV_DEMUXER FILE_PROTOCOL) += $(FATE_PREFETCH)
+
+FATE_FFMPEG += $(FATE_PREFETCH-yes)
+
+fate-prefetch: $(FATE_PREFETCH-yes)
@@ -29,6 +29,11 @@ FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_xml
 fate-ffprobe_xml: $(FFPROBE_TEST_FILE)
 fate-ffprobe_xml: CMD = run $(FFPROBE_COMMAND) -of xml
 
+FATE_FFPROBE-$(CONFIG_AVDEVICE) += fate-ffprobe_default_probe_threads
+fate-ffprobe_default_probe_threads: $(FFPROBE_TEST_FILE)
+fate-ffprobe_default_probe_threads: CMD = run $(FFPROBE_COMMAND) -probe_threads 4 -of default
+fate-ffprobe_default_probe_threads: REF = $(SRC_PATH)/tests/ref/fate/ffprobe_default
+
 FATE_FFPROBE += $(FATE_FFPROBE-yes)
 
 fate-ffprobe: $(FATE_FFPROBE)
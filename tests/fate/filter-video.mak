@@ -484,6 +484,9 @@ FATE_FILTER_VSYNTH-$(CONFIG_SCALE_FILTER) += fate-filter-scalechroma
 fate-filter-scalechroma: tests/data/vsynth1.yuv
 fate-filter-scalechroma: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv444p -i tests/data/vsynth1.yuv -pix_fmt yuv420p -sws_flags +bitexact -vf scale=out_v_chr_pos=33:out_h_chr_pos=151
 
+FATE_FILTER-$(call ALLYES, TESTSRC2_FILTER SCALE_LADDER_FILTER) += fate-filter-scale_ladder
+fate-filter-scale_ladder: CMD = framecrc -filter_complex "testsrc2=s=352x288:r=5:d=1,scale_ladder=sizes=176x144|88x72|120x90:flags=bicubic+accurate_rnd+bitexact[a][b][c]" -map "[a]" -map "[b]" -map "[c]"
+
 FATE_FILTER_VSYNTH-$(CONFIG_VFLIP_FILTER) += fate-filter-vflip
 fate-filter-vflip: CMD = video_filter "vflip"
 
@@ -720,6 +723,14 @@ FATE_FILTER_VSYNTH-$(CONFIG_FORMAT_FILTER) += $(FATE_FILTER_PIXFMTS-yes)
 
 fate-filter-pixfmts: $(FATE_FILTER_PIXFMTS-yes)
 
+FATE_FILTER-$(call ALLYES, SPLIT_FILTER NULL_FILTER SETPTS_FILTER DRAWBOX_FILTER SCALE_FILTER) += fate-filter-split-writable
+fate-filter-split-writable: libavfilter/tests/writable$(EXESUF)
+fate-filter-split-writable: CMD = run libavfilter/tests/writable
+
+FATE_FILTER-$(call ALLYES, UNSHARP_FILTER HFLIP_FILTER VFLIP_FILTER SETPTS_FILTER SPLIT_FILTER NEGATE_FILTER DRAWBOX_FILTER OVERLAY_FILTER TRIM_FILTER FPS_FILTER ASETNSAMPLES_FILTER VOLUME_FILTER ARESAMPLE_FILTER ASPLIT_FILTER AECHO_FILTER AMIX_FILTER ATRIM_FILTER) += fate-filter-frame-threads
+fate-filter-frame-threads: libavfilter/tests/framethreads$(EXESUF)
+fate-filter-frame-threads: CMD = run libavfilter/tests/framethreads
+
 $(FATE_FILTER_VSYNTH-yes): $(VREF)
 $(FATE_FILTER_VSYNTH-yes): SRC = $(TARGET_PATH)/tests/vsynth1/%02d.pgm
 
@@ -25,6 +25,14 @@ fate-vsynth%-cinepak:            DECOPTS = -s sqcif
 FATE_VCODEC-$(call ENCDEC, CLJR, AVI)   += cljr
 fate-vsynth%-cljr:               ENCOPTS = -strict -1
 
+# only run on the generated sources, see FATE_VSYNTH1 below
+FATE_VCODEC_COOL-$(call ENCDEC, COOL, COOLSEQ) += cool cool-v2 cool-v2-stored
+fate-vsynth%-cool:               FMT = coolseq
+fate-vsynth%-cool-v2:            ENCOPTS = -cool_version 2 -tile_size 64
+fate-vsynth%-cool-v2:            FMT = coolseq
+fate-vsynth%-cool-v2-stored:     ENCOPTS = -cool_version 2 -tile_size 64 -compression none
+fate-vsynth%-cool-v2-stored:     FMT = coolseq
+
 FATE_VCODEC-$(call ENCDEC, DNXHD, DNXHD) += dnxhd-720p                  \
                                             dnxhd-720p-rd               \
                                             dnxhd-720p-10bit            \
@@ -451,6 +459,18 @@ VSYNTH3_OFF  = $(RESIZE_OFF) $(INC_PAR_OFF)
 FATE_VCODEC3 = $(filter-out $(VSYNTH3_OFF),$(FATE_VCODEC))
 FATE_VSYNTH3 = $(FATE_VCODEC3:%=fate-vsynth3-%)
 
+FATE_VSYNTH1 += $(FATE_VCODEC_COOL-yes:%=fate-vsynth1-%)
+FATE_VSYNTH2 += $(FATE_VCODEC_COOL-yes:%=fate-vsynth2-%)
+FATE_VSYNTH3 += $(FATE_VCODEC_COOL-yes:%=fate-vsynth3-%)
+
+# decode only a region of the version 1 and version 2 files above
+FATE_COOL_CROP-$(call ENCDEC, COOL, COOLSEQ) += fate-cool-crop fate-cool-v2-crop
+fate-cool-crop: fate-vsynth1-cool
+fate-cool-crop: CMD = framecrc -crop_x 40 -crop_y 24 -crop_w 200 -crop_h 120 -i $(TARGET_PATH)/tests/data/fate/vsynth1-cool.coolseq
+fate-cool-v2-crop: fate-vsynth1-cool-v2
+fate-cool-v2-crop: CMD = framecrc -crop_x 40 -crop_y 24 -crop_w 200 -crop_h 120 -i $(TARGET_PATH)/tests/data/fate/vsynth1-cool-v2.coolseq
+FATE_AVCONV += $(FATE_COOL_CROP-yes)
+
 $(FATE_VSYNTH1): tests/data/vsynth1.yuv
 $(FATE_VSYNTH2): tests/data/vsynth2.yuv
 $(FATE_VSYNTH_LENA): tests/data/vsynth_lena.yuv
@@ -463,4 +483,4 @@ fate-vsynth1: $(FATE_VSYNTH1)
 fate-vsynth2: $(FATE_VSYNTH2)
 fate-vsynth_lena: $(FATE_VSYNTH_LENA)
 fate-vsynth3: $(FATE_VSYNTH3)
-fate-vcodec:  fate-vsynth1 fate-vsynth_lena fate-vsynth2 fate-vsynth3
+fate-vcodec:  fate-vsynth1 fate-vsynth_lena fate-vsynth2 fate-vsynth3 $(FATE_COOL_CROP-yes)
@@ -122,6 +122,10 @@ if [ -n "$do_flm" ] ; then
 do_lavf flm "" "-pix_fmt rgba"
 fi
 
+if [ -n "$do_coolseq" ] ; then
+do_lavf cools "" "-c:v cool"
+fi
+
 if [ -n "$do_flv_fmt" ] ; then
 do_lavf flv "" "-an"
 fi
@@ -130,6 +134,9 @@ if [ -n "$do_mov" ] ; then
 mov_common_opt="-acodec pcm_alaw -vcodec mpeg4 -threads 1"
 do_lavf mov "" "-movflags +rtphint $mov_common_opt"
 do_lavf_timecode mov "-movflags +faststart $mov_common_opt"
+do_lavf mov "" "-movflags +reserve_moov $mov_common_opt"
+# the reservation is too small, so the data is shifted
+do_lavf mov "" "-movflags +reserve_moov -moov_size 200 $mov_common_opt"
 do_lavf_timecode mp4 "-vcodec mpeg4 -an -threads 1"
 fi
 